@@ -0,0 +1,230 @@
+/*
+Search for the epochs at which two planets have the same or opposite
+heliocentric longitudes.
+
+For a pair of planets the longitude difference, wrapped to [-pi, pi), is
+sampled on a grid whose step is a fraction of the synodic period from the
+mean motions (Ldot). A sign change of the difference brackets the same
+longitude; a sign change of the difference shifted by pi brackets opposite
+longitudes. Every bracket is refined with Brent's method.
+
+For pairs with the Earth, seen_from_earth gives the event its usual
+geocentric name, as main.c and the tests use them: a planet outside the
+Earth's orbit at the Earth's longitude is at opposition, and at the
+opposite longitude in conjunction with the Sun.
+
+Pairs and stretches of the time span are spread over a thread_pool. The
+sampling grid is the same whatever the split, so the result does not
+depend on the number of threads.
+*/
+
+#ifndef ALIGNMENTS_HPP
+#define ALIGNMENTS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "thread_pool.hpp"
+
+#define ALIGNMENT_STEPS_PER_SYNODIC_PERIOD 32
+#define ALIGNMENT_STEPS_PER_TASK 256
+#define ALIGNMENT_TOLERANCE_DAYS 1e-6
+
+enum alignment_kind {
+    ALIGNMENT_SAME_LONGITUDE,       // Same heliocentric longitude
+    ALIGNMENT_OPPOSITE_LONGITUDE    // Heliocentric longitudes differ by pi
+};
+
+// The geocentric name of an event between the Earth and another planet.
+enum geocentric_alignment {
+    GEOCENTRIC_NONE,                    // Neither planet is the Earth
+    GEOCENTRIC_OPPOSITION,              // Outer planet opposite the Sun
+    GEOCENTRIC_CONJUNCTION,             // Outer planet behind the Sun
+    GEOCENTRIC_INFERIOR_CONJUNCTION,    // Inner planet between the Earth and the Sun
+    GEOCENTRIC_SUPERIOR_CONJUNCTION     // Inner planet behind the Sun
+};
+
+typedef struct alignment_event {
+    int planet1;
+    int planet2;
+    double days_since_j2k;
+    alignment_kind kind;
+} alignment_event;
+
+// event as seen from planets[earth], telling inner from outer planets by
+// their semi-major axes. GEOCENTRIC_NONE if the Earth is not in the pair.
+inline geocentric_alignment seen_from_earth(const keplerian_elements* planets, const alignment_event& event, const int earth){
+    if (event.planet1!=earth && event.planet2!=earth){
+        return GEOCENTRIC_NONE;
+    }
+    int other = event.planet1==earth ? event.planet2 : event.planet1;
+    bool outer = planets[other].a_au>planets[earth].a_au;
+    if (event.kind==ALIGNMENT_SAME_LONGITUDE){
+        return outer ? GEOCENTRIC_OPPOSITION : GEOCENTRIC_INFERIOR_CONJUNCTION;
+    }
+    return outer ? GEOCENTRIC_CONJUNCTION : GEOCENTRIC_SUPERIOR_CONJUNCTION;
+}
+
+// Root of f in [a, b], given f(a) and f(b) of opposite signs, by Brent's
+// method.
+template <typename F>
+double find_root_brent(F f, double a, double b, double fa, double fb, const double tolerance){
+    double c = a, fc = fa;
+    double d = b-a, e = d;
+    for (int i=0; i<100; i++){
+        if ((fb>0) == (fc>0)){
+            c = a; fc = fa;
+            d = b-a; e = d;
+        }
+        if (fabs(fc)<fabs(fb)){
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+        double tol = 2*2.2e-16*fabs(b) + 0.5*tolerance;
+        double m = 0.5*(c-b);
+        if (fabs(m)<=tol || fb==0){
+            return b;
+        }
+        if (fabs(e)>=tol && fabs(fa)>fabs(fb)){
+            // Inverse quadratic interpolation, or secant if only two points
+            double s = fb/fa, p, q;
+            if (a==c){
+                p = 2*m*s;
+                q = 1-s;
+            } else {
+                double r = fb/fc;
+                q = fa/fc;
+                p = s*(2*m*q*(q-r) - (b-a)*(r-1));
+                q = (q-1)*(r-1)*(s-1);
+            }
+            if (p>0){
+                q = -q;
+            } else {
+                p = -p;
+            }
+            if (2*p<std::min(3*m*q-fabs(tol*q), fabs(e*q))){
+                e = d;
+                d = p/q;
+            } else {
+                d = m;
+                e = m;
+            }
+        } else {
+            d = m;
+            e = m;
+        }
+        a = b;
+        fa = fb;
+        b += fabs(d)>tol ? d : (m>0 ? tol : -tol);
+        fb = f(b);
+    }
+    return b;
+}
+
+// Angle wrapped to [-pi, pi).
+inline double wrap_angle_rad(double angle_rad){
+    return angle_rad - 2*M_PI*floor((angle_rad+M_PI)/(2*M_PI));
+}
+
+// Every pair (reference, other) for the other planets.
+inline std::vector<std::pair<int, int>> alignment_pairs_with(int reference, int n_planets){
+    std::vector<std::pair<int, int>> pairs;
+    for (int i=0; i<n_planets; i++){
+        if (i!=reference){
+            pairs.push_back(std::make_pair(reference, i));
+        }
+    }
+    return pairs;
+}
+
+// Every unordered pair of planets.
+inline std::vector<std::pair<int, int>> alignment_all_pairs(int n_planets){
+    std::vector<std::pair<int, int>> pairs;
+    for (int i=0; i<n_planets; i++){
+        for (int j=i+1; j<n_planets; j++){
+            pairs.push_back(std::make_pair(i, j));
+        }
+    }
+    return pairs;
+}
+
+// Grid step for a pair: a fraction of the synodic period from the mean
+// motions, short enough that the longitude difference moves well under pi
+// per step even near perihelion.
+inline double alignment_step_days(const keplerian_elements& planet1, const keplerian_elements& planet2){
+    double relative_motion_deg_per_day = fabs(planet1.Ldot-planet2.Ldot)/36525.;
+    return 360./relative_motion_deg_per_day/ALIGNMENT_STEPS_PER_SYNODIC_PERIOD;
+}
+
+// Same and opposite heliocentric longitudes of the given pairs of planets
+// in [start, end) days since J2000, sorted by date.
+inline std::vector<alignment_event> find_alignments(const keplerian_elements* planets, const std::vector<std::pair<int, int>>& pairs, const double start_days_since_j2k, const double end_days_since_j2k, thread_pool& pool){
+    struct task_range {
+        size_t pair;
+        double step_days;
+        long first_step;
+        long end_step;
+    };
+
+    std::vector<task_range> tasks;
+    for (size_t p=0; p<pairs.size(); p++){
+        double step_days = alignment_step_days(planets[pairs[p].first], planets[pairs[p].second]);
+        long n_steps = (long)ceil((end_days_since_j2k-start_days_since_j2k)/step_days);
+        for (long first=0; first<n_steps; first+=ALIGNMENT_STEPS_PER_TASK){
+            tasks.push_back({p, step_days, first, std::min(first+ALIGNMENT_STEPS_PER_TASK, n_steps)});
+        }
+    }
+
+    std::vector<std::vector<alignment_event>> found(tasks.size());
+    pool.run(tasks.size(), [&](size_t t){
+        const task_range& range = tasks[t];
+        const int i = pairs[range.pair].first, j = pairs[range.pair].second;
+        const keplerian_elements& planet1 = planets[i];
+        const keplerian_elements& planet2 = planets[j];
+        auto difference = [&](double days_since_j2k){
+            return wrap_angle_rad(longitude_at_date(planet1, days_since_j2k) - longitude_at_date(planet2, days_since_j2k));
+        };
+
+        double t_a = start_days_since_j2k + range.first_step*range.step_days;
+        double g_a = difference(t_a);
+        for (long k=range.first_step; k<range.end_step; k++){
+            double t_b = std::min(start_days_since_j2k + (k+1)*range.step_days, end_days_since_j2k);
+            double g_b = difference(t_b);
+
+            if (fabs(g_b-g_a)<M_PI){
+                // No wrap inside the step: a sign change is the same longitude
+                if ((g_a<0) != (g_b<0)){
+                    double root = find_root_brent(difference, t_a, t_b, g_a, g_b, ALIGNMENT_TOLERANCE_DAYS);
+                    found[t].push_back({i, j, root, ALIGNMENT_SAME_LONGITUDE});
+                }
+            } else {
+                // The difference went through +-pi: opposite longitudes
+                auto shifted = [&](double days_since_j2k){
+                    return wrap_angle_rad(difference(days_since_j2k) + M_PI);
+                };
+                double h_a = wrap_angle_rad(g_a + M_PI), h_b = wrap_angle_rad(g_b + M_PI);
+                if ((h_a<0) != (h_b<0)){
+                    double root = find_root_brent(shifted, t_a, t_b, h_a, h_b, ALIGNMENT_TOLERANCE_DAYS);
+                    found[t].push_back({i, j, root, ALIGNMENT_OPPOSITE_LONGITUDE});
+                }
+            }
+            t_a = t_b;
+            g_a = g_b;
+        }
+    });
+
+    std::vector<alignment_event> events;
+    for (const std::vector<alignment_event>& task_events : found){
+        events.insert(events.end(), task_events.begin(), task_events.end());
+    }
+    std::sort(events.begin(), events.end(), [](const alignment_event& a, const alignment_event& b){
+        return a.days_since_j2k<b.days_since_j2k;
+    });
+    return events;
+}
+
+#endif
@@ -0,0 +1,676 @@
+/*
+Micro- and macro-benchmarks of the ephemeris code.
+
+Every case counts evaluations as one body at one epoch, so the numbers are
+comparable across cases. A case is timed in samples of a fixed number of
+evaluations, repeated until --min-time has passed; the latency percentiles
+are over the per-evaluation time of each sample. For the cases that go
+through kepler_solve, the Newton iterations are counted on the same inputs
+in a separate, untimed pass. The kepler_solver cases time each solver of
+kepler_solvers.h and report its largest error against
+kepler_solve_reference.
+
+    bench [--filter TEXT] [--min-time SECONDS] [--threads N]
+          [--json FILE] [--baseline FILE [--threshold FRACTION]]
+
+--json writes the results, one case per line. --baseline reads such a file
+and exits with status 1 if any case got slower by more than the threshold
+(0.10 by default) in ns per evaluation.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../planets.h"
+#include "../planets.hpp"
+#include "../orbits_precision.hpp"
+#include "../orbits.h"
+#include "../orbits_batch.h"
+#include "../orbit_stepper.h"
+#include "../julian_date.h"
+#include "../chebyshev_ephemeris.h"
+#include "../kepler_solvers.h"
+#include "../sweep.hpp"
+#include "../fast_math.h"
+#include "../geocentric.h"
+#include "../libplanets.h"
+
+typedef struct bench_options {
+    std::string filter;
+    double min_seconds = 0.25;
+    size_t n_threads = 0;
+    std::string json_path;
+    std::string baseline_path;
+    double threshold = 0.10;
+} bench_options;
+
+typedef struct bench_result {
+    std::string name;
+    size_t evaluations;
+    double evaluations_per_second;
+    double ns_per_eval;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double newton_iterations_mean; // 0 when the case does not solve Kepler's equation
+    int newton_iterations_max;
+    double max_error_rad;           // Against kepler_solve_reference, for the solver cases
+} bench_result;
+
+// Keeps the compiler from discarding the evaluations.
+static volatile double bench_sink;
+
+// Times sample(), which does evaluations_per_sample evaluations, until
+// min_seconds have passed and at least a few samples were taken.
+static bench_result bench_run(const std::string& name, const size_t evaluations_per_sample, const bench_options& options, const std::function<double()>& sample){
+    typedef std::chrono::steady_clock clock;
+    bench_sink = sample(); // Warm up caches and the branch predictors
+
+    std::vector<double> ns_per_eval;
+    double total_ns = 0;
+    clock::time_point start = clock::now();
+    while (ns_per_eval.size()<5 || std::chrono::duration<double>(clock::now()-start).count()<options.min_seconds){
+        clock::time_point t0 = clock::now();
+        bench_sink = sample();
+        clock::time_point t1 = clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1-t0).count();
+        total_ns += ns;
+        ns_per_eval.push_back(ns/evaluations_per_sample);
+    }
+    std::sort(ns_per_eval.begin(), ns_per_eval.end());
+    auto percentile = [&](double p){
+        return ns_per_eval[std::min(ns_per_eval.size()-1, (size_t)(p*ns_per_eval.size()))];
+    };
+
+    bench_result result;
+    result.name = name;
+    result.evaluations = ns_per_eval.size()*evaluations_per_sample;
+    result.evaluations_per_second = result.evaluations/(total_ns*1e-9);
+    result.ns_per_eval = total_ns/result.evaluations;
+    result.p50_ns = percentile(0.50);
+    result.p90_ns = percentile(0.90);
+    result.p99_ns = percentile(0.99);
+    result.newton_iterations_mean = 0;
+    result.newton_iterations_max = 0;
+    result.max_error_rad = 0;
+    return result;
+}
+
+// Newton iterations kepler_solve takes for each planet and epoch.
+static void bench_count_iterations(const keplerian_elements* planets, const size_t n_planets, const std::vector<double>& days_since_j2k, bench_result* result){
+    long total = 0, count = 0;
+    int max_iterations = 0;
+    for (size_t p=0; p<n_planets; p++){
+        for (double days : days_since_j2k){
+            double e = planets[p].e + planets[p].edot*days/36525;
+            int n_iterations;
+            kepler_solve_counted(mean_anomaly_at_date(planets[p], days), e, &n_iterations);
+            total += n_iterations;
+            count++;
+            max_iterations = std::max(max_iterations, n_iterations);
+        }
+    }
+    result->newton_iterations_mean = (double)total/count;
+    result->newton_iterations_max = max_iterations;
+}
+
+// Sum of the ICRF coordinates of the planets through planets.hpp.
+template <const keplerian_elements&... planets>
+static double bench_xyz_templates(const double days_since_j2k){
+    double sum = 0;
+    auto add = [&](double x, double y, double z){
+        sum += x+y+z;
+    };
+    double x, y, z;
+    ((xyz_in_icrf_frame<planets>(days_since_j2k, &x, &y, &z), add(x, y, z)), ...);
+    return sum;
+}
+
+// xyz_in_icrf_frame_batch in the given precision into buffers of that
+// precision, n_planets rows of days.size() values per coordinate.
+template <typename precision>
+static bench_result bench_batch(const std::string& name, const keplerian_elements* planets, const size_t n_planets, const std::vector<double>& days, const bench_options& options){
+    typedef typename precision::real real;
+    size_t n = days.size();
+    std::vector<real> xyz(3*n_planets*n);
+    std::vector<real*> x(n_planets), y(n_planets), z(n_planets);
+    for (size_t p=0; p<n_planets; p++){
+        x[p] = &xyz[(3*p)*n];
+        y[p] = &xyz[(3*p+1)*n];
+        z[p] = &xyz[(3*p+2)*n];
+    }
+    return bench_run(name, n_planets*n, options, [&]{
+        xyz_in_icrf_frame_batch<precision>(planets, n_planets, days.data(), n, x.data(), y.data(), z.data());
+        return (double)xyz[n/2];
+    });
+}
+
+static std::vector<bench_result> bench_all(const bench_options& options){
+    std::vector<bench_result> results;
+    auto wanted = [&](const std::string& name){
+        return options.filter.empty() || name.find(options.filter)!=std::string::npos;
+    };
+
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+
+    // Epochs spread over two centuries, so every case sees all phases of
+    // the orbits
+    const size_t n_epochs = 256;
+    std::vector<double> epochs(n_epochs);
+    for (size_t k=0; k<n_epochs; k++){
+        epochs[k] = -36525 + 73050.*k/n_epochs + 0.123*k;
+    }
+
+    // Kepler's equation across eccentricities, on Earth's orbit otherwise
+    const double eccentricities[] = {0.0167, 0.1, 0.3, 0.6, 0.9};
+    for (double e : eccentricities){
+        char name[64];
+        snprintf(name, sizeof(name), "eccentric_anomaly_at_date/e=%g", e);
+        if (!wanted(name)){
+            continue;
+        }
+        keplerian_elements body = Earth_Moon_barycenter;
+        body.e = e;
+        body.edot = 0;
+        bench_result result = bench_run(name, n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                sum += eccentric_anomaly_at_date(body, days);
+            }
+            return sum;
+        });
+        bench_count_iterations(&body, 1, epochs, &result);
+        results.push_back(result);
+    }
+
+    // Each solver of kepler_solvers.h on mean anomalies spread over [-pi, pi]
+    std::vector<double> mean_anomalies(n_epochs);
+    for (size_t k=0; k<n_epochs; k++){
+        mean_anomalies[k] = -M_PI + 2*M_PI*(k+0.5)/n_epochs;
+    }
+    kepler_table table;
+    bool have_table = kepler_table_build(0.9, 1e-12, &table)==0;
+    std::vector<kepler_solver> solvers = {kepler_solver_newton, kepler_solver_halley, kepler_solver_fixed};
+    if (have_table){
+        solvers.push_back(kepler_solver_table(&table));
+    }
+    for (const kepler_solver& solver : solvers){
+        for (double e : {0.0167, 0.25, 0.6, 0.9}){
+            char name[64];
+            snprintf(name, sizeof(name), "kepler_solver/%s/e=%g", solver.name, e);
+            if (!wanted(name)){
+                continue;
+            }
+            bench_result result = bench_run(name, n_epochs, options, [&]{
+                double sum = 0;
+                for (double M : mean_anomalies){
+                    sum += solver.solve(solver.data, M, e);
+                }
+                return sum;
+            });
+            for (double M : mean_anomalies){
+                result.max_error_rad = std::max(result.max_error_rad, fabs(solver.solve(solver.data, M, e)-kepler_solve_reference(M, e)));
+            }
+            results.push_back(result);
+        }
+    }
+    kepler_table_free(&table);
+
+    if (wanted("longitude_at_date/8_planets")){
+        bench_result result = bench_run("longitude_at_date/8_planets", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                for (int p=0; p<8; p++){
+                    sum += longitude_at_date(planets[p], days);
+                }
+            }
+            return sum;
+        });
+        bench_count_iterations(planets, 8, epochs, &result);
+        results.push_back(result);
+    }
+
+    if (wanted("xyz_in_icrf_frame/8_planets")){
+        bench_result result = bench_run("xyz_in_icrf_frame/8_planets", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                for (int p=0; p<8; p++){
+                    double x, y, z;
+                    xyz_in_icrf_frame(planets[p], days, &x, &y, &z);
+                    sum += x+y+z;
+                }
+            }
+            return sum;
+        });
+        bench_count_iterations(planets, 8, epochs, &result);
+        results.push_back(result);
+    }
+
+    if (wanted("xyz_in_icrf_frame/8_planets_templates")){
+        bench_result result = bench_run("xyz_in_icrf_frame/8_planets_templates", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                sum += bench_xyz_templates<Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune>(days);
+            }
+            return sum;
+        });
+        bench_count_iterations(planets, 8, epochs, &result);
+        results.push_back(result);
+    }
+
+    if (wanted("orbital_state_at_date/all_fields")){
+        bench_result result = bench_run("orbital_state_at_date/all_fields", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                for (int p=0; p<8; p++){
+                    orbital_state state;
+                    orbital_state_at_date(&planets[p], days, STATE_ALL, &state);
+                    sum += state.x_eq_au + state.vx_eq_au_per_day + state.longitude_rad;
+                }
+            }
+            return sum;
+        });
+        bench_count_iterations(planets, 8, epochs, &result);
+        results.push_back(result);
+    }
+
+    // Whole solar system at one epoch, as a tracking loop would ask for it
+    if (wanted("snapshot/8_planets_batch")){
+        std::vector<double> xyz(3*8);
+        double* x[8]; double* y[8]; double* z[8];
+        for (int p=0; p<8; p++){
+            x[p] = &xyz[p]; y[p] = &xyz[8+p]; z[p] = &xyz[16+p];
+        }
+        bench_result result = bench_run("snapshot/8_planets_batch", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (size_t k=0; k<n_epochs; k++){
+                xyz_in_icrf_frame_batch(planets, 8, &epochs[k], 1, x, y, z);
+                sum += xyz[0];
+            }
+            return sum;
+        });
+        results.push_back(result);
+    }
+
+    if (wanted("chebyshev_ephemeris_xyz/8_planets")){
+        chebyshev_ephemeris ephemerides[8];
+        bool built = true;
+        for (int p=0; p<8; p++){
+            built = chebyshev_ephemeris_build(&planets[p], -36525, 36525, CHEBYSHEV_DEFAULT_COEFFICIENTS, 1e-6, &ephemerides[p])==0 && built;
+        }
+        if (built){
+            bench_result result = bench_run("chebyshev_ephemeris_xyz/8_planets", 8*n_epochs, options, [&]{
+                double sum = 0;
+                for (double days : epochs){
+                    for (int p=0; p<8; p++){
+                        double x, y, z;
+                        chebyshev_ephemeris_xyz(&ephemerides[p], std::min(days, 36524.), &x, &y, &z);
+                        sum += x+y+z;
+                    }
+                }
+                return sum;
+            });
+            results.push_back(result);
+        }
+        for (int p=0; p<8; p++){
+            chebyshev_ephemeris_free(&ephemerides[p]);
+        }
+    }
+
+    // A year at one-minute resolution for the eight planets
+    const size_t n_sweep = 365*1440;
+    const double sweep_step = 1./1440;
+    std::vector<double> sweep_xyz(3*8*n_sweep);
+    double* sx[8]; double* sy[8]; double* sz[8];
+    for (int p=0; p<8; p++){
+        sx[p] = &sweep_xyz[(3*p)*n_sweep];
+        sy[p] = &sweep_xyz[(3*p+1)*n_sweep];
+        sz[p] = &sweep_xyz[(3*p+2)*n_sweep];
+    }
+    if (wanted("sweep/1_year_1_minute_serial")){
+        results.push_back(bench_run("sweep/1_year_1_minute_serial", 8*n_sweep, options, [&]{
+            sweep_icrf_serial(planets, 8, 9000., sweep_step, n_sweep, sx, sy, sz);
+            return sweep_xyz[n_sweep/2];
+        }));
+    }
+    if (wanted("sweep/1_year_1_minute_parallel")){
+        thread_pool pool(options.n_threads);
+        results.push_back(bench_run("sweep/1_year_1_minute_parallel", 8*n_sweep, options, [&]{
+            sweep_icrf(planets, 8, 9000., sweep_step, n_sweep, sx, sy, sz, pool);
+            return sweep_xyz[n_sweep/2];
+        }));
+    }
+    if (wanted("sweep/1_year_1_minute_stepper")){
+        results.push_back(bench_run("sweep/1_year_1_minute_stepper", 8*n_sweep, options, [&]{
+            for (int p=0; p<8; p++){
+                orbit_stepper stepper;
+                orbit_stepper_init(&planets[p], 9000., sweep_step, &stepper);
+                for (size_t k=0; k<n_sweep; k++){
+                    if (k>0){
+                        orbit_stepper_next(&stepper);
+                    }
+                    sx[p][k] = stepper.x_eq_au;
+                    sy[p][k] = stepper.y_eq_au;
+                    sz[p][k] = stepper.z_eq_au;
+                }
+            }
+            return sweep_xyz[n_sweep/2];
+        }));
+    }
+
+    // The same year through the batch engine in each precision
+    std::vector<double> sweep_days(n_sweep);
+    for (size_t k=0; k<n_sweep; k++){
+        sweep_days[k] = 9000. + k*sweep_step;
+    }
+    if (wanted("batch/1_year_1_minute_double")){
+        results.push_back(bench_batch<precision_double>("batch/1_year_1_minute_double", planets, 8, sweep_days, options));
+    }
+    if (wanted("batch/1_year_1_minute_mixed")){
+        results.push_back(bench_batch<precision_mixed>("batch/1_year_1_minute_mixed", planets, 8, sweep_days, options));
+    }
+    if (wanted("batch/1_year_1_minute_float")){
+        results.push_back(bench_batch<precision_float>("batch/1_year_1_minute_float", planets, 8, sweep_days, options));
+    }
+
+    // The sky from the Earth: a snapshot solves Kepler's equation once per
+    // planet, against solving for both ends of every pair
+    if (wanted("sky_snapshot/8_targets")){
+        results.push_back(bench_run("sky_snapshot/8_targets", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                sky_snapshot sky;
+                sky_snapshot_at_date(planets, days, 0, &sky);
+                sum += sky.separation_rad[SKY_SUN][SKY_MARS];
+            }
+            return sum;
+        }));
+    }
+    if (wanted("sky_snapshot/8_targets_light_time")){
+        results.push_back(bench_run("sky_snapshot/8_targets_light_time", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                sky_snapshot sky;
+                sky_snapshot_at_date(planets, days, SKY_LIGHT_TIME, &sky);
+                sum += sky.separation_rad[SKY_SUN][SKY_MARS];
+            }
+            return sum;
+        }));
+    }
+    if (wanted("sky_snapshot/pairwise_from_scratch")){
+        results.push_back(bench_run("sky_snapshot/pairwise_from_scratch", 8*n_epochs, options, [&]{
+            double sum = 0;
+            for (double days : epochs){
+                for (int i=0; i<8; i++){
+                    for (int j=i+1; j<8; j++){
+                        double earth[3], a[3] = {0, 0, 0}, b[3];
+                        xyz_in_icrf_frame(Earth_Moon_barycenter, days, &earth[0], &earth[1], &earth[2]);
+                        if (i>0){
+                            xyz_in_icrf_frame(planets[sky_target_planet(i)], days, &a[0], &a[1], &a[2]);
+                        }
+                        xyz_in_icrf_frame(planets[sky_target_planet(j)], days, &b[0], &b[1], &b[2]);
+                        double dot = 0, na = 0, nb = 0;
+                        for (int axis=0; axis<3; axis++){
+                            a[axis] -= earth[axis];
+                            b[axis] -= earth[axis];
+                            dot += a[axis]*b[axis];
+                            na += a[axis]*a[axis];
+                            nb += b[axis]*b[axis];
+                        }
+                        sum += acos(dot/sqrt(na*nb));
+                    }
+                }
+            }
+            return sum;
+        }));
+    }
+
+    // Timestamps in a fixed-width column, through the branch-free batch
+    // parser and through the general one
+    std::string timestamps;
+    for (size_t k=0; k<n_epochs; k++){
+        char record[32];
+        snprintf(record, sizeof(record), "%04zu-%02zu-%02zuT%02zu:%02zu:%02zu", 1800+k, 1+k%12, 1+k%28, k%24, k%60, (7*k)%60);
+        timestamps += record;
+    }
+    std::vector<double> parsed(n_epochs);
+    if (wanted("iso8601/fixed_width_batch")){
+        results.push_back(bench_run("iso8601/fixed_width_batch", n_epochs, options, [&]{
+            iso8601_fixed_to_days_since_j2k_batch(timestamps.data(), JULIAN_DATE_ISO8601_FIXED_LENGTH, n_epochs, parsed.data());
+            return parsed[1];
+        }));
+    }
+    if (wanted("iso8601/general_parser")){
+        results.push_back(bench_run("iso8601/general_parser", n_epochs, options, [&]{
+            for (size_t k=0; k<n_epochs; k++){
+                iso8601_to_days_since_j2k(timestamps.data() + k*JULIAN_DATE_ISO8601_FIXED_LENGTH, JULIAN_DATE_ISO8601_FIXED_LENGTH, &parsed[k]);
+            }
+            return parsed[1];
+        }));
+    }
+
+    // The elementary functions of the scalar path, libm against fast_math.h,
+    // on the mean anomalies and on angles of a few turns
+    std::vector<double> angles(n_epochs);
+    for (size_t k=0; k<n_epochs; k++){
+        angles[k] = mean_anomalies[k]*(1 + (double)(k%4));
+    }
+    if (wanted("math/sincos_libm")){
+        results.push_back(bench_run("math/sincos_libm", n_epochs, options, [&]{
+            double sum = 0;
+            for (double x : angles){
+                sum += sin(x) + cos(x);
+            }
+            return sum;
+        }));
+    }
+    if (wanted("math/sincos_fast")){
+        results.push_back(bench_run("math/sincos_fast", n_epochs, options, [&]{
+            double sum = 0;
+            for (double x : angles){
+                double s, c;
+                fast_sincos(x, &s, &c);
+                sum += s + c;
+            }
+            return sum;
+        }));
+    }
+    if (wanted("math/atan2_libm")){
+        results.push_back(bench_run("math/atan2_libm", n_epochs, options, [&]{
+            double sum = 0;
+            for (size_t k=0; k<n_epochs; k++){
+                sum += atan2(angles[k], angles[n_epochs-1-k]);
+            }
+            return sum;
+        }));
+    }
+    if (wanted("math/atan2_fast")){
+        results.push_back(bench_run("math/atan2_fast", n_epochs, options, [&]{
+            double sum = 0;
+            for (size_t k=0; k<n_epochs; k++){
+                sum += fast_atan2(angles[k], angles[n_epochs-1-k]);
+            }
+            return sum;
+        }));
+    }
+    if (wanted("math/reduce_pi_libm")){
+        results.push_back(bench_run("math/reduce_pi_libm", n_epochs, options, [&]{
+            double sum = 0;
+            for (double x : angles){
+                sum += libm_reduce_pi(x);
+            }
+            return sum;
+        }));
+    }
+    if (wanted("math/reduce_pi_fast")){
+        results.push_back(bench_run("math/reduce_pi_fast", n_epochs, options, [&]{
+            double sum = 0;
+            for (double x : angles){
+                sum += fast_reduce_pi(x);
+            }
+            return sum;
+        }));
+    }
+
+    // The same positions through the shared library, as a binding would
+    // call it, with the call cost spread over more epochs per call
+    std::vector<double> xyz(8*n_epochs*3);
+    if (wanted("libplanets/in_process_batch")){
+        double* x[8]; double* y[8]; double* z[8];
+        for (int p=0; p<8; p++){
+            x[p] = &xyz[p*n_epochs]; y[p] = &xyz[(8+p)*n_epochs]; z[p] = &xyz[(16+p)*n_epochs];
+        }
+        results.push_back(bench_run("libplanets/in_process_batch", 8*n_epochs, options, [&]{
+            xyz_in_icrf_frame_batch(planets, 8, epochs.data(), n_epochs, x, y, z);
+            return xyz[1];
+        }));
+    }
+    planets_body_set* set = planets_body_set_create_builtin(PLANETS_ELEMENTS_3000BC_3000AD);
+    for (size_t epochs_per_call : {(size_t)1, (size_t)16, n_epochs}){
+        char name[64];
+        snprintf(name, sizeof(name), "libplanets/positions/%zu_epochs_per_call", epochs_per_call);
+        if (set==NULL || !wanted(name)){
+            continue;
+        }
+        results.push_back(bench_run(name, 8*n_epochs, options, [&]{
+            const ptrdiff_t d = sizeof(double);
+            for (size_t first=0; first<n_epochs; first+=epochs_per_call){
+                planets_positions(set, PLANETS_FRAME_ICRF, &epochs[first], epochs_per_call, d, &xyz[3*first], n_epochs*3*d, 3*d, d);
+            }
+            return xyz[3*n_epochs+1];
+        }));
+    }
+    planets_body_set_destroy(set);
+    return results;
+}
+
+static void bench_print(const std::vector<bench_result>& results){
+    printf("%-40s %10s %10s %10s %10s %12s %8s %9s\n", "case", "ns/eval", "p50", "p90", "p99", "Meval/s", "newton", "error");
+    for (const bench_result& r : results){
+        char newton[32] = "-";
+        if (r.newton_iterations_max>0){
+            snprintf(newton, sizeof(newton), "%.2f/%d", r.newton_iterations_mean, r.newton_iterations_max);
+        }
+        char error[32] = "-";
+        if (r.max_error_rad>0){
+            snprintf(error, sizeof(error), "%.1e", r.max_error_rad);
+        }
+        printf("%-40s %10.2f %10.2f %10.2f %10.2f %12.2f %8s %9s\n", r.name.c_str(), r.ns_per_eval, r.p50_ns, r.p90_ns, r.p99_ns, r.evaluations_per_second*1e-6, newton, error);
+    }
+}
+
+static int bench_write_json(const std::string& path, const std::vector<bench_result>& results){
+    FILE* file = fopen(path.c_str(), "w");
+    if (file==NULL){
+        return -1;
+    }
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (size_t k=0; k<results.size(); k++){
+        const bench_result& r = results[k];
+        fprintf(file, "    {\"name\": \"%s\", \"evaluations\": %zu, \"evaluations_per_second\": %.6g, \"ns_per_eval\": %.6g, "
+                      "\"p50_ns\": %.6g, \"p90_ns\": %.6g, \"p99_ns\": %.6g, \"newton_iterations_mean\": %.4g, \"newton_iterations_max\": %d, \"max_error_rad\": %.3g}%s\n",
+                r.name.c_str(), r.evaluations, r.evaluations_per_second, r.ns_per_eval,
+                r.p50_ns, r.p90_ns, r.p99_ns, r.newton_iterations_mean, r.newton_iterations_max, r.max_error_rad, k+1<results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file)==0 ? 0 : -1;
+}
+
+// Reads back the name and ns_per_eval of each case of a file written by
+// bench_write_json. Returns -1 if the file cannot be read.
+static int bench_read_baseline(const std::string& path, std::vector<std::pair<std::string, double>>* baseline){
+    FILE* file = fopen(path.c_str(), "r");
+    if (file==NULL){
+        return -1;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file)!=NULL){
+        const char* name = strstr(line, "\"name\": \"");
+        const char* ns = strstr(line, "\"ns_per_eval\": ");
+        if (name==NULL || ns==NULL){
+            continue;
+        }
+        name += strlen("\"name\": \"");
+        const char* name_end = strchr(name, '"');
+        if (name_end==NULL){
+            continue;
+        }
+        baseline->push_back(std::make_pair(std::string(name, name_end), atof(ns+strlen("\"ns_per_eval\": "))));
+    }
+    fclose(file);
+    return 0;
+}
+
+// Prints how each case compares to the baseline. Returns the number of
+// cases slower than the baseline by more than the threshold.
+static int bench_compare(const std::vector<bench_result>& results, const std::vector<std::pair<std::string, double>>& baseline, const double threshold){
+    int n_regressions = 0;
+    printf("\n%-40s %10s %10s %8s\n", "case", "baseline", "now", "change");
+    for (const bench_result& r : results){
+        for (const std::pair<std::string, double>& base : baseline){
+            if (base.first!=r.name || !(base.second>0)){
+                continue;
+            }
+            double change = r.ns_per_eval/base.second-1;
+            bool regressed = change>threshold;
+            n_regressions += regressed;
+            printf("%-40s %10.2f %10.2f %+7.1f%%%s\n", r.name.c_str(), base.second, r.ns_per_eval, 100*change, regressed ? "  REGRESSION" : "");
+        }
+    }
+    return n_regressions;
+}
+
+static void bench_usage(const char* program){
+    fprintf(stderr, "Usage: %s [--filter TEXT] [--min-time SECONDS] [--threads N] [--json FILE] [--baseline FILE [--threshold FRACTION]]\n", program);
+}
+
+int main(int argc, char** argv){
+    bench_options options;
+    for (int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        bool has_value = i+1<argc;
+        if (arg=="--filter" && has_value){
+            options.filter = argv[++i];
+        } else if (arg=="--min-time" && has_value){
+            options.min_seconds = atof(argv[++i]);
+        } else if (arg=="--threads" && has_value){
+            options.n_threads = (size_t)atol(argv[++i]);
+        } else if (arg=="--json" && has_value){
+            options.json_path = argv[++i];
+        } else if (arg=="--baseline" && has_value){
+            options.baseline_path = argv[++i];
+        } else if (arg=="--threshold" && has_value){
+            options.threshold = atof(argv[++i]);
+        } else {
+            bench_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!options.baseline_path.empty() && bench_read_baseline(options.baseline_path, &baseline)!=0){
+        fprintf(stderr, "Cannot read baseline %s\n", options.baseline_path.c_str());
+        return 2;
+    }
+
+    std::vector<bench_result> results = bench_all(options);
+    bench_print(results);
+
+    if (!options.json_path.empty() && bench_write_json(options.json_path, results)!=0){
+        fprintf(stderr, "Cannot write %s\n", options.json_path.c_str());
+        return 2;
+    }
+    if (!options.baseline_path.empty()){
+        int n_regressions = bench_compare(results, baseline, options.threshold);
+        if (n_regressions>0){
+            printf("%d case(s) slower than the baseline by more than %.0f%%\n", n_regressions, 100*options.threshold);
+            return 1;
+        }
+    }
+    return 0;
+}
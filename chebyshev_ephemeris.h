@@ -0,0 +1,188 @@
+/*
+Piecewise Chebyshev approximation of the ICRF position of one body.
+
+The span is cut into segments of equal length, so finding the segment for
+an epoch is one division. Inside a segment each coordinate is a Chebyshev
+series evaluated with Clenshaw's recurrence, which needs no trig at all.
+
+The builder picks the segment length by halving until the fit agrees with
+xyz_in_icrf_frame to the requested tolerance at points between the
+interpolation nodes.
+*/
+
+#ifndef CHEBYSHEV_EPHEMERIS_H
+#define CHEBYSHEV_EPHEMERIS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "keplerian_elements.h"
+#include "orbits.h"
+
+#define CHEBYSHEV_DEFAULT_COEFFICIENTS 8
+#define CHEBYSHEV_MAX_COEFFICIENTS 32
+#define CHEBYSHEV_MAX_SEGMENTS (1<<22)
+#define CHEBYSHEV_CHECKS_PER_SEGMENT 3 // Check points per interpolation node
+
+typedef struct chebyshev_ephemeris {
+    double start_days_since_j2k;    // Start of the first segment
+    double segment_days;            // Length of each segment
+    double segments_per_day;        // 1/segment_days
+    int n_segments;
+    int n_coefficients;             // Per coordinate and segment
+    double max_error_au;            // Largest error seen by the builder
+
+    // n_segments blocks of 3*n_coefficients doubles: the x, y and z series
+    // of each segment, lowest order first.
+    const double* coefficients;
+    double* owned_coefficients;     // Set when the builder allocated them
+} chebyshev_ephemeris;
+
+// Chebyshev series on [-1, 1] by Clenshaw's recurrence.
+SSD_INLINE double chebyshev_clenshaw(const double* c, const int n, const double tau){
+    double b1 = 0, b2 = 0;
+    double two_tau = 2*tau;
+    for (int j=n-1; j>0; j--){
+        double b0 = c[j] + two_tau*b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return c[0] + tau*b1 - b2;
+}
+
+// Position in the ICRF frame from the fit. Returns 0, or -1 and NAN
+// positions for a NAN epoch or one outside the span, where the series
+// diverge within a few segments.
+SSD_INLINE int chebyshev_ephemeris_xyz(const chebyshev_ephemeris* ephemeris, const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    double offset = (days_since_j2k - ephemeris->start_days_since_j2k)*ephemeris->segments_per_day;
+    // The negation also catches NAN, before any conversion to int. The
+    // slack lets the end epoch through whatever the rounding of the offset.
+    if (!(offset>=0 && offset<=ephemeris->n_segments*(1 + 1e-12))){
+        *x_eq_au = NAN;
+        *y_eq_au = NAN;
+        *z_eq_au = NAN;
+        return -1;
+    }
+    // The end of the span belongs to the last segment
+    int segment = offset<ephemeris->n_segments ? (int)offset : ephemeris->n_segments-1;
+    double tau = 2*(offset-segment)-1;
+
+    const int n = ephemeris->n_coefficients;
+    const double* c = ephemeris->coefficients + (size_t)segment*3*n;
+
+    // The three recurrences are interleaved so they overlap in the pipeline.
+    double two_tau = 2*tau;
+    double bx1 = 0, bx2 = 0, by1 = 0, by2 = 0, bz1 = 0, bz2 = 0;
+    for (int j=n-1; j>0; j--){
+        double bx0 = c[j] + two_tau*bx1 - bx2;
+        double by0 = c[n+j] + two_tau*by1 - by2;
+        double bz0 = c[2*n+j] + two_tau*bz1 - bz2;
+        bx2 = bx1; bx1 = bx0;
+        by2 = by1; by1 = by0;
+        bz2 = bz1; bz1 = bz0;
+    }
+    *x_eq_au = c[0] + tau*bx1 - bx2;
+    *y_eq_au = c[n] + tau*by1 - by2;
+    *z_eq_au = c[2*n] + tau*bz1 - bz2;
+    return 0;
+}
+
+// Fit one segment by interpolating at the Chebyshev nodes.
+SSD_INLINE void chebyshev_fit_segment(const keplerian_elements* planet, const double start, const double length, const int n, double* c){
+    double values[3][CHEBYSHEV_MAX_COEFFICIENTS];
+    for (int k=0; k<n; k++){
+        double tau = cos(M_PI*(k+0.5)/n);
+        xyz_in_icrf_frame(*planet, start + 0.5*(tau+1)*length, &values[0][k], &values[1][k], &values[2][k]);
+    }
+    for (int axis=0; axis<3; axis++){
+        for (int j=0; j<n; j++){
+            double sum = 0;
+            for (int k=0; k<n; k++){
+                sum += values[axis][k]*cos(M_PI*j*(k+0.5)/n);
+            }
+            c[axis*n+j] = (j==0 ? 1. : 2.)*sum/n;
+        }
+    }
+}
+
+// Largest distance between the fit and the analytic position at points
+// spread across one segment, away from the interpolation nodes.
+SSD_INLINE double chebyshev_segment_error(const keplerian_elements* planet, const double start, const double length, const int n, const double* c){
+    double max_error = 0;
+    int n_checks = CHEBYSHEV_CHECKS_PER_SEGMENT*n;
+    for (int k=0; k<=n_checks; k++){
+        double tau = -1 + 2.*k/n_checks;
+        double x, y, z;
+        xyz_in_icrf_frame(*planet, start + 0.5*(tau+1)*length, &x, &y, &z);
+        double dx = chebyshev_clenshaw(c, n, tau) - x;
+        double dy = chebyshev_clenshaw(c+n, n, tau) - y;
+        double dz = chebyshev_clenshaw(c+2*n, n, tau) - z;
+        double error = sqrt(dx*dx + dy*dy + dz*dz);
+        if (error>max_error){
+            max_error = error;
+        }
+    }
+    return max_error;
+}
+
+SSD_INLINE void chebyshev_ephemeris_free(chebyshev_ephemeris* ephemeris){
+    free(ephemeris->owned_coefficients);
+    ephemeris->owned_coefficients = NULL;
+    ephemeris->coefficients = NULL;
+    ephemeris->n_segments = 0;
+}
+
+// Fit planet between start and end (days since J2000) with n_coefficients
+// per coordinate and segment, so that the fit is within tolerance_au of
+// xyz_in_icrf_frame. The first guess for the segment length is an eighth of
+// the orbital period. Returns 0 on success, -1 on bad arguments, on
+// allocation failure or if the tolerance cannot be met.
+SSD_INLINE int chebyshev_ephemeris_build(const keplerian_elements* planet, const double start_days_since_j2k, const double end_days_since_j2k, const int n_coefficients, const double tolerance_au, chebyshev_ephemeris* ephemeris){
+    memset(ephemeris, 0, sizeof(*ephemeris));
+    if (!(end_days_since_j2k>start_days_since_j2k) || n_coefficients<2 || n_coefficients>CHEBYSHEV_MAX_COEFFICIENTS){
+        return -1;
+    }
+
+    double span = end_days_since_j2k - start_days_since_j2k;
+    double period_days = 360.*36525./fabs(planet->Ldot);
+    int n_segments = (int)ceil(span/(period_days/8));
+
+    for (; n_segments<=CHEBYSHEV_MAX_SEGMENTS; n_segments*=2){
+        double segment_days = span/n_segments;
+        size_t stride = 3*(size_t)n_coefficients;
+        double* coefficients = (double*)malloc(n_segments*stride*sizeof(double));
+        if (coefficients==NULL){
+            return -1;
+        }
+
+        double max_error = 0;
+        int i;
+        for (i=0; i<n_segments; i++){
+            double start = start_days_since_j2k + i*segment_days;
+            double* c = coefficients + i*stride;
+            chebyshev_fit_segment(planet, start, segment_days, n_coefficients, c);
+            double error = chebyshev_segment_error(planet, start, segment_days, n_coefficients, c);
+            if (error>max_error){
+                max_error = error;
+            }
+            if (max_error>tolerance_au){
+                break;
+            }
+        }
+
+        if (i==n_segments){
+            ephemeris->start_days_since_j2k = start_days_since_j2k;
+            ephemeris->segment_days = segment_days;
+            ephemeris->segments_per_day = 1./segment_days;
+            ephemeris->n_segments = n_segments;
+            ephemeris->n_coefficients = n_coefficients;
+            ephemeris->max_error_au = max_error;
+            ephemeris->coefficients = coefficients;
+            ephemeris->owned_coefficients = coefficients;
+            return 0;
+        }
+        free(coefficients);
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,247 @@
+/*
+Screening a small-body catalog for close approaches between its bodies.
+
+The time span is cut into slices. Within a slice a body stays within
+v_max*slice/2 of its position at the middle of the slice, v_max being its
+speed at perihelion, so two bodies can only come within the threshold
+distance of each other if their mid-slice positions are within the sum of
+those radii plus the threshold. The mid-slice positions are bucketed into a
+uniform grid whose cells are at least that large, and only bodies in the
+same or adjacent cells are tested against each other, which makes a slice
+O(N) rather than O(N^2) for a catalog spread through space. Those pairs are
+then screened again with their relative motion at mid-slice: the distance
+cannot drop below the closest approach along the straight line by more
+than the maximum accelerations allow over half a slice.
+
+Each surviving pair is sampled a few times across the slice for the
+closest approach, where the range rate d.v changes sign from negative to
+positive, and the time of closest approach is refined with Brent's method.
+
+Slices are spread over a thread_pool and each needs O(N) memory. Slices
+short enough that the bodies move about the threshold distance keep the
+number of candidate pairs, and the time spent refining them, small.
+*/
+
+#ifndef CLOSE_APPROACHES_HPP
+#define CLOSE_APPROACHES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "small_bodies.h"
+#include "alignments.hpp"
+#include "thread_pool.hpp"
+
+#define CLOSE_APPROACH_REFINE_STEPS 4       // Samples of the range rate per slice and pair
+#define CLOSE_APPROACH_TOLERANCE_DAYS 1e-6
+#define CLOSE_APPROACH_CELL_BITS 21         // Per axis in a grid key
+
+typedef struct close_approach {
+    size_t body1;                   // body1 < body2, indices into the catalog
+    size_t body2;
+    double days_since_j2k;          // Time of closest approach
+    double distance_au;
+} close_approach;
+
+// Grid cell of a position, packed as three CLOSE_APPROACH_CELL_BITS-bit
+// fields.
+inline uint64_t close_approach_cell_key(const int64_t ix, const int64_t iy, const int64_t iz){
+    const int64_t offset = (int64_t)1<<(CLOSE_APPROACH_CELL_BITS-1);
+    const uint64_t mask = ((uint64_t)1<<CLOSE_APPROACH_CELL_BITS)-1;
+    return (((uint64_t)(ix+offset) & mask)<<(2*CLOSE_APPROACH_CELL_BITS))
+         | (((uint64_t)(iy+offset) & mask)<<CLOSE_APPROACH_CELL_BITS)
+         | ((uint64_t)(iz+offset) & mask);
+}
+
+// Pairs (i, j), i < j, of bodies whose spheres of the given radii around
+// (x, y, z) come within threshold_au of each other.
+inline std::vector<std::pair<size_t, size_t>> close_approach_candidates(const double* x, const double* y, const double* z, const double* radius_au, const size_t n, const double threshold_au){
+    std::vector<std::pair<size_t, size_t>> pairs;
+    if (n<2){
+        return pairs;
+    }
+    double max_radius_au = 0, extent_au = 0;
+    for (size_t i=0; i<n; i++){
+        max_radius_au = std::max(max_radius_au, radius_au[i]);
+        extent_au = std::max(extent_au, std::max(fabs(x[i]), std::max(fabs(y[i]), fabs(z[i]))));
+    }
+    // Any two bodies that can meet are in the same or adjacent cells. The
+    // cells are made larger if needed for the keys to cover every body.
+    double cell_au = std::max(threshold_au + 2*max_radius_au, 2.*extent_au/((int64_t)1<<(CLOSE_APPROACH_CELL_BITS-2)));
+
+    struct keyed_body {
+        uint64_t key;
+        size_t index;
+    };
+    std::vector<keyed_body> bodies(n);
+    std::vector<int64_t> cells(3*n);
+    for (size_t i=0; i<n; i++){
+        cells[3*i] = (int64_t)floor(x[i]/cell_au);
+        cells[3*i+1] = (int64_t)floor(y[i]/cell_au);
+        cells[3*i+2] = (int64_t)floor(z[i]/cell_au);
+        bodies[i] = {close_approach_cell_key(cells[3*i], cells[3*i+1], cells[3*i+2]), i};
+    }
+    std::sort(bodies.begin(), bodies.end(), [](const keyed_body& a, const keyed_body& b){
+        return a.key<b.key || (a.key==b.key && a.index<b.index);
+    });
+
+    // Occupied cells in key order, with their first body
+    std::vector<uint64_t> cell_keys;
+    std::vector<size_t> cell_starts;
+    for (size_t k=0; k<n; k++){
+        if (k==0 || bodies[k].key!=bodies[k-1].key){
+            cell_keys.push_back(bodies[k].key);
+            cell_starts.push_back(k);
+        }
+    }
+    const size_t n_cells = cell_keys.size();
+    cell_starts.push_back(n);
+
+    auto test = [&](size_t i, size_t j){
+        double dx = x[i]-x[j], dy = y[i]-y[j], dz = z[i]-z[j];
+        double reach = radius_au[i] + radius_au[j] + threshold_au;
+        if (dx*dx + dy*dy + dz*dz<=reach*reach){
+            pairs.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+        }
+    };
+    auto test_cells = [&](size_t c, size_t d){
+        for (size_t a=cell_starts[c]; a<cell_starts[c+1]; a++){
+            for (size_t b=cell_starts[d]; b<cell_starts[d+1]; b++){
+                test(bodies[a].index, bodies[b].index);
+            }
+        }
+    };
+
+    // Each pair of adjacent cells is visited once, from the one with the
+    // smaller key: the next cell along z, and the three cells along z in
+    // each of the rows (x, y+1), (x+1, y-1), (x+1, y) and (x+1, y+1). As the
+    // cells go by in key order so do those rows, so each row is followed by
+    // a cursor that only moves forward, with no searching.
+    const int row_offsets[4][2] = {{0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    size_t cursors[4] = {0, 0, 0, 0};
+    for (size_t c=0; c<n_cells; c++){
+        const size_t representative = bodies[cell_starts[c]].index;
+        const int64_t ix = cells[3*representative], iy = cells[3*representative+1], iz = cells[3*representative+2];
+        for (size_t a=cell_starts[c]; a<cell_starts[c+1]; a++){
+            for (size_t b=a+1; b<cell_starts[c+1]; b++){
+                test(bodies[a].index, bodies[b].index);
+            }
+        }
+        if (c+1<n_cells && cell_keys[c+1]==close_approach_cell_key(ix, iy, iz+1)){
+            test_cells(c, c+1);
+        }
+        for (int r=0; r<4; r++){
+            uint64_t first = close_approach_cell_key(ix+row_offsets[r][0], iy+row_offsets[r][1], iz-1);
+            uint64_t last = close_approach_cell_key(ix+row_offsets[r][0], iy+row_offsets[r][1], iz+1);
+            size_t& d = cursors[r];
+            while (d<n_cells && cell_keys[d]<first){
+                d++;
+            }
+            for (size_t e=d; e<n_cells && cell_keys[e]<=last; e++){
+                test_cells(c, e);
+            }
+        }
+    }
+    return pairs;
+}
+
+// Minima of the distance between bodies i and j in [t0, t1) that are within
+// threshold_au, appended to found.
+inline void close_approach_refine(const small_body_catalog* catalog, const size_t i, const size_t j, const double t0, const double t1, const double threshold_au, std::vector<close_approach>& found){
+    auto separation = [&](double days_since_j2k, double* distance_au){
+        double xi, yi, zi, vxi, vyi, vzi, xj, yj, zj, vxj, vyj, vzj;
+        small_body_catalog_state_in_j2k_ecliptic_frame(catalog, i, days_since_j2k, &xi, &yi, &zi, &vxi, &vyi, &vzi);
+        small_body_catalog_state_in_j2k_ecliptic_frame(catalog, j, days_since_j2k, &xj, &yj, &zj, &vxj, &vyj, &vzj);
+        double dx = xi-xj, dy = yi-yj, dz = zi-zj;
+        if (distance_au!=NULL){
+            *distance_au = sqrt(dx*dx + dy*dy + dz*dz);
+        }
+        // Half the rate of change of the squared distance
+        return dx*(vxi-vxj) + dy*(vyi-vyj) + dz*(vzi-vzj);
+    };
+    auto range_rate = [&](double days_since_j2k){
+        return separation(days_since_j2k, NULL);
+    };
+
+    double t_a = t0;
+    double g_a = range_rate(t_a);
+    for (int k=1; k<=CLOSE_APPROACH_REFINE_STEPS; k++){
+        double t_b = k==CLOSE_APPROACH_REFINE_STEPS ? t1 : t0 + (t1-t0)*k/CLOSE_APPROACH_REFINE_STEPS;
+        double g_b = range_rate(t_b);
+        if (g_a<0 && g_b>=0){
+            double t_min = find_root_brent(range_rate, t_a, t_b, g_a, g_b, CLOSE_APPROACH_TOLERANCE_DAYS);
+            double distance_au;
+            separation(t_min, &distance_au);
+            if (distance_au<=threshold_au && t_min<t1){
+                found.push_back({i, j, t_min, distance_au});
+            }
+        }
+        t_a = t_b;
+        g_a = g_b;
+    }
+}
+
+// Closest approaches within threshold_au between any two bodies of the
+// catalog in [start, end) days since J2000, screened slice_days at a time.
+// Sorted by date.
+inline std::vector<close_approach> find_close_approaches(const small_body_catalog* catalog, const double start_days_since_j2k, const double end_days_since_j2k, const double slice_days, const double threshold_au, thread_pool& pool){
+    const size_t n = catalog->n_bodies;
+    const size_t n_slices = end_days_since_j2k>start_days_since_j2k ? (size_t)ceil((end_days_since_j2k-start_days_since_j2k)/slice_days) : 0;
+
+    const double half_slice_days = 0.5*slice_days;
+    std::vector<double> radius_au(n), deviation_au(n);
+    for (size_t i=0; i<n; i++){
+        radius_au[i] = small_body_max_speed_au_per_day(catalog, i)*half_slice_days;
+        deviation_au[i] = 0.5*small_body_max_acceleration_au_per_day2(catalog, i)*half_slice_days*half_slice_days;
+    }
+
+    std::vector<std::vector<close_approach>> found(n_slices);
+    pool.run(n_slices, [&](size_t slice){
+        double t0 = start_days_since_j2k + slice*slice_days;
+        double t1 = std::min(t0+slice_days, end_days_since_j2k);
+        const double t_mid = t0+half_slice_days;
+        std::vector<double> states(6*n);
+        double* x = &states[0];
+        double* y = &states[n];
+        double* z = &states[2*n];
+        double* vx = &states[3*n];
+        double* vy = &states[4*n];
+        double* vz = &states[5*n];
+        small_body_catalog_states_in_j2k_ecliptic_frame(catalog, 0, n, t_mid, x, y, z, vx, vy, vz);
+
+        std::vector<std::pair<size_t, size_t>> pairs = close_approach_candidates(x, y, z, radius_au.data(), n, threshold_au);
+        for (const std::pair<size_t, size_t>& pair : pairs){
+            const size_t i = pair.first, j = pair.second;
+            // Closest approach of the straight-line relative motion within
+            // the slice, less how far the curvature can pull the bodies
+            double dx = x[i]-x[j], dy = y[i]-y[j], dz = z[i]-z[j];
+            double dvx = vx[i]-vx[j], dvy = vy[i]-vy[j], dvz = vz[i]-vz[j];
+            double dv2 = dvx*dvx + dvy*dvy + dvz*dvz;
+            double tau = dv2>0 ? -(dx*dvx + dy*dvy + dz*dvz)/dv2 : 0;
+            tau = std::max(-half_slice_days, std::min(half_slice_days, tau));
+            dx += dvx*tau;
+            dy += dvy*tau;
+            dz += dvz*tau;
+            if (sqrt(dx*dx + dy*dy + dz*dz) - deviation_au[i] - deviation_au[j]>threshold_au){
+                continue;
+            }
+            close_approach_refine(catalog, i, j, t0, t1, threshold_au, found[slice]);
+        }
+    });
+
+    std::vector<close_approach> approaches;
+    for (const std::vector<close_approach>& slice_approaches : found){
+        approaches.insert(approaches.end(), slice_approaches.begin(), slice_approaches.end());
+    }
+    std::sort(approaches.begin(), approaches.end(), [](const close_approach& a, const close_approach& b){
+        if (a.days_since_j2k!=b.days_since_j2k){
+            return a.days_since_j2k<b.days_since_j2k;
+        }
+        return a.body1<b.body1 || (a.body1==b.body1 && a.body2<b.body2);
+    });
+    return approaches;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+Ephemeris daemon: serves positions and longitudes of the planets over a
+Unix domain socket, see ephemeris_protocol.h for the requests and
+ephemeris_server.hpp for the serving.
+
+    ephemeris_daemon [--socket PATH] [--cache SNAPSHOTS] [--quantum SECONDS]
+
+--quantum is the resolution of the epochs answered for, 1 s by default;
+--cache the number of epochs kept, 4096 by default. SIGINT and SIGTERM
+stop the daemon, which then prints its cache statistics.
+*/
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include "../ephemeris_server.hpp"
+
+static void daemon_usage(const char* program){
+    fprintf(stderr, "usage: %s [--socket PATH] [--cache SNAPSHOTS] [--quantum SECONDS]\n", program);
+}
+
+int main(int argc, char** argv){
+    std::string socket_path = "/tmp/planets.sock";
+    long capacity = 4096;
+    double quantum_seconds = 1;
+    for (int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        if (arg=="--socket" && i+1<argc){
+            socket_path = argv[++i];
+        } else if (arg=="--cache" && i+1<argc){
+            capacity = atol(argv[++i]);
+        } else if (arg=="--quantum" && i+1<argc){
+            quantum_seconds = atof(argv[++i]);
+        } else {
+            daemon_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (capacity<1 || !(quantum_seconds>0)){
+        daemon_usage(argv[0]);
+        return 2;
+    }
+
+    // Signals are taken by a thread of their own, blocked everywhere else
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    snapshot_cache cache((size_t)capacity, quantum_seconds/86400.);
+    ephemeris_server server(cache);
+    if (server.listen_on(socket_path)!=0){
+        fprintf(stderr, "cannot listen on %s: %s\n", socket_path.c_str(), strerror(errno));
+        return 1;
+    }
+    std::thread signal_waiter([&]{
+        int signal_number;
+        sigwait(&signals, &signal_number);
+        server.stop();
+    });
+    fprintf(stderr, "listening on %s\n", socket_path.c_str());
+    server.run();
+
+    // run also returns on an accept error; wake the waiter in that case
+    pthread_kill(signal_waiter.native_handle(), SIGTERM);
+    signal_waiter.join();
+
+    snapshot_cache_stats stats = cache.statistics();
+    fprintf(stderr, "hits %llu, coalesced %llu, misses %llu, batches %llu, evictions %llu\n",
+        (unsigned long long)stats.hits, (unsigned long long)stats.coalesced, (unsigned long long)stats.misses,
+        (unsigned long long)stats.batches, (unsigned long long)stats.evictions);
+    return 0;
+}
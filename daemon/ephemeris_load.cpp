@@ -0,0 +1,158 @@
+/*
+Load generator for the ephemeris daemon: closed-loop clients, each on its
+own connection, sending requests for a handful of epochs around now and
+timing every response.
+
+    ephemeris_load [--socket PATH] [--clients N] [--seconds S] [--epochs K]
+                   [--pipeline DEPTH] [--kind icrf|ecliptic|longitude]
+
+Each client keeps DEPTH requests in flight, for epochs drawn at random
+from K epochs one second apart, so K sets how often the daemon's cache
+hits and how often concurrent requests coalesce. Prints the throughput
+and the latency percentiles, from sending a request to reading its
+response.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ephemeris_protocol.h"
+#include "../julian_date.h"
+
+struct load_options {
+    std::string socket_path = "/tmp/planets.sock";
+    int n_clients = 4;
+    double seconds = 5;
+    int n_epochs = 16;
+    int pipeline = 1;
+    int kind = EPHEMERIS_XYZ_ICRF;
+};
+
+struct client_result {
+    std::vector<double> latencies_ns;
+    long errors = 0;
+};
+
+static void load_client(const load_options& options, const int client, client_result* result){
+    typedef std::chrono::steady_clock clock;
+    int fd = ephemeris_connect(options.socket_path.c_str());
+    if (fd<0){
+        result->errors++;
+        return;
+    }
+    const double now_days = days_since_j2k_from_unix((double)time(NULL));
+    uint64_t random_state = 0x9e3779b97f4a7c15ull*(uint64_t)(client+1);
+    const clock::time_point deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(options.seconds));
+
+    std::vector<clock::time_point> sent(options.pipeline);
+    std::vector<unsigned char> requests(EPHEMERIS_REQUEST_SIZE*options.pipeline);
+    unsigned char response_bytes[EPHEMERIS_RESPONSE_SIZE];
+    uint64_t tag = 0;
+    while (clock::now()<deadline){
+        for (int i=0; i<options.pipeline; i++){
+            // xorshift64
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            ephemeris_request request;
+            request.kind = options.kind;
+            request.body_mask = EPHEMERIS_ALL_BODIES;
+            request.tag = tag+i;
+            request.days_since_j2k = now_days + (double)(random_state%(uint64_t)options.n_epochs)/86400.;
+            ephemeris_encode_request(&request, &requests[EPHEMERIS_REQUEST_SIZE*i]);
+        }
+        clock::time_point start = clock::now();
+        if (ephemeris_send_all(fd, requests.data(), requests.size())!=0){
+            result->errors++;
+            break;
+        }
+        bool failed = false;
+        for (int i=0; i<options.pipeline; i++){
+            ephemeris_response response;
+            if (ephemeris_receive_all(fd, response_bytes, sizeof(response_bytes))!=0
+                || ephemeris_decode_response(response_bytes, &response)!=0){
+                failed = true;
+                break;
+            }
+            if (response.status!=0 || response.tag!=tag+i){
+                result->errors++;
+            }
+            result->latencies_ns.push_back(std::chrono::duration<double, std::nano>(clock::now()-start).count());
+        }
+        if (failed){
+            result->errors++;
+            break;
+        }
+        tag += options.pipeline;
+    }
+    close(fd);
+}
+
+static double percentile(const std::vector<double>& sorted, const double fraction){
+    if (sorted.empty()){
+        return 0;
+    }
+    size_t index = std::min(sorted.size()-1, (size_t)(fraction*sorted.size()));
+    return sorted[index];
+}
+
+static void load_usage(const char* program){
+    fprintf(stderr, "usage: %s [--socket PATH] [--clients N] [--seconds S] [--epochs K] [--pipeline DEPTH] [--kind icrf|ecliptic|longitude]\n", program);
+}
+
+int main(int argc, char** argv){
+    load_options options;
+    for (int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        if (arg=="--socket" && i+1<argc){
+            options.socket_path = argv[++i];
+        } else if (arg=="--clients" && i+1<argc){
+            options.n_clients = atoi(argv[++i]);
+        } else if (arg=="--seconds" && i+1<argc){
+            options.seconds = atof(argv[++i]);
+        } else if (arg=="--epochs" && i+1<argc){
+            options.n_epochs = atoi(argv[++i]);
+        } else if (arg=="--pipeline" && i+1<argc){
+            options.pipeline = atoi(argv[++i]);
+        } else if (arg=="--kind" && i+1<argc){
+            std::string kind = argv[++i];
+            options.kind = kind=="icrf" ? EPHEMERIS_XYZ_ICRF : kind=="ecliptic" ? EPHEMERIS_XYZ_J2K_ECLIPTIC : kind=="longitude" ? EPHEMERIS_LONGITUDE : 0;
+        } else {
+            load_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.n_clients<1 || !(options.seconds>0) || options.n_epochs<1 || options.pipeline<1 || options.kind==0){
+        load_usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<client_result> results(options.n_clients);
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (int c=0; c<options.n_clients; c++){
+        clients.emplace_back(load_client, std::cref(options), c, &results[c]);
+    }
+    for (std::thread& client : clients){
+        client.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    std::vector<double> latencies;
+    long errors = 0;
+    for (const client_result& result : results){
+        latencies.insert(latencies.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+        errors += result.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("requests %zu in %.2f s: %.0f requests/s, %ld errors\n", latencies.size(), elapsed, latencies.size()/elapsed, errors);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+        percentile(latencies, 0.5)*1e-3, percentile(latencies, 0.9)*1e-3, percentile(latencies, 0.99)*1e-3,
+        percentile(latencies, 0.999)*1e-3, (latencies.empty() ? 0 : latencies.back())*1e-3);
+    return errors>0 ? 1 : 0;
+}
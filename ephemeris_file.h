@@ -0,0 +1,219 @@
+/*
+On-disk Chebyshev ephemerides, read through mmap.
+
+Layout, all offsets from the start of the file and all sections aligned
+to EPHEMERIS_FILE_ALIGNMENT bytes:
+
+    ephemeris_file_header           magic, endian tag, version, body count
+    ephemeris_file_body[n_bodies]   one record per body
+    coefficients                    per body, as in chebyshev_ephemeris
+
+Numbers are stored in the byte order of the machine that wrote the file.
+The endian tag lets a reader on a machine with the other byte order reject
+the file instead of misreading it. The reader maps the file read-only and
+evaluates straight from the mapping, so opening is a handful of page
+faults and every process reading the same file shares one copy in the page
+cache. It does not parse or allocate anything.
+*/
+
+#ifndef EPHEMERIS_FILE_H
+#define EPHEMERIS_FILE_H
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chebyshev_ephemeris.h"
+
+#define EPHEMERIS_FILE_MAGIC "SSDEPHEM"
+#define EPHEMERIS_FILE_ENDIAN_TAG 0x01020304u
+#define EPHEMERIS_FILE_VERSION 1
+#define EPHEMERIS_FILE_ALIGNMENT 64
+#define EPHEMERIS_FILE_NAME_LENGTH 24
+
+typedef struct ephemeris_file_header {
+    char magic[8];              // EPHEMERIS_FILE_MAGIC, not NUL-terminated
+    uint32_t endian_tag;        // EPHEMERIS_FILE_ENDIAN_TAG as written
+    uint32_t version;           // EPHEMERIS_FILE_VERSION
+    uint32_t n_bodies;
+    uint32_t reserved;
+    uint64_t file_size;         // Bytes, to detect truncated files
+    uint8_t padding[32];
+} ephemeris_file_header;
+
+typedef struct ephemeris_file_body {
+    char name[EPHEMERIS_FILE_NAME_LENGTH];  // NUL-padded
+    double start_days_since_j2k;
+    double segment_days;
+    double max_error_au;
+    uint32_t n_segments;
+    uint32_t n_coefficients;
+    uint64_t coefficients_offset;
+} ephemeris_file_body;
+
+typedef struct ephemeris_file {
+    const unsigned char* data;  // The mapping
+    size_t size;
+    const ephemeris_file_header* header;
+    const ephemeris_file_body* bodies;
+} ephemeris_file;
+
+SSD_INLINE uint64_t ephemeris_file_align(uint64_t offset){
+    return (offset + EPHEMERIS_FILE_ALIGNMENT-1) & ~(uint64_t)(EPHEMERIS_FILE_ALIGNMENT-1);
+}
+
+// Write n_bodies fitted ephemerides to path. Returns 0 on success, -1 on
+// bad arguments or I/O errors.
+SSD_INLINE int ephemeris_file_write(const char* path, const char* const* names, const chebyshev_ephemeris* ephemerides, const size_t n_bodies){
+    ephemeris_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EPHEMERIS_FILE_MAGIC, sizeof(header.magic));
+    header.endian_tag = EPHEMERIS_FILE_ENDIAN_TAG;
+    header.version = EPHEMERIS_FILE_VERSION;
+    header.n_bodies = (uint32_t)n_bodies;
+
+    uint64_t offset = ephemeris_file_align(sizeof(header) + n_bodies*sizeof(ephemeris_file_body));
+    for (size_t i=0; i<n_bodies; i++){
+        if (strlen(names[i])>=EPHEMERIS_FILE_NAME_LENGTH){
+            return -1;
+        }
+        offset = ephemeris_file_align(offset + (uint64_t)ephemerides[i].n_segments*3*ephemerides[i].n_coefficients*sizeof(double));
+    }
+    header.file_size = offset;
+
+    FILE* file = fopen(path, "wb");
+    if (file==NULL){
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file)==1;
+
+    offset = ephemeris_file_align(sizeof(header) + n_bodies*sizeof(ephemeris_file_body));
+    for (size_t i=0; i<n_bodies && ok; i++){
+        ephemeris_file_body body;
+        memset(&body, 0, sizeof(body));
+        size_t name_length = strlen(names[i]);
+        memcpy(body.name, names[i], name_length<sizeof(body.name) ? name_length : sizeof(body.name));
+        body.start_days_since_j2k = ephemerides[i].start_days_since_j2k;
+        body.segment_days = ephemerides[i].segment_days;
+        body.max_error_au = ephemerides[i].max_error_au;
+        body.n_segments = (uint32_t)ephemerides[i].n_segments;
+        body.n_coefficients = (uint32_t)ephemerides[i].n_coefficients;
+        body.coefficients_offset = offset;
+        ok = fwrite(&body, sizeof(body), 1, file)==1;
+        offset = ephemeris_file_align(offset + (uint64_t)body.n_segments*3*body.n_coefficients*sizeof(double));
+    }
+
+    static const unsigned char zeros[EPHEMERIS_FILE_ALIGNMENT] = {0};
+    for (size_t i=0; i<n_bodies && ok; i++){
+        long position = ftell(file);
+        size_t padding = ephemeris_file_align(position) - position;
+        size_t n_doubles = (size_t)ephemerides[i].n_segments*3*ephemerides[i].n_coefficients;
+        ok = fwrite(zeros, 1, padding, file)==padding
+          && fwrite(ephemerides[i].coefficients, sizeof(double), n_doubles, file)==n_doubles;
+    }
+    if (ok){
+        long position = ftell(file);
+        size_t padding = ephemeris_file_align(position) - position;
+        ok = fwrite(zeros, 1, padding, file)==padding;
+    }
+
+    if (fclose(file)!=0){
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+// Map path and check its header and body table. Returns 0 on success, -1
+// if the file cannot be mapped, was written with the other byte order or
+// another format version, is truncated, or has a body whose counts, span
+// or coefficients do not fit.
+SSD_INLINE int ephemeris_file_open(const char* path, ephemeris_file* ephemeris){
+    memset(ephemeris, 0, sizeof(*ephemeris));
+    int fd = open(path, O_RDONLY);
+    if (fd<0){
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(ephemeris_file_header)){
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data==MAP_FAILED){
+        return -1;
+    }
+
+    const ephemeris_file_header* header = (const ephemeris_file_header*)data;
+    const ephemeris_file_body* bodies = (const ephemeris_file_body*)(header+1);
+    int ok = memcmp(header->magic, EPHEMERIS_FILE_MAGIC, sizeof(header->magic))==0
+          && header->endian_tag==EPHEMERIS_FILE_ENDIAN_TAG
+          && header->version==EPHEMERIS_FILE_VERSION
+          && header->file_size==(uint64_t)st.st_size
+          && sizeof(*header) + (uint64_t)header->n_bodies*sizeof(*bodies)<=header->file_size;
+    for (uint32_t i=0; ok && i<header->n_bodies; i++){
+        const ephemeris_file_body* body = &bodies[i];
+        // Both counts become ints in chebyshev_ephemeris, and the
+        // coefficients are bounded by division so that a crafted count
+        // cannot wrap the size around
+        ok = body->n_segments>0 && body->n_segments<=INT_MAX
+          && body->n_coefficients>0 && body->n_coefficients<=INT_MAX
+          && isfinite(body->start_days_since_j2k)
+          && isfinite(body->segment_days) && body->segment_days>0
+          && isfinite(1./body->segment_days)    // Not denormal either
+          && body->coefficients_offset%EPHEMERIS_FILE_ALIGNMENT==0
+          && body->coefficients_offset<=header->file_size;
+        if (ok){
+            uint64_t bytes_per_segment = (uint64_t)3*body->n_coefficients*sizeof(double);
+            ok = body->n_segments<=(header->file_size - body->coefficients_offset)/bytes_per_segment;
+        }
+    }
+    if (!ok){
+        munmap(data, (size_t)st.st_size);
+        return -1;
+    }
+
+    ephemeris->data = (const unsigned char*)data;
+    ephemeris->size = (size_t)st.st_size;
+    ephemeris->header = header;
+    ephemeris->bodies = bodies;
+    return 0;
+}
+
+SSD_INLINE void ephemeris_file_close(ephemeris_file* ephemeris){
+    if (ephemeris->data!=NULL){
+        munmap((void*)ephemeris->data, ephemeris->size);
+    }
+    memset(ephemeris, 0, sizeof(*ephemeris));
+}
+
+// Index of the body called name, or -1.
+SSD_INLINE int ephemeris_file_find(const ephemeris_file* ephemeris, const char* name){
+    for (uint32_t i=0; i<ephemeris->header->n_bodies; i++){
+        if (strncmp(ephemeris->bodies[i].name, name, EPHEMERIS_FILE_NAME_LENGTH)==0){
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// A chebyshev_ephemeris whose coefficients point into the mapping. It stays
+// valid until the file is closed and must not be freed.
+SSD_INLINE void ephemeris_file_body_view(const ephemeris_file* ephemeris, const int index, chebyshev_ephemeris* view){
+    const ephemeris_file_body* body = &ephemeris->bodies[index];
+    view->start_days_since_j2k = body->start_days_since_j2k;
+    view->segment_days = body->segment_days;
+    view->segments_per_day = 1./body->segment_days;
+    view->n_segments = (int)body->n_segments;
+    view->n_coefficients = (int)body->n_coefficients;
+    view->max_error_au = body->max_error_au;
+    view->coefficients = (const double*)(ephemeris->data + body->coefficients_offset);
+    view->owned_coefficients = NULL;
+}
+
+#endif
@@ -0,0 +1,259 @@
+/*
+Wire format of the ephemeris daemon, and a blocking client for it.
+
+A client connects to the daemon's Unix domain stream socket and sends
+requests of EPHEMERIS_REQUEST_SIZE bytes, reading one response of
+EPHEMERIS_RESPONSE_SIZE bytes back for each, in order. A client may send
+several requests before reading the responses. All fields are
+little-endian:
+
+    request                             response
+    0   u32 EPHEMERIS_REQUEST_MAGIC     0   u32 EPHEMERIS_RESPONSE_MAGIC
+    4   u16 EPHEMERIS_PROTOCOL_VERSION  4   i32 status, 0 or -1
+    6   u16 kind                        8   u64 tag of the request
+    8   u32 body mask                   16  f64 epoch evaluated
+    12  u32 zero                        24  u32 body mask
+    16  u64 tag, echoed                 28  u32 number of values
+    24  f64 days since J2000            32  f64 values[24]
+
+Bit i of the body mask selects planet i, Mercury to Neptune. Positions
+are x, y, z in AU for each selected body in turn and longitudes are one
+value in rad per body. The daemon rounds the epoch to its quantum and
+answers for the rounded epoch, which the response carries.
+*/
+
+#ifndef EPHEMERIS_PROTOCOL_H
+#define EPHEMERIS_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "ssd_linkage.h"
+
+#define EPHEMERIS_REQUEST_MAGIC 0x51445353u     // "SSDQ"
+#define EPHEMERIS_RESPONSE_MAGIC 0x52445353u    // "SSDR"
+#define EPHEMERIS_PROTOCOL_VERSION 1
+#define EPHEMERIS_REQUEST_SIZE 32
+#define EPHEMERIS_RESPONSE_SIZE 224
+#define EPHEMERIS_MAX_VALUES 24
+#define EPHEMERIS_ALL_BODIES 0xffu
+
+typedef enum ephemeris_query_kind {
+    EPHEMERIS_XYZ_ICRF = 1,
+    EPHEMERIS_XYZ_J2K_ECLIPTIC = 2,
+    EPHEMERIS_LONGITUDE = 3
+} ephemeris_query_kind;
+
+typedef struct ephemeris_request {
+    int kind;                   // An ephemeris_query_kind
+    uint32_t body_mask;
+    uint64_t tag;               // Any value, returned with the response
+    double days_since_j2k;
+} ephemeris_request;
+
+typedef struct ephemeris_response {
+    int status;                 // 0, or -1 for a request the daemon rejected
+    uint64_t tag;
+    double days_since_j2k;      // The epoch after rounding to the quantum
+    uint32_t body_mask;
+    uint32_t n_values;
+    double values[EPHEMERIS_MAX_VALUES];
+} ephemeris_response;
+
+SSD_INLINE void ephemeris_store_u32(const uint32_t value, unsigned char* out){
+    for (int i=0; i<4; i++){
+        out[i] = (unsigned char)(value >> (8*i));
+    }
+}
+
+SSD_INLINE void ephemeris_store_u64(const uint64_t value, unsigned char* out){
+    for (int i=0; i<8; i++){
+        out[i] = (unsigned char)(value >> (8*i));
+    }
+}
+
+SSD_INLINE void ephemeris_store_f64(const double value, unsigned char* out){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    ephemeris_store_u64(bits, out);
+}
+
+SSD_INLINE uint32_t ephemeris_load_u32(const unsigned char* in){
+    uint32_t value = 0;
+    for (int i=3; i>=0; i--){
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+SSD_INLINE uint64_t ephemeris_load_u64(const unsigned char* in){
+    uint64_t value = 0;
+    for (int i=7; i>=0; i--){
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+SSD_INLINE double ephemeris_load_f64(const unsigned char* in){
+    uint64_t bits = ephemeris_load_u64(in);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Values a request asks for: 3 per body for positions, 1 for longitudes.
+SSD_INLINE uint32_t ephemeris_request_n_values(const ephemeris_request* request){
+    uint32_t n_bodies = 0;
+    for (int i=0; i<8; i++){
+        n_bodies += (request->body_mask >> i) & 1;
+    }
+    return request->kind==EPHEMERIS_LONGITUDE ? n_bodies : 3*n_bodies;
+}
+
+SSD_INLINE void ephemeris_encode_request(const ephemeris_request* request, unsigned char* out){
+    ephemeris_store_u32(EPHEMERIS_REQUEST_MAGIC, out);
+    out[4] = EPHEMERIS_PROTOCOL_VERSION;
+    out[5] = 0;
+    out[6] = (unsigned char)request->kind;
+    out[7] = (unsigned char)(request->kind >> 8);
+    ephemeris_store_u32(request->body_mask, out+8);
+    ephemeris_store_u32(0, out+12);
+    ephemeris_store_u64(request->tag, out+16);
+    ephemeris_store_f64(request->days_since_j2k, out+24);
+}
+
+// Returns 0, or -1 if the bytes are not a valid request; the tag is read
+// either way so that a rejection can be matched to its request.
+SSD_INLINE int ephemeris_decode_request(const unsigned char* in, ephemeris_request* request){
+    request->kind = in[6] | in[7] << 8;
+    request->body_mask = ephemeris_load_u32(in+8);
+    request->tag = ephemeris_load_u64(in+16);
+    request->days_since_j2k = ephemeris_load_f64(in+24);
+    if (ephemeris_load_u32(in)!=EPHEMERIS_REQUEST_MAGIC || (in[4] | in[5] << 8)!=EPHEMERIS_PROTOCOL_VERSION){
+        return -1;
+    }
+    if (request->kind<EPHEMERIS_XYZ_ICRF || request->kind>EPHEMERIS_LONGITUDE){
+        return -1;
+    }
+    if (request->body_mask==0 || (request->body_mask & ~EPHEMERIS_ALL_BODIES)!=0){
+        return -1;
+    }
+    // Finite and within some 27000 years of J2000
+    if (!(request->days_since_j2k>-1e7 && request->days_since_j2k<1e7)){
+        return -1;
+    }
+    return 0;
+}
+
+SSD_INLINE void ephemeris_encode_response(const ephemeris_response* response, unsigned char* out){
+    memset(out, 0, EPHEMERIS_RESPONSE_SIZE);
+    ephemeris_store_u32(EPHEMERIS_RESPONSE_MAGIC, out);
+    ephemeris_store_u32((uint32_t)response->status, out+4);
+    ephemeris_store_u64(response->tag, out+8);
+    ephemeris_store_f64(response->days_since_j2k, out+16);
+    ephemeris_store_u32(response->body_mask, out+24);
+    ephemeris_store_u32(response->n_values, out+28);
+    for (uint32_t i=0; i<response->n_values && i<EPHEMERIS_MAX_VALUES; i++){
+        ephemeris_store_f64(response->values[i], out+32+8*i);
+    }
+}
+
+// Returns 0, or -1 if the bytes are not a response.
+SSD_INLINE int ephemeris_decode_response(const unsigned char* in, ephemeris_response* response){
+    if (ephemeris_load_u32(in)!=EPHEMERIS_RESPONSE_MAGIC){
+        return -1;
+    }
+    response->status = (int)ephemeris_load_u32(in+4);
+    response->tag = ephemeris_load_u64(in+8);
+    response->days_since_j2k = ephemeris_load_f64(in+16);
+    response->body_mask = ephemeris_load_u32(in+24);
+    response->n_values = ephemeris_load_u32(in+28);
+    if (response->n_values>EPHEMERIS_MAX_VALUES){
+        return -1;
+    }
+    for (uint32_t i=0; i<response->n_values; i++){
+        response->values[i] = ephemeris_load_f64(in+32+8*i);
+    }
+    return 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Write or read exactly n bytes on a socket, retrying on interruption.
+// Returns 0, or -1 on an error or a closed connection.
+SSD_INLINE int ephemeris_send_all(const int fd, const unsigned char* data, size_t n){
+    while (n>0){
+        ssize_t sent = send(fd, data, n, MSG_NOSIGNAL);
+        if (sent<0 && errno==EINTR){
+            continue;
+        }
+        if (sent<=0){
+            return -1;
+        }
+        data += sent;
+        n -= (size_t)sent;
+    }
+    return 0;
+}
+
+SSD_INLINE int ephemeris_receive_all(const int fd, unsigned char* data, size_t n){
+    while (n>0){
+        ssize_t received = recv(fd, data, n, 0);
+        if (received<0 && errno==EINTR){
+            continue;
+        }
+        if (received<=0){
+            return -1;
+        }
+        data += received;
+        n -= (size_t)received;
+    }
+    return 0;
+}
+
+// Connect to the daemon listening at socket_path. Returns the socket, or
+// -1 on failure.
+SSD_INLINE int ephemeris_connect(const char* socket_path){
+    struct sockaddr_un address;
+    if (strlen(socket_path)>=sizeof(address.sun_path)){
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd<0){
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr*)&address, sizeof(address))!=0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// One request and its response over a connected socket. Returns 0, or -1
+// on an I/O error or a malformed response; a rejected request returns 0
+// with response->status -1.
+SSD_INLINE int ephemeris_query(const int fd, const ephemeris_request* request, ephemeris_response* response){
+    unsigned char request_bytes[EPHEMERIS_REQUEST_SIZE];
+    unsigned char response_bytes[EPHEMERIS_RESPONSE_SIZE];
+    ephemeris_encode_request(request, request_bytes);
+    if (ephemeris_send_all(fd, request_bytes, sizeof(request_bytes))!=0){
+        return -1;
+    }
+    if (ephemeris_receive_all(fd, response_bytes, sizeof(response_bytes))!=0){
+        return -1;
+    }
+    return ephemeris_decode_response(response_bytes, response);
+}
+#endif
+
+#endif
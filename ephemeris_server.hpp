@@ -0,0 +1,195 @@
+/*
+Ephemeris daemon: answers the requests of ephemeris_protocol.h on a Unix
+domain socket from a snapshot_cache shared by every connection.
+
+    ephemeris_server server(cache);
+    if (server.listen_on("/tmp/planets.sock")==0){
+        server.run();               // Until stop() is called
+    }
+
+Each connection is served by a thread of its own, which reads requests as
+they come and answers them in order, so a client may pipeline. Concurrent
+requests for one epoch, from any connections, share one evaluation.
+*/
+
+#ifndef EPHEMERIS_SERVER_HPP
+#define EPHEMERIS_SERVER_HPP
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "ephemeris_protocol.h"
+#include "snapshot_cache.hpp"
+
+// Response to one decoded request from a snapshot.
+inline void ephemeris_answer(const ephemeris_request* request, const ephemeris_snapshot& snapshot, ephemeris_response* response){
+    response->status = 0;
+    response->tag = request->tag;
+    response->days_since_j2k = snapshot.days_since_j2k;
+    response->body_mask = request->body_mask;
+    response->n_values = 0;
+    for (int p=0; p<8; p++){
+        if (((request->body_mask >> p) & 1)==0){
+            continue;
+        }
+        if (request->kind==EPHEMERIS_LONGITUDE){
+            response->values[response->n_values++] = snapshot.longitude_rad[p];
+            continue;
+        }
+        const double* xyz = request->kind==EPHEMERIS_XYZ_ICRF ? snapshot.xyz_icrf_au[p] : snapshot.xyz_j2k_ecliptic_au[p];
+        for (int axis=0; axis<3; axis++){
+            response->values[response->n_values++] = xyz[axis];
+        }
+    }
+}
+
+class ephemeris_server {
+public:
+    explicit ephemeris_server(snapshot_cache& cache) : cache(cache) {}
+
+    ~ephemeris_server(){
+        stop();
+        if (listen_fd>=0){
+            close(listen_fd);
+        }
+        if (!socket_path.empty()){
+            unlink(socket_path.c_str());
+        }
+    }
+
+    ephemeris_server(const ephemeris_server&) = delete;
+    ephemeris_server& operator=(const ephemeris_server&) = delete;
+
+    // Bind and listen, replacing a socket file left at path. Returns 0, or
+    // -1 on failure with errno set.
+    int listen_on(const std::string& path){
+        struct sockaddr_un address;
+        if (path.size()>=sizeof(address.sun_path)){
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size()+1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd<0){
+            return -1;
+        }
+        unlink(path.c_str());
+        if (bind(fd, (const struct sockaddr*)&address, sizeof(address))!=0 || listen(fd, SOMAXCONN)!=0){
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        listen_fd = fd;
+        socket_path = path;
+        return 0;
+    }
+
+    // Accept and serve connections until stop(), then wait for the
+    // connections to close.
+    void run(){
+        while (!stopping.load()){
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd<0){
+                if (errno==EINTR || errno==ECONNABORTED){
+                    continue;
+                }
+                break;
+            }
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            reap_connections();
+            if (stopping.load()){
+                close(fd);
+                break;
+            }
+            connections.emplace_back();
+            connection* added = &connections.back();
+            added->fd = fd;
+            added->thread = std::thread([this, added]{ serve(added); });
+        }
+        std::list<connection> open;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            open.swap(connections);
+        }
+        for (connection& c : open){
+            c.thread.join();
+        }
+    }
+
+    // Stop accepting and end the open connections; run returns once they
+    // have finished the request in hand. Safe from any thread.
+    void stop(){
+        stopping.store(true);
+        if (listen_fd>=0){
+            shutdown(listen_fd, SHUT_RDWR);
+        }
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (connection& c : connections){
+            if (!c.done){
+                shutdown(c.fd, SHUT_RDWR);
+            }
+        }
+    }
+
+private:
+    struct connection {
+        int fd = -1;
+        std::thread thread;
+        bool done = false;                  // fd closed, thread finishing
+    };
+
+    void serve(connection* c){
+        unsigned char request_bytes[EPHEMERIS_REQUEST_SIZE];
+        unsigned char response_bytes[EPHEMERIS_RESPONSE_SIZE];
+        while (ephemeris_receive_all(c->fd, request_bytes, sizeof(request_bytes))==0){
+            ephemeris_request request;
+            ephemeris_response response;
+            if (ephemeris_decode_request(request_bytes, &request)==0){
+                ephemeris_snapshot snapshot;
+                cache.get(request.days_since_j2k, &snapshot);
+                ephemeris_answer(&request, snapshot, &response);
+            } else {
+                memset(&response, 0, sizeof(response));
+                response.status = -1;
+                response.tag = request.tag;
+            }
+            ephemeris_encode_response(&response, response_bytes);
+            if (ephemeris_send_all(c->fd, response_bytes, sizeof(response_bytes))!=0){
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        close(c->fd);
+        c->done = true;
+    }
+
+    // Join the threads of closed connections; connections_mutex held.
+    void reap_connections(){
+        for (auto c=connections.begin(); c!=connections.end();){
+            if (c->done){
+                c->thread.join();
+                c = connections.erase(c);
+            } else {
+                ++c;
+            }
+        }
+    }
+
+    snapshot_cache& cache;
+    int listen_fd = -1;
+    std::string socket_path;
+    std::atomic<bool> stopping{false};
+    std::mutex connections_mutex;
+    std::list<connection> connections;
+};
+
+#endif
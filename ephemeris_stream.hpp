@@ -0,0 +1,66 @@
+/*
+On-demand ephemeris streams: the fused orbital states of a set of bodies at
+start, start+step, start+2*step, ..., for as long as the consumer keeps
+reading.
+
+ephemeris_stream is a lazy_generator (generator.hpp), so searches and
+pipelines stop computing as soon as they stop reading:
+
+    // The first ten days from now with Mars within a degree of 90 degrees
+    auto near_90 = [](const ephemeris_sample& sample){
+        return fabs(sample.states[0].longitude_rad - M_PI/2) < M_PI/180;
+    };
+    for (const ephemeris_sample& sample : ephemeris_stream({Mars}, now, 1., STATE_LONGITUDE)
+            | std::views::filter(near_90) | std::views::take(10)){
+        ...
+    }
+
+States are computed EPHEMERIS_STREAM_BLOCK epochs at a time with
+orbital_state_at_date, so the coroutine is resumed once per sample but
+evaluates in tight loops, and memory stays at one block whatever the span.
+The range is open-ended: bound it with std::views::take or take_while. The
+step may be negative to go back in time.
+*/
+
+#ifndef EPHEMERIS_STREAM_HPP
+#define EPHEMERIS_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "generator.hpp"
+
+#define EPHEMERIS_STREAM_BLOCK 64
+
+// One epoch of a stream. The states, one per body in the order the stream
+// was given them, belong to the stream and are reused for a later block
+// once the iterator moves on.
+struct ephemeris_sample {
+    uint64_t step;                  // Index of the epoch from the start
+    double days_since_j2k;
+    std::span<const orbital_state> states;
+};
+
+// States of bodies selected by the STATE_* flags in fields, at
+// start_days_since_j2k + k*step_days for k = 0, 1, ...
+inline lazy_generator<ephemeris_sample> ephemeris_stream(std::vector<keplerian_elements> bodies, const double start_days_since_j2k, const double step_days, const int fields = STATE_ALL){
+    const size_t n_bodies = bodies.size();
+    std::vector<orbital_state> states(EPHEMERIS_STREAM_BLOCK*n_bodies);
+    double days_since_j2k[EPHEMERIS_STREAM_BLOCK];
+    for (uint64_t first_step=0; ; first_step+=EPHEMERIS_STREAM_BLOCK){
+        for (size_t k=0; k<EPHEMERIS_STREAM_BLOCK; k++){
+            days_since_j2k[k] = start_days_since_j2k + (double)(first_step+k)*step_days;
+            for (size_t b=0; b<n_bodies; b++){
+                orbital_state_at_date(&bodies[b], days_since_j2k[k], fields, &states[k*n_bodies+b]);
+            }
+        }
+        for (size_t k=0; k<EPHEMERIS_STREAM_BLOCK; k++){
+            co_yield ephemeris_sample{first_step+k, days_since_j2k[k], std::span<const orbital_state>(states.data() + k*n_bodies, n_bodies)};
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+Fit the planets with chebyshev_ephemeris_build and write them to a file
+that ephemeris_file_open can map.
+
+    ephemeris_writer output.eph [start_days end_days [tolerance_au]]
+
+Days are counted from J2000; the default span is 1800-01-01 to 2050-01-01.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "planets.h"
+#include "chebyshev_ephemeris.h"
+#include "ephemeris_file.h"
+
+int main(int argc, char** argv){
+    if (argc!=2 && argc!=4 && argc!=5){
+        fprintf(stderr, "Usage: %s output.eph [start_days end_days [tolerance_au]]\n", argv[0]);
+        return 1;
+    }
+    double start_days_since_j2k = -73048.5;
+    double end_days_since_j2k = 18262.5;
+    double tolerance_au = 1e-6;
+    if (argc>=4){
+        start_days_since_j2k = atof(argv[2]);
+        end_days_since_j2k = atof(argv[3]);
+    }
+    if (argc==5){
+        tolerance_au = atof(argv[4]);
+    }
+
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    const char* names[8]={"Mercury", "Venus", "Earth_Moon_barycenter", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune"};
+    chebyshev_ephemeris ephemerides[8];
+
+    for (int i=0; i<8; i++){
+        if (chebyshev_ephemeris_build(&planets[i], start_days_since_j2k, end_days_since_j2k, CHEBYSHEV_DEFAULT_COEFFICIENTS, tolerance_au, &ephemerides[i])!=0){
+            fprintf(stderr, "Could not fit %s to %g AU\n", names[i], tolerance_au);
+            return 1;
+        }
+        printf("%s: %d segments of %f days, max error %g AU\n", names[i], ephemerides[i].n_segments, ephemerides[i].segment_days, ephemerides[i].max_error_au);
+    }
+
+    int status = ephemeris_file_write(argv[1], names, ephemerides, 8);
+    for (int i=0; i<8; i++){
+        chebyshev_ephemeris_free(&ephemerides[i]);
+    }
+    if (status!=0){
+        fprintf(stderr, "Could not write %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+Fast elementary functions for the ephemeris hot path, in scalar and 8-lane
+SIMD forms:
+
+    fast_sincos         sin and cos together, Cody-Waite reduction by pi/2
+                        and the Cephes minimax polynomials on [-pi/4, pi/4]
+    fast_atan2          Cephes' rational atan on [0, tan(pi/8)]-ish after
+                        folding the arguments into the first octant
+    fast_reduce_pi      x - 2pi*round(x/2pi), a three-part Cody-Waite
+                        subtraction instead of fmod
+    fast_reduce_180_deg the same in degrees, exact since 360 is
+
+orbits.h and kepler_solvers.h evaluate through the SSD_SINCOS, SSD_ATAN2,
+SSD_REDUCE_PI and SSD_REDUCE_180_DEG macros below. They are libm (sin, cos,
+atan2, fmod) by default and these functions when SSD_FAST_MATH is defined
+(the SSD_FAST_MATH CMake option), which has to be the same in every
+translation unit of a program. The batch path of orbits_batch.h always uses
+the SIMD sincos and uses the SIMD atan2 with SSD_FAST_MATH.
+
+Maximum error, as checked by the tests over every angle the scalar path
+evaluates for the eight planets (with the elements of planets_1800-2050.h
+every 2.5 days over 1800-2050 and of planets.h every 90 days over 3000 BC to
+3000 AD) and over random arguments:
+
+                        1800-2050   3000 BC-3000 AD   random
+    fast_sincos         2 ulp       2 ulp             2 ulp, |x| < 1e5
+    fast_atan2          2 ulp       2 ulp             2 ulp
+    fast_reduce_pi      0.6 ulp(pi) 0.6 ulp(pi)       1 ulp(pi)
+
+sincos and atan2 are in ulp of the libm result, so sin near a multiple of
+pi and cos near an odd multiple of pi/2 are held to their own small ulp;
+the reduction keeps them accurate. fast_reduce_pi is against the exact
+reduction: the libm expression rounds x + pi first and is itself off by
+up to ulp(x). The SIMD forms give the scalar results bit for bit. The
+scalar fast_sincos falls back to libm for |x| >=
+FAST_MATH_MAX_SINCOS_ARGUMENT, where the three-part reduction runs out of
+bits; the SIMD form does not and is only for arguments below it.
+fast_atan2 is for finite arguments; signed zeros give libm's results.
+*/
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "ssd_linkage.h"
+
+#define FAST_MATH_MAX_SINCOS_ARGUMENT 1e5
+
+// pi/2 in three parts, the first two short enough that q times them is
+// exact for |q| < 2^25; 2pi is four times that
+#define FAST_MATH_PIO2_1 1.57079632580280303955e0
+#define FAST_MATH_PIO2_2 9.92093573959351715530e-10
+#define FAST_MATH_PIO2_3 5.72118872610983179676e-18
+#define FAST_MATH_PIO2_LOW 6.123233995736765886130e-17 // pi/2 - (double)(pi/2)
+#define FAST_MATH_ROUND_MAGIC 6755399441055744.0       // 1.5*2^52
+
+SSD_INLINE double fast_sin_polynomial(const double r, const double z){
+    double p = z*1.58962301576546568060e-10 - 2.50507477628578072866e-8;
+    p = p*z + 2.75573136213857245213e-6;
+    p = p*z - 1.98412698295895385996e-4;
+    p = p*z + 8.33333333332211858878e-3;
+    p = p*z - 1.66666666666666307295e-1;
+    return r + r*z*p;
+}
+
+SSD_INLINE double fast_cos_polynomial(const double z){
+    double p = z*-1.13585365213876817300e-11 + 2.08757008419747316778e-9;
+    p = p*z - 2.75573141792967388112e-7;
+    p = p*z + 2.48015872888517045348e-5;
+    p = p*z - 1.38888888888730564116e-3;
+    p = p*z + 4.16666666666665929218e-2;
+    return 1.0 - 0.5*z + z*z*p;
+}
+
+SSD_INLINE void fast_sincos(const double x, double* s, double* c){
+    if (!(fabs(x)<FAST_MATH_MAX_SINCOS_ARGUMENT)){
+        *s = sin(x);
+        *c = cos(x);
+        return;
+    }
+    double q = x*(2./M_PI) + FAST_MATH_ROUND_MAGIC;
+    int64_t quadrant;
+    memcpy(&quadrant, &q, sizeof(quadrant));
+    q -= FAST_MATH_ROUND_MAGIC;
+
+    double r = x - q*FAST_MATH_PIO2_1;
+    r -= q*FAST_MATH_PIO2_2;
+    r -= q*FAST_MATH_PIO2_3;
+    double z = r*r;
+    double sin_r = fast_sin_polynomial(r, z);
+    double cos_r = fast_cos_polynomial(z);
+
+    // Odd quadrants swap sin and cos; quadrants 2 and 3 flip the sign of
+    // sin, quadrants 1 and 2 flip the sign of cos.
+    double sin_x = quadrant & 1 ? cos_r : sin_r;
+    double cos_x = quadrant & 1 ? sin_r : cos_r;
+    *s = quadrant & 2 ? -sin_x : sin_x;
+    *c = (quadrant+1) & 2 ? -cos_x : cos_x;
+}
+
+// Cephes' atan(u) for u in [0, 1]: above 0.66 through atan((u-1)/(u+1)).
+SSD_INLINE double fast_atan_unit(const double u){
+    int big = u>0.66;
+    double w = big ? (u-1)/(u+1) : u;
+    double z = w*w;
+    double p = z*-8.750608600031904122785e-1 - 1.615753718733365076637e1;
+    p = p*z - 7.500855792314704667340e1;
+    p = p*z - 1.228866684490136173410e2;
+    p = p*z - 6.485021904942025371773e1;
+    double q = z + 2.485846490142306297962e1;
+    q = q*z + 1.650270098316988542046e2;
+    q = q*z + 4.328810604912902668951e2;
+    q = q*z + 4.853903996359136964868e2;
+    q = q*z + 1.945506571482613964425e2;
+    double a = w + w*z*p/q;
+    return big ? M_PI/4 + (a + 0.5*FAST_MATH_PIO2_LOW) : a;
+}
+
+SSD_INLINE double fast_atan2(const double y, const double x){
+    double ax = fabs(x), ay = fabs(y);
+    int swap = ay>ax;
+    double num = swap ? ax : ay, den = swap ? ay : ax;
+    double a = fast_atan_unit(den>0 ? num/den : 0);
+    if (swap){
+        a = (M_PI/2 - a) + FAST_MATH_PIO2_LOW;
+    }
+    if (signbit(x)){
+        a = (M_PI - a) + 2*FAST_MATH_PIO2_LOW;
+    }
+    return copysign(a, y);
+}
+
+SSD_INLINE double fast_reduce_pi(const double x){
+    double k = (x*(0.5/M_PI) + FAST_MATH_ROUND_MAGIC) - FAST_MATH_ROUND_MAGIC;
+    double r = x - k*(4*FAST_MATH_PIO2_1);
+    r -= k*(4*FAST_MATH_PIO2_2);
+    r -= k*(4*FAST_MATH_PIO2_3);
+    return r;
+}
+
+SSD_INLINE double fast_reduce_180_deg(const double x){
+    double k = (x*(1./360.) + FAST_MATH_ROUND_MAGIC) - FAST_MATH_ROUND_MAGIC;
+    return x - k*360.;
+}
+
+// The libm counterparts, wrapping arguments below -pi (or -180) into the
+// range too, which fmod alone does not.
+SSD_INLINE double libm_reduce_pi(const double x){
+    double r = fmod(x+M_PI, 2*M_PI);
+    return (r<0 ? r+2*M_PI : r) - M_PI;
+}
+
+SSD_INLINE double libm_reduce_180_deg(const double x){
+    double r = fmod(x+180., 360.);
+    return (r<0 ? r+360. : r) - 180.;
+}
+
+#ifdef SSD_FAST_MATH
+#define SSD_SINCOS(x, s, c) fast_sincos(x, s, c)
+#define SSD_ATAN2(y, x) fast_atan2(y, x)
+#define SSD_REDUCE_PI(x) fast_reduce_pi(x)
+#define SSD_REDUCE_180_DEG(x) fast_reduce_180_deg(x)
+#else
+#define SSD_SINCOS(x, s, c) (*(s) = sin(x), *(c) = cos(x))
+#define SSD_ATAN2(y, x) atan2(y, x)
+#define SSD_REDUCE_PI(x) libm_reduce_pi(x)
+#define SSD_REDUCE_180_DEG(x) libm_reduce_180_deg(x)
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FAST_MATH_SIMD 1
+
+typedef double fast_v8d __attribute__((vector_size(64)));
+typedef long long fast_v8i __attribute__((vector_size(64)));
+
+#define FAST_MATH_SIMD_INLINE SSD_INLINE __attribute__((always_inline))
+#define FAST_V8_SELECT(mask, a, b) ((fast_v8d)(((fast_v8i)(a) & (mask)) | ((fast_v8i)(b) & ~(mask))))
+#define FAST_V8_SIGN_BIT ((fast_v8i){INT64_MIN, INT64_MIN, INT64_MIN, INT64_MIN, INT64_MIN, INT64_MIN, INT64_MIN, INT64_MIN})
+
+// fast_sincos on 8 lanes, for |x| < FAST_MATH_MAX_SINCOS_ARGUMENT.
+FAST_MATH_SIMD_INLINE void fast_v8_sincos(const fast_v8d* x, fast_v8d* s, fast_v8d* c){
+    fast_v8d q = (*x*(2./M_PI) + FAST_MATH_ROUND_MAGIC);
+    fast_v8i quadrant = (fast_v8i)q;
+    q = q - FAST_MATH_ROUND_MAGIC;
+
+    fast_v8d r = *x - q*FAST_MATH_PIO2_1;
+    r = r - q*FAST_MATH_PIO2_2;
+    r = r - q*FAST_MATH_PIO2_3;
+    fast_v8d z = r*r;
+
+    fast_v8d ps = z*1.58962301576546568060e-10 - 2.50507477628578072866e-8;
+    ps = ps*z + 2.75573136213857245213e-6;
+    ps = ps*z - 1.98412698295895385996e-4;
+    ps = ps*z + 8.33333333332211858878e-3;
+    ps = ps*z - 1.66666666666666307295e-1;
+    fast_v8d sin_r = r + r*z*ps;
+
+    fast_v8d pc = z*-1.13585365213876817300e-11 + 2.08757008419747316778e-9;
+    pc = pc*z - 2.75573141792967388112e-7;
+    pc = pc*z + 2.48015872888517045348e-5;
+    pc = pc*z - 1.38888888888730564116e-3;
+    pc = pc*z + 4.16666666666665929218e-2;
+    fast_v8d cos_r = 1.0 - 0.5*z + z*z*pc;
+
+    fast_v8i swap = -(quadrant & 1);
+    fast_v8i sin_bits = ((fast_v8i)sin_r & ~swap) | ((fast_v8i)cos_r & swap);
+    fast_v8i cos_bits = ((fast_v8i)cos_r & ~swap) | ((fast_v8i)sin_r & swap);
+    sin_bits ^= (quadrant & 2) << 62;
+    cos_bits ^= ((quadrant+1) & 2) << 62;
+    *s = (fast_v8d)sin_bits;
+    *c = (fast_v8d)cos_bits;
+}
+
+// fast_atan2 on 8 lanes, with the same arithmetic lane by lane.
+FAST_MATH_SIMD_INLINE void fast_v8_atan2(const fast_v8d* y, const fast_v8d* x, fast_v8d* result){
+    const fast_v8i sign_bit = FAST_V8_SIGN_BIT;
+    const fast_v8d zero = {0, 0, 0, 0, 0, 0, 0, 0};
+    fast_v8d ax = (fast_v8d)((fast_v8i)*x & ~sign_bit);
+    fast_v8d ay = (fast_v8d)((fast_v8i)*y & ~sign_bit);
+    fast_v8i swap = ay > ax;
+    fast_v8d num = FAST_V8_SELECT(swap, ax, ay);
+    fast_v8d den = FAST_V8_SELECT(swap, ay, ax);
+    fast_v8i nonzero = den > zero;
+    fast_v8d u = FAST_V8_SELECT(nonzero, num/FAST_V8_SELECT(nonzero, den, zero+1.0), zero);
+
+    fast_v8i big = u > 0.66;
+    fast_v8d w = FAST_V8_SELECT(big, (u-1)/(u+1), u);
+    fast_v8d z = w*w;
+    fast_v8d p = z*-8.750608600031904122785e-1 - 1.615753718733365076637e1;
+    p = p*z - 7.500855792314704667340e1;
+    p = p*z - 1.228866684490136173410e2;
+    p = p*z - 6.485021904942025371773e1;
+    fast_v8d q = z + 2.485846490142306297962e1;
+    q = q*z + 1.650270098316988542046e2;
+    q = q*z + 4.328810604912902668951e2;
+    q = q*z + 4.853903996359136964868e2;
+    q = q*z + 1.945506571482613964425e2;
+    fast_v8d a = w + w*z*p/q;
+    a = FAST_V8_SELECT(big, M_PI/4 + (a + 0.5*FAST_MATH_PIO2_LOW), a);
+
+    a = FAST_V8_SELECT(swap, (M_PI/2 - a) + FAST_MATH_PIO2_LOW, a);
+    fast_v8i negative_x = ((fast_v8i)*x & sign_bit)!=0;
+    a = FAST_V8_SELECT(negative_x, (M_PI - a) + 2*FAST_MATH_PIO2_LOW, a);
+    *result = (fast_v8d)(((fast_v8i)a & ~sign_bit) | ((fast_v8i)*y & sign_bit));
+}
+
+// fast_reduce_pi on 8 lanes.
+FAST_MATH_SIMD_INLINE void fast_v8_reduce_pi(const fast_v8d* x, fast_v8d* result){
+    fast_v8d k = (*x*(0.5/M_PI) + FAST_MATH_ROUND_MAGIC) - FAST_MATH_ROUND_MAGIC;
+    fast_v8d r = *x - k*(4*FAST_MATH_PIO2_1);
+    r = r - k*(4*FAST_MATH_PIO2_2);
+    *result = r - k*(4*FAST_MATH_PIO2_3);
+}
+
+#endif // FAST_MATH_SIMD
+
+#endif
@@ -0,0 +1,125 @@
+/*
+Lazy generator for C++20 coroutines, a minimal stand-in for C++23's
+std::generator.
+
+A coroutine returning lazy_generator<T> runs only when its consumer asks
+for the next value, up to its next co_yield, and is destroyed with the
+generator, so a consumer that stops early never pays for the values it did
+not take. lazy_generator is a move-only input view, so it composes with
+std::views::filter, take, take_while and transform:
+
+    for (const T& value : producer() | std::views::take(3)){ ... }
+
+A yielded value lives in the coroutine and is valid until the iterator is
+incremented; copy what needs to outlive that. Exceptions thrown in the
+coroutine are rethrown from begin() or operator++. Needs C++20.
+*/
+
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+template <typename T>
+class lazy_generator : public std::ranges::view_interface<lazy_generator<T>> {
+public:
+    struct promise_type {
+        const T* value = nullptr;
+        std::exception_ptr exception;
+
+        lazy_generator get_return_object(){
+            return lazy_generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+        // A yielded temporary lives until the coroutine resumes
+        std::suspend_always yield_value(const T& yielded) noexcept {
+            value = std::addressof(yielded);
+            return {};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception(){
+            exception = std::current_exception();
+        }
+        // Generators yield; they do not await
+        template <typename U>
+        std::suspend_never await_transform(U&&) = delete;
+    };
+
+    class iterator {
+    public:
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+        const T& operator*() const {
+            return *coroutine.promise().value;
+        }
+        iterator& operator++(){
+            lazy_generator::advance(coroutine);
+            return *this;
+        }
+        void operator++(int){
+            ++*this;
+        }
+        friend bool operator==(const iterator& it, std::default_sentinel_t){
+            return !it.coroutine || it.coroutine.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> coroutine = nullptr;
+    };
+
+    lazy_generator() = default;
+    lazy_generator(lazy_generator&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    lazy_generator& operator=(lazy_generator&& other) noexcept {
+        if (this!=&other){
+            if (coroutine){
+                coroutine.destroy();
+            }
+            coroutine = std::exchange(other.coroutine, nullptr);
+        }
+        return *this;
+    }
+    lazy_generator(const lazy_generator&) = delete;
+    lazy_generator& operator=(const lazy_generator&) = delete;
+
+    ~lazy_generator(){
+        if (coroutine){
+            coroutine.destroy();
+        }
+    }
+
+    // Runs the coroutine to its first co_yield. Call once.
+    iterator begin(){
+        if (coroutine){
+            advance(coroutine);
+        }
+        return iterator(coroutine);
+    }
+    std::default_sentinel_t end() const noexcept {
+        return std::default_sentinel;
+    }
+
+private:
+    explicit lazy_generator(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+    static void advance(std::coroutine_handle<promise_type> coroutine){
+        coroutine.resume();
+        if (coroutine.promise().exception){
+            std::rethrow_exception(std::exchange(coroutine.promise().exception, nullptr));
+        }
+    }
+
+    std::coroutine_handle<promise_type> coroutine = nullptr;
+};
+
+#endif
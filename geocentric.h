@@ -0,0 +1,156 @@
+/*
+The sky seen from the Earth: geocentric vectors, right ascension and
+declination in the ICRF frame, and the angular separation of every pair of
+bodies, from one solve of Kepler's equation per planet.
+
+sky_snapshot_at_date computes the heliocentric state of each of the eight
+planets once, with orbital_state_at_date, and derives everything else from
+those states. The observer is the Earth-Moon barycenter, which the elements
+describe; the Earth itself is at most 4700 km away from it.
+
+With SKY_LIGHT_TIME each body is placed where it was when the light seen at
+the epoch left it. The light time is iterated on the cached state, moved
+back along its orbit by a second-order expansion with the Sun's gravity,
+r(t-tau) = r - tau v - tau^2 GM r/(2|r|^3), instead of solving Kepler's
+equation again; the expansion errs by less than 1e-8 AU even for Mercury.
+*/
+
+#ifndef GEOCENTRIC_H
+#define GEOCENTRIC_H
+
+#include <math.h>
+#include <stddef.h>
+#include "keplerian_elements.h"
+#include "orbits.h"
+
+#define SKY_LIGHT_TIME 0x01                         // Correct for light time
+#define SKY_N_TARGETS 8
+#define SKY_LIGHT_TIME_ITERATIONS 3
+#define SPEED_OF_LIGHT_AU_PER_DAY 173.1446326742403 // 299792.458 km/s
+
+// What the sky_snapshot arrays are indexed by: the Sun and the planets
+// other than the Earth.
+typedef enum sky_target {
+    SKY_SUN = 0,
+    SKY_MERCURY,
+    SKY_VENUS,
+    SKY_MARS,
+    SKY_JUPITER,
+    SKY_SATURN,
+    SKY_URANUS,
+    SKY_NEPTUNE
+} sky_target;
+
+typedef struct sky_snapshot {
+    double days_since_j2k;
+
+    // Heliocentric states of Mercury to Neptune, ICRF frame
+    double x_helio_au[8], y_helio_au[8], z_helio_au[8];
+    double vx_helio_au_per_day[8], vy_helio_au_per_day[8], vz_helio_au_per_day[8];
+
+    // Geocentric, by sky_target, ICRF frame
+    double x_geo_au[SKY_N_TARGETS], y_geo_au[SKY_N_TARGETS], z_geo_au[SKY_N_TARGETS];
+    double distance_au[SKY_N_TARGETS];
+    double light_time_days[SKY_N_TARGETS];          // Zero without SKY_LIGHT_TIME
+    double ra_rad[SKY_N_TARGETS];                   // [0, 2pi)
+    double dec_rad[SKY_N_TARGETS];                  // [-pi/2, pi/2]
+
+    // Angle between each pair of targets as seen from the Earth, rad
+    double separation_rad[SKY_N_TARGETS][SKY_N_TARGETS];
+} sky_snapshot;
+
+// Planet of planets.h, in Mercury to Neptune order, behind each target;
+// -1 for the Sun.
+SSD_INLINE int sky_target_planet(const int target){
+    return target==SKY_SUN ? -1 : target<=SKY_VENUS ? target-1 : target;
+}
+
+// Position of planet p of the snapshot tau days before its epoch.
+SSD_INLINE void sky_helio_before(const sky_snapshot* sky, const int p, const double tau, double* x, double* y, double* z){
+    double x0 = sky->x_helio_au[p], y0 = sky->y_helio_au[p], z0 = sky->z_helio_au[p];
+    double r = sqrt(x0*x0 + y0*y0 + z0*z0);
+    double half_acceleration = -0.5*GM_SUN_AU3_PER_DAY2/(r*r*r)*tau*tau;
+    *x = x0 - tau*sky->vx_helio_au_per_day[p] + half_acceleration*x0;
+    *y = y0 - tau*sky->vy_helio_au_per_day[p] + half_acceleration*y0;
+    *z = z0 - tau*sky->vz_helio_au_per_day[p] + half_acceleration*z0;
+}
+
+// The sky at days_since_j2k for the eight planets of planets (Mercury to
+// Neptune, the Earth-Moon barycenter third), as the elements of planets.h
+// or planets_1800-2050.h. flags is 0 or SKY_LIGHT_TIME.
+SSD_INLINE void sky_snapshot_at_date(const keplerian_elements* planets, const double days_since_j2k, const int flags, sky_snapshot* sky){
+    const int light_time = flags & SKY_LIGHT_TIME;
+    sky->days_since_j2k = days_since_j2k;
+    for (int p=0; p<8; p++){
+        orbital_state state;
+        orbital_state_at_date(&planets[p], days_since_j2k, light_time ? STATE_ICRF | STATE_VELOCITY : STATE_ICRF, &state);
+        sky->x_helio_au[p] = state.x_eq_au;
+        sky->y_helio_au[p] = state.y_eq_au;
+        sky->z_helio_au[p] = state.z_eq_au;
+        sky->vx_helio_au_per_day[p] = light_time ? state.vx_eq_au_per_day : 0;
+        sky->vy_helio_au_per_day[p] = light_time ? state.vy_eq_au_per_day : 0;
+        sky->vz_helio_au_per_day[p] = light_time ? state.vz_eq_au_per_day : 0;
+    }
+
+    // The Earth is the observer, at the epoch itself
+    const double x_earth = sky->x_helio_au[2], y_earth = sky->y_helio_au[2], z_earth = sky->z_helio_au[2];
+    double unit[SKY_N_TARGETS][3];
+    for (int target=0; target<SKY_N_TARGETS; target++){
+        int p = sky_target_planet(target);
+        double x = -x_earth, y = -y_earth, z = -z_earth;
+        if (p>=0){
+            x += sky->x_helio_au[p];
+            y += sky->y_helio_au[p];
+            z += sky->z_helio_au[p];
+        }
+        double tau = 0;
+        if (light_time && p>=0){
+            for (int i=0; i<SKY_LIGHT_TIME_ITERATIONS; i++){
+                tau = sqrt(x*x + y*y + z*z)/SPEED_OF_LIGHT_AU_PER_DAY;
+                sky_helio_before(sky, p, tau, &x, &y, &z);
+                x -= x_earth;
+                y -= y_earth;
+                z -= z_earth;
+            }
+        } else if (light_time){
+            // The Sun does not move in the heliocentric frame
+            tau = sqrt(x*x + y*y + z*z)/SPEED_OF_LIGHT_AU_PER_DAY;
+        }
+        double distance = sqrt(x*x + y*y + z*z);
+        double ra = atan2(y, x);
+        sky->x_geo_au[target] = x;
+        sky->y_geo_au[target] = y;
+        sky->z_geo_au[target] = z;
+        sky->distance_au[target] = distance;
+        sky->light_time_days[target] = tau;
+        sky->ra_rad[target] = ra<0 ? ra + 2*M_PI : ra;
+        sky->dec_rad[target] = atan2(z, sqrt(x*x + y*y));
+        unit[target][0] = x/distance;
+        unit[target][1] = y/distance;
+        unit[target][2] = z/distance;
+    }
+
+    // atan2 of the cross and dot products stays accurate for small and
+    // near-pi angles, where acos of the dot product does not
+    for (int i=0; i<SKY_N_TARGETS; i++){
+        sky->separation_rad[i][i] = 0;
+        for (int j=i+1; j<SKY_N_TARGETS; j++){
+            double cx = unit[i][1]*unit[j][2] - unit[i][2]*unit[j][1];
+            double cy = unit[i][2]*unit[j][0] - unit[i][0]*unit[j][2];
+            double cz = unit[i][0]*unit[j][1] - unit[i][1]*unit[j][0];
+            double dot = unit[i][0]*unit[j][0] + unit[i][1]*unit[j][1] + unit[i][2]*unit[j][2];
+            double separation = atan2(sqrt(cx*cx + cy*cy + cz*cz), dot);
+            sky->separation_rad[i][j] = separation;
+            sky->separation_rad[j][i] = separation;
+        }
+    }
+}
+
+// sky_snapshot_at_date at n epochs.
+SSD_INLINE void sky_snapshots_at_dates(const keplerian_elements* planets, const double* days_since_j2k, const size_t n, const int flags, sky_snapshot* skies){
+    for (size_t k=0; k<n; k++){
+        sky_snapshot_at_date(planets, days_since_j2k[k], flags, &skies[k]);
+    }
+}
+
+#endif
@@ -0,0 +1,290 @@
+/*
+UTC calendar dates and ISO-8601 timestamps to days since J2000.
+
+J2000 is 2000-01-01 12:00 UTC, and a day is 86400 seconds, as with time_t:
+leap seconds are not counted. The conversion is plain integer arithmetic on
+the proleptic Gregorian calendar, so unlike mktime it does not depend on
+the TZ of the process, takes no locks and can be evaluated at compile time
+in C++.
+*/
+
+#ifndef JULIAN_DATE_H
+#define JULIAN_DATE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ssd_linkage.h"
+
+#if defined(__cplusplus) && __cplusplus>=201402L
+#define JULIAN_DATE_CONSTEXPR constexpr
+#else
+#define JULIAN_DATE_CONSTEXPR SSD_INLINE
+#endif
+
+#define J2000_UNIX_SECONDS 946728000.           // 2000-01-01 12:00:00 UTC
+#define J2000_JULIAN_DATE 2451545.0
+#define J2000_DAYS_SINCE_UNIX_EPOCH 10957       // To 2000-01-01 00:00 UTC
+#define JULIAN_DATE_ISO8601_FIXED_LENGTH 19     // "YYYY-MM-DDThh:mm:ss"
+
+// Days from 1970-01-01 to year-month-day (month 1-12) in the proleptic
+// Gregorian calendar. Years are shifted by 4800, a multiple of the 400-year
+// cycle, so that every division is of a non-negative number: valid from
+// -4800 on and free of branches.
+JULIAN_DATE_CONSTEXPR long days_from_civil(const long year, const int month, const int day){
+    const long y = year + 4800 - (month<=2);
+    const long era = y/400;
+    const long year_of_era = y - era*400;
+    const long day_of_year = (153*(month + (month>2 ? -3 : 9)) + 2)/5 + day - 1;
+    const long day_of_era = year_of_era*365 + year_of_era/4 - year_of_era/100 + day_of_year;
+    return era*146097 + day_of_era - 719468 - 12*146097;
+}
+
+// Both are bitwise on 0/1 ints rather than short-circuit, so that they
+// stay branch-free in vectorized loops.
+JULIAN_DATE_CONSTEXPR int is_leap_year(const long year){
+    return ((year%4==0) & (year%100!=0)) | (year%400==0);
+}
+
+// 31 for odd months to July and even months from August, 30 otherwise,
+// with February 2 or 1 day shorter.
+JULIAN_DATE_CONSTEXPR int days_in_month(const long year, const int month){
+    return 30 + ((month + (month>7))&1) - (month==2)*(2 - is_leap_year(year));
+}
+
+// Days since J2000 of a UTC date and time of day.
+JULIAN_DATE_CONSTEXPR double days_since_j2k_from_utc(const long year, const int month, const int day, const int hour, const int minute, const double second){
+    return (double)(days_from_civil(year, month, day) - J2000_DAYS_SINCE_UNIX_EPOCH)
+         + ((double)(hour*3600 + minute*60 - 43200) + second)/86400.;
+}
+
+// Days since J2000 of seconds since the Unix epoch, such as time(NULL).
+JULIAN_DATE_CONSTEXPR double days_since_j2k_from_unix(const double unix_seconds){
+    return (unix_seconds - J2000_UNIX_SECONDS)/86400.;
+}
+
+JULIAN_DATE_CONSTEXPR double julian_date_from_days_since_j2k(const double days_since_j2k){
+    return J2000_JULIAN_DATE + days_since_j2k;
+}
+
+// Reads n digits as a number, or -1 if any of them is not a digit.
+SSD_INLINE long julian_date_digits(const char* text, const int n){
+    long value = 0;
+    for (int i=0; i<n; i++){
+        unsigned digit = (unsigned)(text[i]-'0');
+        if (digit>9){
+            return -1;
+        }
+        value = 10*value + digit;
+    }
+    return value;
+}
+
+// Parse one ISO-8601 timestamp of length characters (not NUL-terminated):
+//
+//     YYYY-MM-DD[(T| )hh:mm[:ss[.fff...]]][Z|(+|-)hh[:]mm|(+|-)hh]
+//
+// A missing time of day is midnight and a missing offset is UTC. Returns 0
+// and sets *days_since_j2k on success, -1 if the text is not such a
+// timestamp or names a date that does not exist.
+SSD_INLINE int iso8601_to_days_since_j2k(const char* text, const size_t length, double* days_since_j2k){
+    const char* end = text + length;
+    if (length<10 || text[4]!='-' || text[7]!='-'){
+        return -1;
+    }
+    long year = julian_date_digits(text, 4);
+    long month = julian_date_digits(text+5, 2);
+    long day = julian_date_digits(text+8, 2);
+    if (year<0 || month<1 || month>12 || day<1 || day>days_in_month(year, (int)month)){
+        return -1;
+    }
+    const char* p = text+10;
+
+    long hour = 0, minute = 0;
+    double second = 0;
+    if (p<end && (*p=='T' || *p==' ')){
+        if (end-p<6 || p[3]!=':'){
+            return -1;
+        }
+        hour = julian_date_digits(p+1, 2);
+        minute = julian_date_digits(p+4, 2);
+        if (hour<0 || hour>23 || minute<0 || minute>59){
+            return -1;
+        }
+        p += 6;
+        if (p<end && *p==':'){
+            long whole = end-p>=3 ? julian_date_digits(p+1, 2) : -1;
+            if (whole<0 || whole>60){ // 60 for a leap second
+                return -1;
+            }
+            second = (double)whole;
+            p += 3;
+            if (p<end && (*p=='.' || *p==',')){
+                double scale = 0.1;
+                p++;
+                if (p==end || (unsigned)(*p-'0')>9){
+                    return -1;
+                }
+                for (; p<end && (unsigned)(*p-'0')<=9; p++){
+                    second += scale*(*p-'0');
+                    scale *= 0.1;
+                }
+            }
+        }
+    }
+
+    long offset_minutes = 0;
+    if (p<end && *p=='Z'){
+        p++;
+    } else if (p<end && (*p=='+' || *p=='-')){
+        int sign = *p=='-' ? -1 : 1;
+        long offset_hours = end-p>=3 ? julian_date_digits(p+1, 2) : -1;
+        if (offset_hours<0 || offset_hours>23){
+            return -1;
+        }
+        p += 3;
+        if (p<end && *p==':'){
+            p++;
+        }
+        if (p<end){
+            long extra = end-p>=2 ? julian_date_digits(p, 2) : -1;
+            if (extra<0 || extra>59){
+                return -1;
+            }
+            offset_minutes = extra;
+            p += 2;
+        }
+        offset_minutes = sign*(offset_hours*60 + offset_minutes);
+    }
+    if (p!=end){
+        return -1;
+    }
+
+    *days_since_j2k = days_since_j2k_from_utc(year, (int)month, (int)day, (int)hour, (int)(minute-offset_minutes), second);
+    return 0;
+}
+
+// Parse n_timestamps NUL-terminated ISO-8601 timestamps as
+// iso8601_to_days_since_j2k does. Timestamps that do not parse give NAN.
+// Returns the number of them.
+SSD_INLINE size_t iso8601_to_days_since_j2k_batch(const char* const* timestamps, const size_t n_timestamps, double* days_since_j2k){
+    size_t n_failed = 0;
+    for (size_t i=0; i<n_timestamps; i++){
+        const char* text = timestamps[i];
+        size_t length = 0;
+        while (text[length]!='\0'){
+            length++;
+        }
+        if (iso8601_to_days_since_j2k(text, length, &days_since_j2k[i])!=0){
+            days_since_j2k[i] = NAN;
+            n_failed++;
+        }
+    }
+    return n_failed;
+}
+
+// 8 bytes of text as a little-endian word, so that byte i of the text is
+// bits 8i to 8i+7 whatever the byte order of the machine.
+SSD_INLINE uint64_t julian_date_load_le64(const unsigned char* text){
+    uint64_t word;
+    memcpy(&word, text, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Non-zero if any byte of the word is 10 or more.
+SSD_INLINE uint64_t julian_date_any_byte_over_9(const uint64_t word){
+    return (((word & 0x7f7f7f7f7f7f7f7full) + 0x7676767676767676ull) | word) & 0x8080808080808080ull;
+}
+
+#define JULIAN_DATE_BYTE(word, i) ((int)(((word) >> (8*(i))) & 0xff))
+
+// Records per block of iso8601_fixed_to_days_since_j2k_batch, whose fields
+// stay on the stack between its two passes.
+#define JULIAN_DATE_BATCH_BLOCK 64
+
+// Parse n_timestamps fixed-width records, the i-th starting stride bytes
+// after the (i-1)-th, each holding "YYYY-MM-DDThh:mm:ss" in UTC (a space
+// for the T is accepted too) in its first 19 bytes, as found in log files
+// and fixed-width columns. Records that do not parse give NAN. Returns the
+// number of them.
+//
+// There are no branches on the data. A block of records is first read as
+// three overlapping 8-byte words each, at 0, 8 and 11, checked against a
+// template 8 characters at a time and split into fields. That pass is
+// scalar, since the records are strided text. A second pass then does the
+// calendar arithmetic of days_from_civil and days_in_month on the fields,
+// written out in 32-bit integers, and masks the bad records to NAN; GCC -O3
+// vectorizes it, with 16-byte vectors on SSE2 and 32-byte ones on AVX2.
+SSD_INLINE size_t iso8601_fixed_to_days_since_j2k_batch(const char* records, const size_t stride, const size_t n_timestamps, double* days_since_j2k){
+    // '0' where a digit goes and the separator elsewhere, so that the XOR
+    // of a valid record is a digit value or 0 in every byte
+    const uint64_t date_template = 0x2d30302d30303030ull;   // "0000-00-"
+    const uint64_t day_template = 0x30303a3030543030ull;    // "00T00:00"
+    const uint64_t time_template = 0x30303a30303a3030ull;   // "00:00:00"
+    const uint64_t date_separators = 0xff0000ff00000000ull;
+    const uint64_t time_separators = 0x0000ff0000ff0000ull;
+    size_t n_failed = 0;
+    for (size_t first=0; first<n_timestamps; first+=JULIAN_DATE_BATCH_BLOCK){
+        const size_t n = n_timestamps-first < JULIAN_DATE_BATCH_BLOCK ? n_timestamps-first : JULIAN_DATE_BATCH_BLOCK;
+        int year[JULIAN_DATE_BATCH_BLOCK], month[JULIAN_DATE_BATCH_BLOCK], day[JULIAN_DATE_BATCH_BLOCK];
+        int hour[JULIAN_DATE_BATCH_BLOCK], minute[JULIAN_DATE_BATCH_BLOCK], second[JULIAN_DATE_BATCH_BLOCK];
+        int bad[JULIAN_DATE_BATCH_BLOCK];
+
+        for (size_t k=0; k<n; k++){
+            const unsigned char* r = (const unsigned char*)records + (first+k)*stride;
+            uint64_t date = julian_date_load_le64(r) ^ date_template;
+            uint64_t day_word = julian_date_load_le64(r+8) ^ day_template;
+            uint64_t time = julian_date_load_le64(r+11) ^ time_template;
+            // The T at 10 may be a space, ' '^'T'
+            int t = JULIAN_DATE_BYTE(day_word, 2);
+            day_word &= ~(uint64_t)0xff0000;
+            bad[k] = ((julian_date_any_byte_over_9(date) | julian_date_any_byte_over_9(day_word) | julian_date_any_byte_over_9(time))!=0)
+                   | ((date & date_separators)!=0) | ((time & time_separators)!=0)
+                   | ((t!=0) & (t!=(' '^'T')));
+            year[k] = JULIAN_DATE_BYTE(date, 0)*1000 + JULIAN_DATE_BYTE(date, 1)*100 + JULIAN_DATE_BYTE(date, 2)*10 + JULIAN_DATE_BYTE(date, 3);
+            month[k] = JULIAN_DATE_BYTE(date, 5)*10 + JULIAN_DATE_BYTE(date, 6);
+            day[k] = JULIAN_DATE_BYTE(day_word, 0)*10 + JULIAN_DATE_BYTE(day_word, 1);
+            hour[k] = JULIAN_DATE_BYTE(time, 0)*10 + JULIAN_DATE_BYTE(time, 1);
+            minute[k] = JULIAN_DATE_BYTE(time, 3)*10 + JULIAN_DATE_BYTE(time, 4);
+            second[k] = JULIAN_DATE_BYTE(time, 6)*10 + JULIAN_DATE_BYTE(time, 7);
+        }
+
+        double* out = days_since_j2k + first;
+        for (size_t k=0; k<n; k++){
+            int leap = ((year[k]%4==0) & (year[k]%100!=0)) | (year[k]%400==0);
+            int month_days = 30 + ((month[k] + (month[k]>7))&1) - (month[k]==2)*(2 - leap);
+            int is_bad = bad[k] | (month[k]<1) | (month[k]>12) | (day[k]<1) | (day[k]>month_days)
+                       | (hour[k]>23) | (minute[k]>59) | (second[k]>60);
+
+            // days_from_civil, with years shifted by 4800. Garbage bytes
+            // give garbage dates, masked by is_bad.
+            int y = year[k] + 4800 - (month[k]<=2);
+            int era = y/400;
+            int year_of_era = y - era*400;
+            int day_of_year = (153*((month[k] + 9)%12) + 2)/5 + day[k] - 1;
+            int day_of_era = year_of_era*365 + year_of_era/4 - year_of_era/100 + day_of_year;
+            int days_from_epoch = era*146097 + day_of_era - 719468 - 12*146097;
+            double days = (double)(days_from_epoch - J2000_DAYS_SINCE_UNIX_EPOCH)
+                        + (double)(hour[k]*3600 + minute[k]*60 - 43200 + second[k])/86400.;
+
+            // NAN through a bit mask rather than a select, which GCC would
+            // turn back into a branch around the arithmetic above
+            uint64_t bits, nan_bits;
+            double nan = NAN;
+            memcpy(&bits, &days, sizeof(bits));
+            memcpy(&nan_bits, &nan, sizeof(nan_bits));
+            uint64_t mask = (uint64_t)0 - (uint64_t)is_bad;
+            bits = (bits & ~mask) | (nan_bits & mask);
+            memcpy(&days, &bits, sizeof(days));
+            out[k] = days;
+            n_failed += (size_t)is_bad;
+        }
+    }
+    return n_failed;
+}
+
+#endif
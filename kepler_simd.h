@@ -0,0 +1,574 @@
+/*
+Vectorized Kepler equation solver for many (M, e) pairs at once.
+
+The same kernel is compiled for SSE2, AVX2+FMA and AVX-512 and picked at
+runtime from the CPU features; other compilers and architectures fall back
+to the scalar kepler_solve. Each call works on blocks of 8 lanes (one
+AVX-512 register, two AVX2 registers or four SSE2 registers), with
+converged lanes frozen until every lane has converged or
+MAX_NEWTON_ITERATIONS is reached. The convergence test is the same one
+kepler_solve uses, with the same NEWTON_EPSILON. With SSD_SOLVER_STATS
+every lane holding an input is counted as one solve.
+
+The tail of an array is padded to a full block, so every element goes
+through the same instruction sequence whatever its position in the array.
+
+The _f functions are the single-precision counterparts: 16 float lanes in
+the same register width, Cephes' sinf/cosf polynomials, and Newton's
+method until the step is below KEPLER_FLOAT_STEP_RAD, since the residual
+of a float solve cannot get down to NEWTON_EPSILON.
+*/
+
+#ifndef KEPLER_SIMD_H
+#define KEPLER_SIMD_H
+
+#include <stddef.h>
+#include <string.h>
+#include "orbits.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KEPLER_SIMD_X86 1
+#endif
+
+typedef enum kepler_simd_isa {
+    KEPLER_SIMD_SCALAR = 0,
+    KEPLER_SIMD_SSE2,
+    KEPLER_SIMD_AVX2,
+    KEPLER_SIMD_AVX512
+} kepler_simd_isa;
+
+#define KEPLER_SIMD_LANES 8
+#define KEPLER_SIMD_LANES_F 16
+
+// After a Newton step this small the error left is about its square.
+#define KEPLER_FLOAT_STEP_RAD 1e-5f
+
+// Scalar reference: E, sin(E) and cos(E) through kepler_solve and libm.
+SSD_INLINE void kepler_solve_sincos_scalar(const double* mean_anomaly_rad, const double* e, double* eccentric_anomaly_rad, double* sin_E, double* cos_E, size_t n){
+    for (size_t k=0; k<n; k++){
+        double E = kepler_solve(mean_anomaly_rad[k], e[k]);
+        eccentric_anomaly_rad[k] = E;
+        sin_E[k] = sin(E);
+        cos_E[k] = cos(E);
+    }
+}
+
+// Single-precision scalar reference through sinf and cosf.
+SSD_INLINE void kepler_solve_sincos_scalar_f(const float* mean_anomaly_rad, const float* e, float* eccentric_anomaly_rad, float* sin_E, float* cos_E, size_t n){
+    for (size_t k=0; k<n; k++){
+        float M = mean_anomaly_rad[k], ecc = e[k];
+        float E = M + ecc*sinf(M);
+        int i, converged = 0;
+        for (i=0; i<MAX_NEWTON_ITERATIONS && !converged; i++){
+            float delta = (E - ecc*sinf(E) - M)/(1.f - ecc*cosf(E));
+            E -= delta;
+            converged = fabsf(delta)<KEPLER_FLOAT_STEP_RAD;
+        }
+#ifdef SSD_SOLVER_STATS
+        double residual_rad = (double)E - ecc*sin((double)E) - M;
+        SOLVER_STATS_SOLVE(ecc, i, converged, residual_rad);
+#endif
+        eccentric_anomaly_rad[k] = E;
+        sin_E[k] = sinf(E);
+        cos_E[k] = cosf(E);
+    }
+}
+
+#ifdef KEPLER_SIMD_X86
+
+typedef double kepler_v8d __attribute__((vector_size(64)));
+typedef long long kepler_v8i __attribute__((vector_size(64)));
+
+#define KEPLER_SIMD_INLINE SSD_INLINE __attribute__((always_inline))
+
+// sin and cos of 8 lanes: fast_v8_sincos of fast_math.h, Cody-Waite
+// reduction by pi/2 followed by the Cephes minimax polynomials on
+// [-pi/4, pi/4]; within a couple of ulp of libm for |x| up to about 1e5.
+KEPLER_SIMD_INLINE void kepler_v8_sincos(const kepler_v8d* x, kepler_v8d* s, kepler_v8d* c){
+    fast_v8_sincos(x, s, c);
+}
+
+// Select a where mask is set, b elsewhere.
+#define KEPLER_V8_SELECT(mask, a, b) ((kepler_v8d)(((kepler_v8i)(a) & (mask)) | ((kepler_v8i)(b) & ~(mask))))
+
+// Newton iteration on 8 lanes, mirroring kepler_solve. Lanes from n_lanes
+// on are padding, left out of the solver statistics.
+KEPLER_SIMD_INLINE void kepler_v8_solve(const double* mean_anomaly_rad, const double* e, double* eccentric_anomaly_rad, double* sin_E, double* cos_E, const size_t n_lanes){
+    kepler_v8d M, ecc;
+    memcpy(&M, mean_anomaly_rad, sizeof(M));
+    memcpy(&ecc, e, sizeof(ecc));
+
+    // Initial guess from https://ssd.jpl.nasa.gov/planets/approx_pos.html
+    kepler_v8d s, c;
+    kepler_v8_sincos(&M, &s, &c);
+    kepler_v8d E = M + ecc*s;
+    kepler_v8_sincos(&E, &s, &c);
+
+    kepler_v8i active = (kepler_v8i){-1, -1, -1, -1, -1, -1, -1, -1};
+#ifdef SSD_SOLVER_STATS
+    kepler_v8i n_iterations = (kepler_v8i){0, 0, 0, 0, 0, 0, 0, 0};
+#endif
+    for (int i=0; i<MAX_NEWTON_ITERATIONS; i++){
+#ifdef SSD_SOLVER_STATS
+        n_iterations -= active;
+#endif
+        kepler_v8d E_next = E - (E - ecc*s - M)/(1. - ecc*c);
+        kepler_v8d s_next, c_next;
+        kepler_v8_sincos(&E_next, &s_next, &c_next);
+
+        E = KEPLER_V8_SELECT(active, E_next, E);
+        s = KEPLER_V8_SELECT(active, s_next, s);
+        c = KEPLER_V8_SELECT(active, c_next, c);
+
+        kepler_v8d residual = E_next - ecc*s_next - M;
+        kepler_v8i converged = (residual < NEWTON_EPSILON) & (residual > -NEWTON_EPSILON);
+        active &= ~converged;
+
+        long long any_active = 0;
+        for (int lane=0; lane<KEPLER_SIMD_LANES; lane++){
+            any_active |= active[lane];
+        }
+        if (!any_active){
+            break;
+        }
+    }
+
+#ifdef SSD_SOLVER_STATS
+    for (size_t lane=0; lane<n_lanes; lane++){
+        double residual_rad = E[lane] - ecc[lane]*s[lane] - M[lane];
+        SOLVER_STATS_SOLVE(ecc[lane], (int)n_iterations[lane], active[lane]==0, residual_rad);
+    }
+#else
+    (void)n_lanes;
+#endif
+
+    memcpy(eccentric_anomaly_rad, &E, sizeof(E));
+    memcpy(sin_E, &s, sizeof(s));
+    memcpy(cos_E, &c, sizeof(c));
+}
+
+// Run the 8-lane kernel over n elements, padding the tail with the last
+// element so that no lane reads past the end of the inputs.
+KEPLER_SIMD_INLINE void kepler_v8_solve_array(const double* mean_anomaly_rad, const double* e, double* eccentric_anomaly_rad, double* sin_E, double* cos_E, size_t n){
+    size_t k = 0;
+    for (; k+KEPLER_SIMD_LANES<=n; k+=KEPLER_SIMD_LANES){
+        kepler_v8_solve(mean_anomaly_rad+k, e+k, eccentric_anomaly_rad+k, sin_E+k, cos_E+k, KEPLER_SIMD_LANES);
+    }
+    if (k<n){
+        // The padding lanes solve M = 0 on a circle, which converges at once
+        double M_tail[KEPLER_SIMD_LANES] = {0}, e_tail[KEPLER_SIMD_LANES] = {0};
+        double E_tail[KEPLER_SIMD_LANES], s_tail[KEPLER_SIMD_LANES], c_tail[KEPLER_SIMD_LANES];
+        memcpy(M_tail, mean_anomaly_rad+k, (n-k)*sizeof(double));
+        memcpy(e_tail, e+k, (n-k)*sizeof(double));
+        kepler_v8_solve(M_tail, e_tail, E_tail, s_tail, c_tail, n-k);
+        memcpy(eccentric_anomaly_rad+k, E_tail, (n-k)*sizeof(double));
+        memcpy(sin_E+k, s_tail, (n-k)*sizeof(double));
+        memcpy(cos_E+k, c_tail, (n-k)*sizeof(double));
+    }
+}
+
+// sin and cos of n angles with the same reduction and polynomials.
+KEPLER_SIMD_INLINE void kepler_v8_sincos_array(const double* x, double* s, double* c, size_t n){
+    size_t k = 0;
+    kepler_v8d xv, sv, cv;
+    for (; k+KEPLER_SIMD_LANES<=n; k+=KEPLER_SIMD_LANES){
+        memcpy(&xv, x+k, sizeof(xv));
+        kepler_v8_sincos(&xv, &sv, &cv);
+        memcpy(s+k, &sv, sizeof(sv));
+        memcpy(c+k, &cv, sizeof(cv));
+    }
+    if (k<n){
+        double x_tail[KEPLER_SIMD_LANES] = {0};
+        memcpy(x_tail, x+k, (n-k)*sizeof(double));
+        memcpy(&xv, x_tail, sizeof(xv));
+        kepler_v8_sincos(&xv, &sv, &cv);
+        memcpy(s+k, &sv, (n-k)*sizeof(double));
+        memcpy(c+k, &cv, (n-k)*sizeof(double));
+    }
+}
+
+typedef float kepler_v16f __attribute__((vector_size(64)));
+typedef int kepler_v16i __attribute__((vector_size(64)));
+
+// sin and cos of 16 float lanes: Cody-Waite reduction by pi/2 and the
+// Cephes sinf/cosf polynomials on [-pi/4, pi/4]; within a couple of float
+// ulp for |x| up to about 1e3.
+KEPLER_SIMD_INLINE void kepler_v16f_sincos(const kepler_v16f* x, kepler_v16f* s, kepler_v16f* c){
+    const float round_magic = 12582912.f; // 1.5*2^23
+    kepler_v16f q = (*x*0.636619772f + round_magic);
+    kepler_v16i quadrant = (kepler_v16i)q;
+    q = q - round_magic;
+
+    kepler_v16f r = *x - q*1.5703125f;
+    r = r - q*4.837512969970703125e-4f;
+    r = r - q*7.54978995489188216e-8f;
+    kepler_v16f z = r*r;
+
+    kepler_v16f ps = z*-1.9515295891e-4f + 8.3321608736e-3f;
+    ps = ps*z - 1.6666654611e-1f;
+    kepler_v16f sin_r = r + r*z*ps;
+
+    kepler_v16f pc = z*2.443315711809948e-5f - 1.388731625493765e-3f;
+    pc = pc*z + 4.166664568298827e-2f;
+    kepler_v16f cos_r = 1.f - 0.5f*z + z*z*pc;
+
+    kepler_v16i swap = -(quadrant & 1);
+    kepler_v16i sin_bits = ((kepler_v16i)sin_r & ~swap) | ((kepler_v16i)cos_r & swap);
+    kepler_v16i cos_bits = ((kepler_v16i)cos_r & ~swap) | ((kepler_v16i)sin_r & swap);
+    sin_bits ^= (quadrant & 2) << 30;
+    cos_bits ^= ((quadrant+1) & 2) << 30;
+    *s = (kepler_v16f)sin_bits;
+    *c = (kepler_v16f)cos_bits;
+}
+
+#define KEPLER_V16F_SELECT(mask, a, b) ((kepler_v16f)(((kepler_v16i)(a) & (mask)) | ((kepler_v16i)(b) & ~(mask))))
+
+// Newton iteration on 16 float lanes, stopping each lane once its step is
+// below KEPLER_FLOAT_STEP_RAD.
+KEPLER_SIMD_INLINE void kepler_v16f_solve(const float* mean_anomaly_rad, const float* e, float* eccentric_anomaly_rad, float* sin_E, float* cos_E, const size_t n_lanes){
+    kepler_v16f M, ecc;
+    memcpy(&M, mean_anomaly_rad, sizeof(M));
+    memcpy(&ecc, e, sizeof(ecc));
+
+    kepler_v16f s, c;
+    kepler_v16f_sincos(&M, &s, &c);
+    kepler_v16f E = M + ecc*s;
+    kepler_v16f_sincos(&E, &s, &c);
+
+    kepler_v16i active = (kepler_v16i){-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+#ifdef SSD_SOLVER_STATS
+    kepler_v16i n_iterations = (kepler_v16i){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+#endif
+    for (int i=0; i<MAX_NEWTON_ITERATIONS; i++){
+#ifdef SSD_SOLVER_STATS
+        n_iterations -= active;
+#endif
+        kepler_v16f delta = (E - ecc*s - M)/(1.f - ecc*c);
+        kepler_v16f E_next = E - delta;
+        kepler_v16f s_next, c_next;
+        kepler_v16f_sincos(&E_next, &s_next, &c_next);
+
+        E = KEPLER_V16F_SELECT(active, E_next, E);
+        s = KEPLER_V16F_SELECT(active, s_next, s);
+        c = KEPLER_V16F_SELECT(active, c_next, c);
+
+        kepler_v16i converged = (delta < KEPLER_FLOAT_STEP_RAD) & (delta > -KEPLER_FLOAT_STEP_RAD);
+        active &= ~converged;
+
+        int any_active = 0;
+        for (int lane=0; lane<KEPLER_SIMD_LANES_F; lane++){
+            any_active |= active[lane];
+        }
+        if (!any_active){
+            break;
+        }
+    }
+
+#ifdef SSD_SOLVER_STATS
+    for (size_t lane=0; lane<n_lanes; lane++){
+        double residual_rad = (double)E[lane] - ecc[lane]*sin((double)E[lane]) - M[lane];
+        SOLVER_STATS_SOLVE(ecc[lane], n_iterations[lane], active[lane]==0, residual_rad);
+    }
+#else
+    (void)n_lanes;
+#endif
+
+    memcpy(eccentric_anomaly_rad, &E, sizeof(E));
+    memcpy(sin_E, &s, sizeof(s));
+    memcpy(cos_E, &c, sizeof(c));
+}
+
+KEPLER_SIMD_INLINE void kepler_v16f_solve_array(const float* mean_anomaly_rad, const float* e, float* eccentric_anomaly_rad, float* sin_E, float* cos_E, size_t n){
+    size_t k = 0;
+    for (; k+KEPLER_SIMD_LANES_F<=n; k+=KEPLER_SIMD_LANES_F){
+        kepler_v16f_solve(mean_anomaly_rad+k, e+k, eccentric_anomaly_rad+k, sin_E+k, cos_E+k, KEPLER_SIMD_LANES_F);
+    }
+    if (k<n){
+        // The padding lanes solve M = 0 on a circle, which converges at once
+        float M_tail[KEPLER_SIMD_LANES_F] = {0}, e_tail[KEPLER_SIMD_LANES_F] = {0};
+        float E_tail[KEPLER_SIMD_LANES_F], s_tail[KEPLER_SIMD_LANES_F], c_tail[KEPLER_SIMD_LANES_F];
+        memcpy(M_tail, mean_anomaly_rad+k, (n-k)*sizeof(float));
+        memcpy(e_tail, e+k, (n-k)*sizeof(float));
+        kepler_v16f_solve(M_tail, e_tail, E_tail, s_tail, c_tail, n-k);
+        memcpy(eccentric_anomaly_rad+k, E_tail, (n-k)*sizeof(float));
+        memcpy(sin_E+k, s_tail, (n-k)*sizeof(float));
+        memcpy(cos_E+k, c_tail, (n-k)*sizeof(float));
+    }
+}
+
+KEPLER_SIMD_INLINE void kepler_v16f_sincos_array(const float* x, float* s, float* c, size_t n){
+    size_t k = 0;
+    kepler_v16f xv, sv, cv;
+    for (; k+KEPLER_SIMD_LANES_F<=n; k+=KEPLER_SIMD_LANES_F){
+        memcpy(&xv, x+k, sizeof(xv));
+        kepler_v16f_sincos(&xv, &sv, &cv);
+        memcpy(s+k, &sv, sizeof(sv));
+        memcpy(c+k, &cv, sizeof(cv));
+    }
+    if (k<n){
+        float x_tail[KEPLER_SIMD_LANES_F] = {0};
+        memcpy(x_tail, x+k, (n-k)*sizeof(float));
+        memcpy(&xv, x_tail, sizeof(xv));
+        kepler_v16f_sincos(&xv, &sv, &cv);
+        memcpy(s+k, &sv, (n-k)*sizeof(float));
+        memcpy(c+k, &cv, (n-k)*sizeof(float));
+    }
+}
+
+SSD_INLINE void kepler_solve_sincos_sse2(const double* M, const double* e, double* E, double* s, double* c, size_t n){
+    kepler_v8_solve_array(M, e, E, s, c, n);
+}
+__attribute__((target("avx2,fma")))
+SSD_INLINE void kepler_solve_sincos_avx2(const double* M, const double* e, double* E, double* s, double* c, size_t n){
+    kepler_v8_solve_array(M, e, E, s, c, n);
+}
+__attribute__((target("avx512f")))
+SSD_INLINE void kepler_solve_sincos_avx512(const double* M, const double* e, double* E, double* s, double* c, size_t n){
+    kepler_v8_solve_array(M, e, E, s, c, n);
+}
+
+SSD_INLINE void sincos_array_sse2(const double* x, double* s, double* c, size_t n){
+    kepler_v8_sincos_array(x, s, c, n);
+}
+__attribute__((target("avx2,fma")))
+SSD_INLINE void sincos_array_avx2(const double* x, double* s, double* c, size_t n){
+    kepler_v8_sincos_array(x, s, c, n);
+}
+__attribute__((target("avx512f")))
+SSD_INLINE void sincos_array_avx512(const double* x, double* s, double* c, size_t n){
+    kepler_v8_sincos_array(x, s, c, n);
+}
+
+// atan2 of n pairs through fast_v8_atan2, the tail padded with zeros.
+KEPLER_SIMD_INLINE void kepler_v8_atan2_array(const double* y, const double* x, double* angle, size_t n){
+    size_t k = 0;
+    kepler_v8d yv, xv, av;
+    for (; k+KEPLER_SIMD_LANES<=n; k+=KEPLER_SIMD_LANES){
+        memcpy(&yv, y+k, sizeof(yv));
+        memcpy(&xv, x+k, sizeof(xv));
+        fast_v8_atan2(&yv, &xv, &av);
+        memcpy(angle+k, &av, sizeof(av));
+    }
+    if (k<n){
+        double y_tail[KEPLER_SIMD_LANES] = {0}, x_tail[KEPLER_SIMD_LANES] = {0};
+        memcpy(y_tail, y+k, (n-k)*sizeof(double));
+        memcpy(x_tail, x+k, (n-k)*sizeof(double));
+        memcpy(&yv, y_tail, sizeof(yv));
+        memcpy(&xv, x_tail, sizeof(xv));
+        fast_v8_atan2(&yv, &xv, &av);
+        memcpy(angle+k, &av, (n-k)*sizeof(double));
+    }
+}
+
+SSD_INLINE void atan2_array_sse2(const double* y, const double* x, double* angle, size_t n){
+    kepler_v8_atan2_array(y, x, angle, n);
+}
+__attribute__((target("avx2,fma")))
+SSD_INLINE void atan2_array_avx2(const double* y, const double* x, double* angle, size_t n){
+    kepler_v8_atan2_array(y, x, angle, n);
+}
+__attribute__((target("avx512f")))
+SSD_INLINE void atan2_array_avx512(const double* y, const double* x, double* angle, size_t n){
+    kepler_v8_atan2_array(y, x, angle, n);
+}
+
+SSD_INLINE void kepler_solve_sincos_f_sse2(const float* M, const float* e, float* E, float* s, float* c, size_t n){
+    kepler_v16f_solve_array(M, e, E, s, c, n);
+}
+__attribute__((target("avx2,fma")))
+SSD_INLINE void kepler_solve_sincos_f_avx2(const float* M, const float* e, float* E, float* s, float* c, size_t n){
+    kepler_v16f_solve_array(M, e, E, s, c, n);
+}
+__attribute__((target("avx512f")))
+SSD_INLINE void kepler_solve_sincos_f_avx512(const float* M, const float* e, float* E, float* s, float* c, size_t n){
+    kepler_v16f_solve_array(M, e, E, s, c, n);
+}
+
+SSD_INLINE void sincos_array_f_sse2(const float* x, float* s, float* c, size_t n){
+    kepler_v16f_sincos_array(x, s, c, n);
+}
+__attribute__((target("avx2,fma")))
+SSD_INLINE void sincos_array_f_avx2(const float* x, float* s, float* c, size_t n){
+    kepler_v16f_sincos_array(x, s, c, n);
+}
+__attribute__((target("avx512f")))
+SSD_INLINE void sincos_array_f_avx512(const float* x, float* s, float* c, size_t n){
+    kepler_v16f_sincos_array(x, s, c, n);
+}
+
+#endif // KEPLER_SIMD_X86
+
+// Widest instruction set the CPU supports.
+SSD_INLINE kepler_simd_isa kepler_simd_best_isa(void){
+#ifdef KEPLER_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){
+        return KEPLER_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+        return KEPLER_SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")){
+        return KEPLER_SIMD_SSE2;
+    }
+#endif
+    return KEPLER_SIMD_SCALAR;
+}
+
+// Solve M = E-esin(E) for n pairs with the given instruction set, also
+// returning sin(E) and cos(E). Asking for an instruction set the CPU does
+// not have is undefined behaviour; use kepler_simd_best_isa.
+SSD_INLINE void kepler_solve_sincos_batch_isa(kepler_simd_isa isa, const double* mean_anomaly_rad, const double* e, double* eccentric_anomaly_rad, double* sin_E, double* cos_E, size_t n){
+    switch (isa){
+#ifdef KEPLER_SIMD_X86
+        case KEPLER_SIMD_AVX512:
+            kepler_solve_sincos_avx512(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+        case KEPLER_SIMD_AVX2:
+            kepler_solve_sincos_avx2(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+        case KEPLER_SIMD_SSE2:
+            kepler_solve_sincos_sse2(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+#endif
+        default:
+            kepler_solve_sincos_scalar(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+    }
+}
+
+// sin and cos of n angles with the given instruction set.
+SSD_INLINE void sincos_batch_isa(kepler_simd_isa isa, const double* x, double* s, double* c, size_t n){
+    switch (isa){
+#ifdef KEPLER_SIMD_X86
+        case KEPLER_SIMD_AVX512:
+            sincos_array_avx512(x, s, c, n);
+            return;
+        case KEPLER_SIMD_AVX2:
+            sincos_array_avx2(x, s, c, n);
+            return;
+        case KEPLER_SIMD_SSE2:
+            sincos_array_sse2(x, s, c, n);
+            return;
+#endif
+        default:
+            for (size_t k=0; k<n; k++){
+                s[k] = sin(x[k]);
+                c[k] = cos(x[k]);
+            }
+            return;
+    }
+}
+
+// atan2(y, x) of n pairs with the given instruction set; fast_atan2 lane by
+// lane, or libm's atan2 without SIMD.
+SSD_INLINE void atan2_batch_isa(kepler_simd_isa isa, const double* y, const double* x, double* angle, size_t n){
+    switch (isa){
+#ifdef KEPLER_SIMD_X86
+        case KEPLER_SIMD_AVX512:
+            atan2_array_avx512(y, x, angle, n);
+            return;
+        case KEPLER_SIMD_AVX2:
+            atan2_array_avx2(y, x, angle, n);
+            return;
+        case KEPLER_SIMD_SSE2:
+            atan2_array_sse2(y, x, angle, n);
+            return;
+#endif
+        default:
+            for (size_t k=0; k<n; k++){
+                angle[k] = atan2(y[k], x[k]);
+            }
+            return;
+    }
+}
+
+// Single-precision kepler_solve_sincos_batch_isa.
+SSD_INLINE void kepler_solve_sincos_batch_f_isa(kepler_simd_isa isa, const float* mean_anomaly_rad, const float* e, float* eccentric_anomaly_rad, float* sin_E, float* cos_E, size_t n){
+    switch (isa){
+#ifdef KEPLER_SIMD_X86
+        case KEPLER_SIMD_AVX512:
+            kepler_solve_sincos_f_avx512(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+        case KEPLER_SIMD_AVX2:
+            kepler_solve_sincos_f_avx2(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+        case KEPLER_SIMD_SSE2:
+            kepler_solve_sincos_f_sse2(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+#endif
+        default:
+            kepler_solve_sincos_scalar_f(mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+            return;
+    }
+}
+
+// Single-precision sincos_batch_isa.
+SSD_INLINE void sincos_batch_f_isa(kepler_simd_isa isa, const float* x, float* s, float* c, size_t n){
+    switch (isa){
+#ifdef KEPLER_SIMD_X86
+        case KEPLER_SIMD_AVX512:
+            sincos_array_f_avx512(x, s, c, n);
+            return;
+        case KEPLER_SIMD_AVX2:
+            sincos_array_f_avx2(x, s, c, n);
+            return;
+        case KEPLER_SIMD_SSE2:
+            sincos_array_f_sse2(x, s, c, n);
+            return;
+#endif
+        default:
+            for (size_t k=0; k<n; k++){
+                s[k] = sinf(x[k]);
+                c[k] = cosf(x[k]);
+            }
+            return;
+    }
+}
+
+// Detected once per translation unit in C and once per program in C++,
+// where the static of an inline function is shared. The ISA is kept as a single value,
+// isa+1 with 0 for not detected yet, loaded and stored atomically, so
+// threads making their first call at once each see either nothing (and
+// detect it themselves) or the complete value.
+SSD_INLINE kepler_simd_isa kepler_simd_isa_cached(void){
+#ifdef __GNUC__
+    static int cached = 0;
+    int isa_plus_one = __atomic_load_n(&cached, __ATOMIC_ACQUIRE);
+    if (isa_plus_one==0){
+        isa_plus_one = (int)kepler_simd_best_isa()+1;
+        __atomic_store_n(&cached, isa_plus_one, __ATOMIC_RELEASE);
+    }
+    return (kepler_simd_isa)(isa_plus_one-1);
+#else
+    // Without GCC builtins there is nothing to detect
+    return kepler_simd_best_isa();
+#endif
+}
+
+// Solve M = E-esin(E) for n pairs on the widest available instruction set.
+SSD_INLINE void kepler_solve_sincos_batch(const double* mean_anomaly_rad, const double* e, double* eccentric_anomaly_rad, double* sin_E, double* cos_E, size_t n){
+    kepler_solve_sincos_batch_isa(kepler_simd_isa_cached(), mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+}
+
+// sin and cos of n angles on the widest available instruction set.
+SSD_INLINE void sincos_batch(const double* x, double* s, double* c, size_t n){
+    sincos_batch_isa(kepler_simd_isa_cached(), x, s, c, n);
+}
+
+// atan2(y, x) of n pairs on the widest available instruction set.
+SSD_INLINE void atan2_batch(const double* y, const double* x, double* angle, size_t n){
+    atan2_batch_isa(kepler_simd_isa_cached(), y, x, angle, n);
+}
+
+// Single-precision kepler_solve_sincos_batch, 16 lanes per block.
+SSD_INLINE void kepler_solve_sincos_batch_f(const float* mean_anomaly_rad, const float* e, float* eccentric_anomaly_rad, float* sin_E, float* cos_E, size_t n){
+    kepler_solve_sincos_batch_f_isa(kepler_simd_isa_cached(), mean_anomaly_rad, e, eccentric_anomaly_rad, sin_E, cos_E, n);
+}
+
+// Single-precision sincos_batch.
+SSD_INLINE void sincos_batch_f(const float* x, float* s, float* c, size_t n){
+    sincos_batch_f_isa(kepler_simd_isa_cached(), x, s, c, n);
+}
+
+#endif
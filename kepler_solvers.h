@@ -0,0 +1,238 @@
+/*
+Alternative solvers for Kepler's equation, selectable through a table of
+function pointers.
+
+- newton: kepler_solve, Newton's method from M + e sin(M) until the
+  residual is below NEWTON_EPSILON.
+- halley: Halley's method from the same guess and with the same test. The
+  third-order step converges in fewer, dearer iterations.
+- fixed: a second-order series guess, M + e sin(M)(1 + e cos(M)), followed
+  by KEPLER_FIXED_HALLEY_STEPS Halley steps and no test at all, so every
+  solve costs the same and has no data-dependent branch. Accurate to
+  rounding up to e = 0.5 and to 1e-10 rad up to KEPLER_FIXED_MAX_E.
+- table: E - M interpolated bilinearly in (|M|, e) from a kepler_table,
+  then one Halley step. The builder refines the grid until the error,
+  measured against kepler_solve_reference in the middle of every cell,
+  is within the requested tolerance. Eccentricities past the table go
+  through kepler_solve.
+
+bench reports the speed of each and its error against
+kepler_solve_reference.
+*/
+
+#ifndef KEPLER_SOLVERS_H
+#define KEPLER_SOLVERS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "keplerian_elements.h"
+#include "orbits.h"
+
+#define KEPLER_FIXED_HALLEY_STEPS 2
+#define KEPLER_FIXED_MAX_E 0.7
+#define KEPLER_REFERENCE_STEP_RAD 1e-15
+#define KEPLER_TABLE_MIN_M_NODES 64
+#define KEPLER_TABLE_MIN_E_NODES 16
+#define KEPLER_TABLE_MAX_NODES (1<<22)
+
+typedef struct kepler_solver {
+    const char* name;
+    // Eccentric anomaly (rad) from the mean anomaly (rad) and eccentricity;
+    // data is the solver's own, e.g. a kepler_table.
+    double (*solve)(const void* data, const double mean_anomaly_rad, const double e);
+    const void* data;
+} kepler_solver;
+
+typedef struct kepler_table {
+    int n_M;                        // Nodes in |M| over [0, pi]
+    int n_e;                        // Nodes in e over [0, max_e]
+    double max_e;
+    double M_nodes_per_rad;         // (n_M-1)/pi
+    double e_nodes_per_unit;        // (n_e-1)/max_e
+    double max_error_rad;           // Largest error seen by the builder
+    double* E_minus_M_rad;          // n_e rows of n_M nodes
+} kepler_table;
+
+// Halley step on Kepler's equation.
+SSD_INLINE double kepler_halley_step(const double E, const double e, const double mean_anomaly_rad){
+    double sin_E = sin(E), cos_E = cos(E);
+    double f = E - e*sin_E - mean_anomaly_rad;
+    double df = 1 - e*cos_E;
+    return E - 2*f*df/(2*df*df - f*e*sin_E);
+}
+
+// Newton's method until the step is below KEPLER_REFERENCE_STEP_RAD, the
+// yardstick for the other solvers.
+SSD_INLINE double kepler_solve_reference(const double mean_anomaly_rad, const double e){
+    double E = mean_anomaly_rad + e*sin(mean_anomaly_rad);
+    for (int i=0; i<MAX_NEWTON_ITERATIONS; i++){
+        double delta = (E - e*sin(E) - mean_anomaly_rad)/(1 - e*cos(E));
+        E -= delta;
+        if (fabs(delta)<KEPLER_REFERENCE_STEP_RAD){
+            break;
+        }
+    }
+    return E;
+}
+
+SSD_INLINE double kepler_solve_halley(const double mean_anomaly_rad, const double e){
+    double E = mean_anomaly_rad + e*sin(mean_anomaly_rad);
+    int i;
+    for (i=0; i<MAX_NEWTON_ITERATIONS; i++){
+        E = kepler_halley_step(E, e, mean_anomaly_rad);
+        if (fabs(E - e*sin(E) - mean_anomaly_rad)<NEWTON_EPSILON){
+            i++;
+            break;
+        }
+    }
+#ifdef SSD_SOLVER_STATS
+    double residual_rad = E - e*sin(E) - mean_anomaly_rad;
+    SOLVER_STATS_SOLVE(e, i, fabs(residual_rad)<NEWTON_EPSILON, residual_rad);
+#endif
+    return E;
+}
+
+SSD_INLINE double kepler_solve_fixed(const double mean_anomaly_rad, const double e){
+    double sin_M = sin(mean_anomaly_rad), cos_M = cos(mean_anomaly_rad);
+    double E = mean_anomaly_rad + e*sin_M*(1 + e*cos_M);
+    for (int i=0; i<KEPLER_FIXED_HALLEY_STEPS; i++){
+        E = kepler_halley_step(E, e, mean_anomaly_rad);
+    }
+#ifdef SSD_SOLVER_STATS
+    double residual_rad = E - e*sin(E) - mean_anomaly_rad;
+    SOLVER_STATS_SOLVE(e, KEPLER_FIXED_HALLEY_STEPS, fabs(residual_rad)<NEWTON_EPSILON, residual_rad);
+#endif
+    return E;
+}
+
+// Bilinear interpolation of the table, without the Halley step. abs_M_rad
+// in [0, pi], e in [0, max_e].
+SSD_INLINE double kepler_table_interpolate(const kepler_table* table, const double abs_M_rad, const double e){
+    double u = abs_M_rad*table->M_nodes_per_rad;
+    double v = e*table->e_nodes_per_unit;
+    int i = (int)u, j = (int)v;
+    i = i>table->n_M-2 ? table->n_M-2 : i;
+    j = j>table->n_e-2 ? table->n_e-2 : j;
+    double fu = u-i, fv = v-j;
+    const double* row = table->E_minus_M_rad + (size_t)j*table->n_M;
+    const double* next_row = row + table->n_M;
+    return (1-fv)*((1-fu)*row[i] + fu*row[i+1]) + fv*((1-fu)*next_row[i] + fu*next_row[i+1]);
+}
+
+// Interpolation and Halley step for M in [-pi, pi] and e in [0, max_e].
+SSD_INLINE double kepler_table_lookup(const kepler_table* table, const double M, const double e){
+    // E(-M) = -E(M)
+    double E = M + copysign(kepler_table_interpolate(table, fabs(M), e), M);
+    return kepler_halley_step(E, e, M);
+}
+
+SSD_INLINE double kepler_table_solve(const kepler_table* table, const double mean_anomaly_rad, const double e){
+    if (!(e>=0 && e<=table->max_e)){
+        return kepler_solve(mean_anomaly_rad, e);
+    }
+    // E-M has period 2pi
+    double wrap_rad = 2*M_PI*nearbyint(mean_anomaly_rad*(0.5/M_PI));
+    double M = mean_anomaly_rad - wrap_rad;
+    double E = kepler_table_lookup(table, M, e);
+#ifdef SSD_SOLVER_STATS
+    double residual_rad = E - e*sin(E) - M;
+    SOLVER_STATS_SOLVE(e, 1, fabs(residual_rad)<NEWTON_EPSILON, residual_rad);
+#endif
+    return E + wrap_rad;
+}
+
+SSD_INLINE void kepler_table_free(kepler_table* table){
+    free(table->E_minus_M_rad);
+    table->E_minus_M_rad = NULL;
+    table->n_M = 0;
+    table->n_e = 0;
+}
+
+// Tabulate E-M for eccentricities up to max_e < 1, doubling the nodes
+// along both axes until kepler_table_solve is within tolerance_rad of
+// kepler_solve_reference. Returns 0 on success, -1 on bad arguments, on
+// allocation failure or if the tolerance cannot be met.
+SSD_INLINE int kepler_table_build(const double max_e, const double tolerance_rad, kepler_table* table){
+    memset(table, 0, sizeof(*table));
+    if (!(max_e>0 && max_e<1) || !(tolerance_rad>0)){
+        return -1;
+    }
+    for (int n_M=KEPLER_TABLE_MIN_M_NODES, n_e=KEPLER_TABLE_MIN_E_NODES; (size_t)n_M*n_e<=KEPLER_TABLE_MAX_NODES; n_M*=2, n_e*=2){
+        double* nodes = (double*)malloc((size_t)n_M*n_e*sizeof(double));
+        if (nodes==NULL){
+            return -1;
+        }
+        for (int j=0; j<n_e; j++){
+            double e = max_e*j/(n_e-1);
+            for (int i=0; i<n_M; i++){
+                double M = M_PI*i/(n_M-1);
+                nodes[(size_t)j*n_M+i] = kepler_solve_reference(M, e) - M;
+            }
+        }
+        table->n_M = n_M;
+        table->n_e = n_e;
+        table->max_e = max_e;
+        table->M_nodes_per_rad = (n_M-1)/M_PI;
+        table->e_nodes_per_unit = (n_e-1)/max_e;
+        table->E_minus_M_rad = nodes;
+
+        // Bilinear interpolation errs most in the middle of a cell
+        double max_error = 0;
+        for (int j=0; j<n_e-1 && max_error<=tolerance_rad; j++){
+            double e = max_e*(j+0.5)/(n_e-1);
+            for (int i=0; i<n_M-1; i++){
+                double M = M_PI*(i+0.5)/(n_M-1);
+                double error = fabs(kepler_table_lookup(table, M, e) - kepler_solve_reference(M, e));
+                max_error = error>max_error ? error : max_error;
+            }
+        }
+        if (max_error<=tolerance_rad){
+            table->max_error_rad = max_error;
+            return 0;
+        }
+        kepler_table_free(table);
+    }
+    memset(table, 0, sizeof(*table));
+    return -1;
+}
+
+SSD_INLINE double kepler_solver_newton_solve(const void* data, const double mean_anomaly_rad, const double e){
+    (void)data;
+    return kepler_solve(mean_anomaly_rad, e);
+}
+
+SSD_INLINE double kepler_solver_halley_solve(const void* data, const double mean_anomaly_rad, const double e){
+    (void)data;
+    return kepler_solve_halley(mean_anomaly_rad, e);
+}
+
+SSD_INLINE double kepler_solver_fixed_solve(const void* data, const double mean_anomaly_rad, const double e){
+    (void)data;
+    return kepler_solve_fixed(mean_anomaly_rad, e);
+}
+
+SSD_INLINE double kepler_solver_table_solve(const void* data, const double mean_anomaly_rad, const double e){
+    return kepler_table_solve((const kepler_table*)data, mean_anomaly_rad, e);
+}
+
+SSD_CONSTANT kepler_solver kepler_solver_newton = {"newton", kepler_solver_newton_solve, NULL};
+SSD_CONSTANT kepler_solver kepler_solver_halley = {"halley", kepler_solver_halley_solve, NULL};
+SSD_CONSTANT kepler_solver kepler_solver_fixed = {"fixed", kepler_solver_fixed_solve, NULL};
+
+// Solver reading a table built by kepler_table_build, which must outlive it.
+SSD_INLINE kepler_solver kepler_solver_table(const kepler_table* table){
+    kepler_solver solver = {"table", kepler_solver_table_solve, table};
+    return solver;
+}
+
+// eccentric_anomaly_at_date with the given solver.
+SSD_INLINE double eccentric_anomaly_at_date_with(const kepler_solver* solver, const keplerian_elements planet, const double days_since_j2k){
+    SOLVER_STATS_CALL(SOLVER_STATS_ECCENTRIC_ANOMALY_AT_DATE);
+    SOLVER_STATS_BODY(planet.a_au);
+    double e = planet.e + planet.edot*days_since_j2k/36525;
+    double mean_anomaly_rad = mean_anomaly_at_date(planet, days_since_j2k);
+    double eccentric_anomaly_rad = solver->solve(solver->data, mean_anomaly_rad, e);
+    return SSD_REDUCE_PI(eccentric_anomaly_rad);
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef KEPLERIAN_ELEMENTS_H
 #define KEPLERIAN_ELEMENTS_H
 
+#include "ssd_linkage.h"
+
 typedef struct keplerian_elements {
     double a_au;        // Semi-major axis, AU
     double e;           // Eccentricity
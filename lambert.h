@@ -0,0 +1,135 @@
+/*
+Lambert's problem: the Keplerian orbit about the Sun that goes from r1 to
+r2 in a given time, for transfers of less than one revolution.
+
+The solver follows the universal-variable formulation (Bate, Mueller and
+White, chapter 5; Curtis, Algorithm 5.2): the time of flight is a
+monotonic function F(z) of the universal variable z on (-inf, 4pi^2),
+so the root is kept bracketed and Newton's steps that leave the bracket
+are replaced by bisection. It converges in a handful of steps for the
+transfers of a porkchop plot and cannot diverge.
+
+Positions are in AU, times in days and velocities in AU/day for
+mu = GM_SUN_AU3_PER_DAY2, but any consistent units work.
+*/
+
+#ifndef LAMBERT_H
+#define LAMBERT_H
+
+#include <math.h>
+#include "orbits.h"
+
+#define LAMBERT_MAX_ITERATIONS 100
+#define LAMBERT_PROGRADE 0
+#define LAMBERT_RETROGRADE 1
+
+// Stumpff functions C(z) and S(z), with their series near zero where the
+// closed forms cancel.
+SSD_INLINE void lambert_stumpff(const double z, double* C, double* S){
+    if (fabs(z)<1e-2){
+        *C = 1./2 - z*(1./24 - z*(1./720 - z/40320.));
+        *S = 1./6 - z*(1./120 - z*(1./5040 - z/362880.));
+    } else if (z>0){
+        double s = sqrt(z);
+        *C = (1-cos(s))/z;
+        *S = (s-sin(s))/(s*z);
+    } else {
+        double s = sqrt(-z);
+        *C = (cosh(s)-1)/(-z);
+        *S = (sinh(s)-s)/(-s*z);
+    }
+}
+
+// sqrt(mu) times the excess of the time of flight at z over the one
+// wanted, with y(z) in *y; where y < 0 there is no orbit and the time of
+// flight counts as too short.
+SSD_INLINE double lambert_time_function(const double z, const double r1_norm, const double r2_norm, const double A, const double sqrt_mu_tof, double* C, double* S, double* y){
+    lambert_stumpff(z, C, S);
+    *y = r1_norm + r2_norm + A*(z*(*S) - 1)/sqrt(*C);
+    if (*y<0){
+        return -sqrt_mu_tof;
+    }
+    double x = sqrt(*y/(*C));
+    return x*x*x*(*S) + A*sqrt(*y) - sqrt_mu_tof;
+}
+
+// Velocities v1 at r1 and v2 at r2 on the orbit from r1 to r2 in tof, the
+// short way round the z axis for LAMBERT_PROGRADE. Returns 0, or -1 for a
+// non-positive time of flight, positions 0 or 180 degrees apart (where the
+// plane of the transfer is undefined), or no convergence.
+SSD_INLINE int lambert_solve(const double r1[3], const double r2[3], const double tof, const double mu, const int direction, double v1[3], double v2[3]){
+    double r1_norm = sqrt(r1[0]*r1[0] + r1[1]*r1[1] + r1[2]*r1[2]);
+    double r2_norm = sqrt(r2[0]*r2[0] + r2[1]*r2[1] + r2[2]*r2[2]);
+    double cos_dtheta = (r1[0]*r2[0] + r1[1]*r2[1] + r1[2]*r2[2])/(r1_norm*r2_norm);
+    cos_dtheta = cos_dtheta>1 ? 1 : cos_dtheta<-1 ? -1 : cos_dtheta;
+    double cross_z = r1[0]*r2[1] - r1[1]*r2[0];
+    double dtheta = acos(cos_dtheta);
+    if ((cross_z<0) != (direction==LAMBERT_RETROGRADE)){
+        dtheta = 2*M_PI - dtheta;
+    }
+    double A = sin(dtheta)*sqrt(r1_norm*r2_norm/(1-cos_dtheta));
+    if (!(tof>0) || !(fabs(A)>1e-12*(r1_norm+r2_norm)) || !isfinite(A)){
+        return -1;
+    }
+    const double sqrt_mu_tof = sqrt(mu)*tof;
+
+    // Bracket the root: F grows without bound towards 4pi^2
+    double C, S, y;
+    double lo = -4*M_PI*M_PI, hi = 4*M_PI*M_PI;
+    double F = lambert_time_function(lo, r1_norm, r2_norm, A, sqrt_mu_tof, &C, &S, &y);
+    for (int i=0; F>0 && i<LAMBERT_MAX_ITERATIONS; i++){
+        hi = lo;
+        lo *= 2;
+        F = lambert_time_function(lo, r1_norm, r2_norm, A, sqrt_mu_tof, &C, &S, &y);
+    }
+    if (!(F<=0)){
+        return -1;
+    }
+
+    double z = lo<0 && hi>0 ? 0 : (lo+hi)/2;
+    int converged = 0;
+    for (int i=0; i<LAMBERT_MAX_ITERATIONS && !converged; i++){
+        F = lambert_time_function(z, r1_norm, r2_norm, A, sqrt_mu_tof, &C, &S, &y);
+        if (F==0){
+            converged = 1;
+            break;
+        }
+        if (F>0){
+            hi = z;
+        } else {
+            lo = z;
+        }
+        double next = (lo+hi)/2;
+        if (y>0){
+            double dF, sqrt_y = sqrt(y);
+            if (fabs(z)<1e-8){
+                dF = sqrt(2.)/40*y*sqrt_y + A/8*(sqrt_y + A*sqrt(1/(2*y)));
+            } else {
+                double x = sqrt(y/C);
+                dF = x*x*x*((C - 1.5*S/C)/(2*z) + 0.75*S*S/C) + A/8*(3*S/C*sqrt_y + A*sqrt(C/y));
+            }
+            double newton = z - F/dF;
+            if (newton>lo && newton<hi){
+                next = newton;
+            }
+        }
+        converged = fabs(next-z)<=1e-14*(1+fabs(z)) || hi-lo<=1e-14*(1+fabs(z));
+        z = next;
+    }
+    lambert_time_function(z, r1_norm, r2_norm, A, sqrt_mu_tof, &C, &S, &y);
+    if (!converged || !(y>0)){
+        return -1;
+    }
+
+    // Lagrange coefficients
+    double f = 1 - y/r1_norm;
+    double g = A*sqrt(y/mu);
+    double g_dot = 1 - y/r2_norm;
+    for (int axis=0; axis<3; axis++){
+        v1[axis] = (r2[axis] - f*r1[axis])/g;
+        v2[axis] = (g_dot*r2[axis] - r1[axis])/g;
+    }
+    return isfinite(v1[0]+v1[1]+v1[2]+v2[0]+v2[1]+v2[2]) ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+The libplanets C ABI of libplanets.h, on top of the batched evaluation of
+orbits_batch.h and the fused states of orbits.h.
+
+Epochs are gathered from the caller's strided buffer a block of
+ORBITS_BATCH_BLOCK at a time, evaluated on the stack as orbits_batch.h
+does, and scattered straight into the caller's output, so the positions
+are bit-identical to xyz_in_j2k_ecliptic_frame_batch and
+xyz_in_icrf_frame_batch and nothing is allocated per call.
+*/
+
+#define PLANETS_BUILDING_LIBRARY
+#include "libplanets.h"
+
+#include <stdlib.h>
+#include "keplerian_elements.h"
+#include "planets.h"
+#include "planets_1800-2050.h"
+#include "orbits.h"
+#include "orbits_batch.h"
+
+struct planets_body_set {
+    size_t n_bodies;
+    keplerian_elements* elements;   // For orbital_state_at_date
+    prepared_elements* prepared;    // For the batch blocks
+};
+
+PLANETS_API int planets_abi_version(void){
+    return PLANETS_ABI_VERSION;
+}
+
+static planets_body_set* planets_body_set_from_keplerian(const keplerian_elements* elements, const size_t n_bodies){
+    planets_body_set* set = (planets_body_set*)malloc(sizeof(planets_body_set));
+    if (set==NULL){
+        return NULL;
+    }
+    set->n_bodies = n_bodies;
+    set->elements = (keplerian_elements*)malloc(n_bodies*sizeof(keplerian_elements));
+    set->prepared = (prepared_elements*)malloc(n_bodies*sizeof(prepared_elements));
+    if (set->elements==NULL || set->prepared==NULL){
+        planets_body_set_destroy(set);
+        return NULL;
+    }
+    for (size_t b=0; b<n_bodies; b++){
+        set->elements[b] = elements[b];
+        prepare_elements(&set->elements[b], &set->prepared[b]);
+    }
+    return set;
+}
+
+PLANETS_API planets_body_set* planets_body_set_create(const planets_elements* elements, size_t n_bodies){
+    if (elements==NULL || n_bodies==0){
+        return NULL;
+    }
+    keplerian_elements* converted = (keplerian_elements*)malloc(n_bodies*sizeof(keplerian_elements));
+    if (converted==NULL){
+        return NULL;
+    }
+    for (size_t b=0; b<n_bodies; b++){
+        const planets_elements* from = &elements[b];
+        keplerian_elements to = {
+            from->a_au, from->e, from->I_deg, from->L_deg, from->lon_periapsis_deg, from->Omega_deg,
+            from->adot, from->edot, from->Idot, from->Ldot, from->lon_periapsisdot, from->Omegadot,
+            from->b, from->c, from->s, from->f
+        };
+        converted[b] = to;
+    }
+    planets_body_set* set = planets_body_set_from_keplerian(converted, n_bodies);
+    free(converted);
+    return set;
+}
+
+PLANETS_API planets_body_set* planets_body_set_create_builtin(int table){
+    if (table==PLANETS_ELEMENTS_3000BC_3000AD){
+        const keplerian_elements planets[8] = {Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+        return planets_body_set_from_keplerian(planets, 8);
+    }
+    if (table==PLANETS_ELEMENTS_1800_2050){
+        const keplerian_elements planets_sr[8] = {Mercury_sr, Venus_sr, Earth_Moon_barycenter_sr, Mars_sr, Jupiter_sr, Saturn_sr, Uranus_sr, Neptune_sr};
+        return planets_body_set_from_keplerian(planets_sr, 8);
+    }
+    return NULL;
+}
+
+PLANETS_API void planets_body_set_destroy(planets_body_set* set){
+    if (set==NULL){
+        return;
+    }
+    free(set->elements);
+    free(set->prepared);
+    free(set);
+}
+
+PLANETS_API size_t planets_body_set_size(const planets_body_set* set){
+    return set==NULL ? 0 : set->n_bodies;
+}
+
+static int planets_check_arguments(const planets_body_set* set, const double* days_since_j2k, const size_t n_epochs, const double* out){
+    return set!=NULL && (n_epochs==0 || (days_since_j2k!=NULL && out!=NULL));
+}
+
+static inline double planets_strided_in(const double* base, const ptrdiff_t stride, const size_t k){
+    return *(const double*)((const char*)base + (ptrdiff_t)k*stride);
+}
+
+static inline double* planets_strided_out(double* base, const size_t b, const ptrdiff_t body_stride, const size_t k, const ptrdiff_t epoch_stride){
+    return (double*)((char*)base + (ptrdiff_t)b*body_stride + (ptrdiff_t)k*epoch_stride);
+}
+
+#define PLANETS_COMPONENT(out, c, component_stride) (*(double*)((char*)(out) + (ptrdiff_t)(c)*(component_stride)))
+
+PLANETS_API int planets_positions(const planets_body_set* set, int frame,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride, ptrdiff_t component_stride){
+    if (!planets_check_arguments(set, days_since_j2k, n_epochs, out) || (frame!=PLANETS_FRAME_ECLIPTIC_J2000 && frame!=PLANETS_FRAME_ICRF)){
+        return -1;
+    }
+    const double cos_obliquity = COS_OBLIQUITY_J2K;
+    const double sin_obliquity = SIN_OBLIQUITY_J2K;
+    double days[ORBITS_BATCH_BLOCK], x[ORBITS_BATCH_BLOCK], y[ORBITS_BATCH_BLOCK], z[ORBITS_BATCH_BLOCK];
+    for (size_t first=0; first<n_epochs; first+=ORBITS_BATCH_BLOCK){
+        size_t n = n_epochs-first < ORBITS_BATCH_BLOCK ? n_epochs-first : ORBITS_BATCH_BLOCK;
+        for (size_t k=0; k<n; k++){
+            days[k] = planets_strided_in(days_since_j2k, days_stride, first+k);
+        }
+        for (size_t b=0; b<set->n_bodies; b++){
+            prepared_xyz_in_j2k_ecliptic_frame_block(&set->prepared[b], days, n, x, y, z);
+            if (frame==PLANETS_FRAME_ICRF){
+                for (size_t k=0; k<n; k++){
+                    double y_ecl_au = y[k];
+                    double z_ecl_au = z[k];
+                    y[k] = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+                    z[k] = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+                }
+            }
+            for (size_t k=0; k<n; k++){
+                double* epoch = planets_strided_out(out, b, body_stride, first+k, epoch_stride);
+                PLANETS_COMPONENT(epoch, 0, component_stride) = x[k];
+                PLANETS_COMPONENT(epoch, 1, component_stride) = y[k];
+                PLANETS_COMPONENT(epoch, 2, component_stride) = z[k];
+            }
+        }
+    }
+    return 0;
+}
+
+PLANETS_API int planets_states(const planets_body_set* set, int frame,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride, ptrdiff_t component_stride){
+    if (!planets_check_arguments(set, days_since_j2k, n_epochs, out) || (frame!=PLANETS_FRAME_ECLIPTIC_J2000 && frame!=PLANETS_FRAME_ICRF)){
+        return -1;
+    }
+    for (size_t k=0; k<n_epochs; k++){
+        double days = planets_strided_in(days_since_j2k, days_stride, k);
+        for (size_t b=0; b<set->n_bodies; b++){
+            orbital_state state;
+            double* epoch = planets_strided_out(out, b, body_stride, k, epoch_stride);
+            if (frame==PLANETS_FRAME_ICRF){
+                orbital_state_at_date(&set->elements[b], days, STATE_ICRF | STATE_VELOCITY, &state);
+                PLANETS_COMPONENT(epoch, 0, component_stride) = state.x_eq_au;
+                PLANETS_COMPONENT(epoch, 1, component_stride) = state.y_eq_au;
+                PLANETS_COMPONENT(epoch, 2, component_stride) = state.z_eq_au;
+                PLANETS_COMPONENT(epoch, 3, component_stride) = state.vx_eq_au_per_day;
+                PLANETS_COMPONENT(epoch, 4, component_stride) = state.vy_eq_au_per_day;
+                PLANETS_COMPONENT(epoch, 5, component_stride) = state.vz_eq_au_per_day;
+            } else {
+                orbital_state_at_date(&set->elements[b], days, STATE_ECLIPTIC | STATE_VELOCITY, &state);
+                PLANETS_COMPONENT(epoch, 0, component_stride) = state.x_ecl_au;
+                PLANETS_COMPONENT(epoch, 1, component_stride) = state.y_ecl_au;
+                PLANETS_COMPONENT(epoch, 2, component_stride) = state.z_ecl_au;
+                PLANETS_COMPONENT(epoch, 3, component_stride) = state.vx_ecl_au_per_day;
+                PLANETS_COMPONENT(epoch, 4, component_stride) = state.vy_ecl_au_per_day;
+                PLANETS_COMPONENT(epoch, 5, component_stride) = state.vz_ecl_au_per_day;
+            }
+        }
+    }
+    return 0;
+}
+
+PLANETS_API int planets_longitudes(const planets_body_set* set,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride){
+    if (!planets_check_arguments(set, days_since_j2k, n_epochs, out)){
+        return -1;
+    }
+    double days[ORBITS_BATCH_BLOCK], longitude_rad[ORBITS_BATCH_BLOCK];
+    for (size_t first=0; first<n_epochs; first+=ORBITS_BATCH_BLOCK){
+        size_t n = n_epochs-first < ORBITS_BATCH_BLOCK ? n_epochs-first : ORBITS_BATCH_BLOCK;
+        for (size_t k=0; k<n; k++){
+            days[k] = planets_strided_in(days_since_j2k, days_stride, first+k);
+        }
+        for (size_t b=0; b<set->n_bodies; b++){
+            prepared_longitude_block(&set->prepared[b], days, n, longitude_rad);
+            for (size_t k=0; k<n; k++){
+                *planets_strided_out(out, b, body_stride, first+k, epoch_stride) = longitude_rad[k];
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+libplanets: the ephemeris as a shared or static library with a stable C
+ABI, for programs that cannot include the headers, such as Python (ctypes,
+cffi), Rust and Go.
+
+This header is the whole interface: it includes nothing of the rest of the
+repository, and its structs, enums and function signatures only change
+with PLANETS_ABI_VERSION. Link against the planets (shared) or
+planets_static target; users of the static library define PLANETS_STATIC.
+
+A body set is an opaque handle holding the elements of its bodies with
+the time-independent work already done (see prepare_elements in
+orbits_batch.h):
+
+    planets_body_set* set = planets_body_set_create_builtin(PLANETS_ELEMENTS_1800_2050);
+    planets_positions(set, PLANETS_FRAME_ICRF, days, n, sizeof(double),
+                      xyz, n*3*sizeof(double), 3*sizeof(double), sizeof(double));
+    planets_body_set_destroy(set);
+
+The batch functions read epochs from and write results straight into
+caller-owned buffers laid out by byte strides, as numpy and Rust slices
+describe them, so nothing is copied on either side of the call. The value
+for body b, epoch k and component c is written at
+
+    (char*)out + b*body_stride + k*epoch_stride + c*component_stride
+
+and epoch k is read at (const char*)days_since_j2k + k*days_stride. A
+C-contiguous numpy array of shape (n_bodies, n_epochs, 3) has the strides
+(n_epochs*24, 24, 8); one of shape (3, n_bodies, n_epochs) has
+(n_epochs*8, 8, n_bodies*n_epochs*8). Strides may be negative, and must
+keep every double 8-byte aligned.
+
+A body set is never written after its creation, and the only global
+state is the instruction set detected on the first batch call, which
+kepler_simd.h caches with an atomic load and store. So every function may
+be called from any number of threads at once, on the same set or
+different ones, first calls included. Only planets_body_set_destroy
+must not race with other uses of its set.
+
+Functions returning int return 0 on success and -1 on invalid arguments,
+in which case nothing is written.
+*/
+
+#ifndef LIBPLANETS_H
+#define LIBPLANETS_H
+
+#include <stddef.h>
+
+#if defined(PLANETS_STATIC)
+#define PLANETS_API
+#elif defined(_WIN32)
+#ifdef PLANETS_BUILDING_LIBRARY
+#define PLANETS_API __declspec(dllexport)
+#else
+#define PLANETS_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define PLANETS_API __attribute__((visibility("default")))
+#else
+#define PLANETS_API
+#endif
+
+#define PLANETS_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Keplerian elements and their rates, as in keplerian_elements.h and the
+// tables of https://ssd.jpl.nasa.gov/planets/approx_pos.html
+typedef struct planets_elements {
+    double a_au;                // Semi-major axis, AU
+    double e;                   // Eccentricity
+    double I_deg;               // Inclination, degrees
+    double L_deg;               // Mean longitude, degrees
+    double lon_periapsis_deg;   // Longitude of the perihelion, degrees
+    double Omega_deg;           // Longitude of the ascending node, degrees
+
+    double adot;                // AU/century
+    double edot;                // per century
+    double Idot;                // degrees/century
+    double Ldot;                // degrees/century
+    double lon_periapsisdot;    // degrees/century
+    double Omegadot;            // degrees/century
+
+    double b;                   // Corrections to the mean anomaly for
+    double c;                   // Jupiter-Neptune over 3000 BC-3000 AD,
+    double s;                   // zero otherwise
+    double f;
+} planets_elements;
+
+// The built-in element tables, each giving Mercury, Venus, the Earth-Moon
+// barycenter, Mars, Jupiter, Saturn, Uranus and Neptune in that order
+enum planets_table {
+    PLANETS_ELEMENTS_3000BC_3000AD = 0,     // planets.h
+    PLANETS_ELEMENTS_1800_2050 = 1          // planets_1800-2050.h
+};
+
+enum planets_frame {
+    PLANETS_FRAME_ECLIPTIC_J2000 = 0,
+    PLANETS_FRAME_ICRF = 1
+};
+
+typedef struct planets_body_set planets_body_set;
+
+// PLANETS_ABI_VERSION of the library actually loaded, to be checked
+// against the header a binding was written for.
+PLANETS_API int planets_abi_version(void);
+
+// A body set of n_bodies elements, copied. Returns NULL if n_bodies is 0
+// or allocation fails.
+PLANETS_API planets_body_set* planets_body_set_create(const planets_elements* elements, size_t n_bodies);
+
+// The eight planets of one of the planets_table tables. Returns NULL for
+// an unknown table or if allocation fails.
+PLANETS_API planets_body_set* planets_body_set_create_builtin(int table);
+
+// Accepts NULL.
+PLANETS_API void planets_body_set_destroy(planets_body_set* set);
+
+PLANETS_API size_t planets_body_set_size(const planets_body_set* set);
+
+// Heliocentric positions in AU of every body of set at n_epochs epochs, in
+// the planets_frame frame: x, y, z are components 0, 1, 2.
+PLANETS_API int planets_positions(const planets_body_set* set, int frame,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride, ptrdiff_t component_stride);
+
+// Heliocentric positions in AU and velocities in AU/day: x, y, z, vx, vy,
+// vz are components 0 to 5.
+PLANETS_API int planets_states(const planets_body_set* set, int frame,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride, ptrdiff_t component_stride);
+
+// Heliocentric ecliptic longitudes in radians, in [-pi, pi).
+PLANETS_API int planets_longitudes(const planets_body_set* set,
+    const double* days_since_j2k, size_t n_epochs, ptrdiff_t days_stride,
+    double* out, ptrdiff_t body_stride, ptrdiff_t epoch_stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,64 +1,76 @@
+/*
+Planets with no arguments prints a report for today. With arguments it
+streams positions for many epochs:
+
+    Planets [--range START STOP STEP | --input FILE] [--time days|jd]
+            [--bodies NAME,...] [--frame icrf|ecliptic]
+            [--format csv|binary] [--output FILE] [--no-header]
+
+Epochs are read one per line from FILE, or from stdin when neither
+--range nor --input is given; blank lines and lines starting with # are
+skipped. An epoch is an ISO-8601 timestamp or a number, days since J2000
+or with --time jd a Julian date. --range steps from START to STOP
+inclusive by STEP days, START and STOP being epochs too.
+
+Bodies are mercury, venus, earth (the Earth-Moon barycenter), mars,
+jupiter, saturn, uranus and neptune, all of them by default, and
+positions are in AU in the ICRF frame or the J2000 ecliptic frame.
+
+csv writes one row per epoch: the epoch (days since J2000, or the Julian
+date with --time jd) and x, y, z of each body, after a header row unless
+--no-header. binary writes the same numbers as little-endian IEEE
+doubles, 1+3*n_bodies per epoch and no header.
+*/
 #include <time.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "planets.h"
 #include "orbits.h"
-extern long int timezone; // Seconds between localtime and UTC.
+#include "julian_date.h"
+#include "orbits_batch.h"
+#include "stream_io.h"
+
+// Epochs evaluated per call of the batch functions
+#define STREAM_BLOCK 1024
+#define STREAM_BUFFER_BYTES (1<<22)
+#define STREAM_TIME_DECIMALS 8
+#define STREAM_AU_DECIMALS 12
 
-int main(){
+typedef enum output_format {
+    OUTPUT_CSV = 0,
+    OUTPUT_BINARY
+} output_format;
+
+typedef struct stream_options {
+    const char* input_path;     // NULL for stdin
+    const char* output_path;    // NULL for stdout
+    int has_range;
+    double range_start, range_stop, range_step;
+    epoch_format time;
+    int icrf;                   // Else the J2000 ecliptic frame
+    output_format format;
+    int header;
+    keplerian_elements bodies[8];
+    const char* body_names[8];
+    int n_bodies;
+} stream_options;
+
+static const char* const body_names[8] = {"mercury", "venus", "earth", "mars", "jupiter", "saturn", "uranus", "neptune"};
+
+static void print_report(void){
     // Get time, inspired by time(&timer);  /* get current time; same as: timer = time(NULL)  */
     time_t timer;
     time(&timer);  // get current time as seconds since UTC epoch
 
     /* We would like the current time in days (defined as 24*60*60s) since the
     J2000 epoch, which is 12 noon on Jan 1, 2000 in the UTC timezone. 
+    time_t counts seconds since the Unix epoch in UTC whatever the local
+    timezone, so this is arithmetic only.
     */
-
-    // J2K time is 2000-1-1 12:00 *IN GMT TIMEZONE*. 
-    // This computes a time in the LOCAL timezone
-    struct tm j2000_tm = {
-        .tm_sec=0,    // Seconds after the minute
-        .tm_min=0,    // Minutes after the hour
-        .tm_hour=12,  // Hours since midnight
-        .tm_mday=1,   // Day of the month, 1-31
-        .tm_mon=0,    // Months since Jan, 0-11
-        .tm_year=100, // Years since 1900
-    };
-
-    // struct tm unix_reference_but_local_tm = {
-    //     .tm_sec=0,    // Seconds after the minute
-    //     .tm_min=0,    // Minutes after the hour
-    //     .tm_hour=0,  // Hours since midnight
-    //     .tm_mday=1,   // Day of the month, 1-31
-    //     .tm_mon=0,    // Months since Jan, 0-11
-    //     .tm_year=70, // Years since 1900
-    // };
-
-    struct tm mars_opposition_tm = { // Jan 16 2025, https://www.skyatnightmagazine.com/advice/skills/mars-opposition
-        .tm_sec=0,    // Seconds after the minute
-        .tm_min=0,    // Minutes after the hour
-        .tm_hour=0,  // Hours since midnight
-        .tm_mday=16,   // Day of the month, 1-31
-        .tm_mon=0,    // Months since Jan, 0-11
-        .tm_year=125, // Years since 1900
-    };
-
-    struct tm mars_conjunction_tm = { // Sept 2 2019, https://www.jpl.nasa.gov/news/whats-mars-solar-conjunction-and-why-does-it-matter/
-        .tm_sec=0,    // Seconds after the minute
-        .tm_min=0,    // Minutes after the hour
-        .tm_hour=0,  // Hours since midnight
-        .tm_mday=2,   // Day of the month, 1-31
-        .tm_mon=8,    // Months since Jan, 0-11
-        .tm_year=119, // Years since 1900
-    };
-    
-    time_t j2000_localtime = mktime(&j2000_tm);
-    time_t j2000_utctime = j2000_localtime-timezone; 
-    // time_t julian_epoch_time = mktime(&julian_epoch_tm);
-    // time_t unix_epoch_local_time = mktime(&unix_reference_but_local_tm);
-    
-    double seconds_since_j2k = difftime(timer, j2000_utctime);
-    double days_since_j2k = seconds_since_j2k/(60*60*24);
+    double seconds_since_j2k = (double)timer - J2000_UNIX_SECONDS;
+    double days_since_j2k = days_since_j2k_from_unix((double)timer);
 
     double true_anomaly_Earth = true_anomaly_at_date(Earth_Moon_barycenter, days_since_j2k);
     double longitude_Earth = longitude_at_date(Earth_Moon_barycenter, days_since_j2k);
@@ -78,22 +90,284 @@ int main(){
         printf("Longitude for planet %d: %f rad, %f deg\n", i, longitude_planet, longitude_planet*180./M_PI);
     }
 
-    double mars_opposition_j2k_seconds = difftime(mktime(&mars_opposition_tm), j2000_utctime);
-    double mars_opposition_25_date = mars_opposition_j2k_seconds/(60*60*24);
+    double mars_opposition_25_date = days_since_j2k_from_utc(2025, 1, 16, 0, 0, 0); // Jan 16 2025, https://www.skyatnightmagazine.com/advice/skills/mars-opposition
 
     double earth_lon_at_mars_opposition = longitude_at_date(Earth_Moon_barycenter, mars_opposition_25_date);
     double mars_lon_at_mars_opposition = longitude_at_date(Mars, mars_opposition_25_date);
 
     printf (" On Jan 16 2025, Earth longitude is %f and Mars longitude is %f. Mars is supposed to be at opposition\n", earth_lon_at_mars_opposition*180./M_PI, mars_lon_at_mars_opposition*180./M_PI);
 
-    double mars_conjunction_j2k_seconds = difftime(mktime(&mars_conjunction_tm), j2000_utctime);
-    double mars_conjunction_j2k_date = mars_conjunction_j2k_seconds/(60*60*24);
+    double mars_conjunction_j2k_date = days_since_j2k_from_utc(2019, 9, 2, 0, 0, 0); // Sept 2 2019, https://www.jpl.nasa.gov/news/whats-mars-solar-conjunction-and-why-does-it-matter/
 
     double earth_lon_at_mars_conjunction = longitude_at_date(Earth_Moon_barycenter, mars_conjunction_j2k_date);
     double mars_lon_at_mars_conjunction = longitude_at_date(Mars, mars_conjunction_j2k_date);
 
     printf (" On Sept 2 2019, Earth longitude is %f and Mars longitude is %f. Mars is supposed to be at conjunction\n", earth_lon_at_mars_conjunction*180./M_PI, mars_lon_at_mars_conjunction*180./M_PI);
+}
+
+static void print_usage(const char* program){
+    fprintf(stderr, "usage: %s [--range START STOP STEP | --input FILE] [--time days|jd] [--bodies NAME,...] [--frame icrf|ecliptic] [--format csv|binary] [--output FILE] [--no-header]\n", program);
+}
 
+// Comma-separated body names into options. Returns 0, or -1 for an
+// unknown or repeated name.
+static int parse_bodies(const char* list, stream_options* options){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    options->n_bodies = 0;
+    while (*list!='\0'){
+        size_t length = strcspn(list, ",");
+        int found = -1;
+        for (int i=0; i<8; i++){
+            if (strlen(body_names[i])==length && strncmp(list, body_names[i], length)==0){
+                found = i;
+            }
+        }
+        for (int i=0; i<options->n_bodies && found>=0; i++){
+            if (options->body_names[i]==body_names[found]){
+                found = -1;
+            }
+        }
+        if (found<0){
+            return -1;
+        }
+        options->bodies[options->n_bodies] = planets[found];
+        options->body_names[options->n_bodies] = body_names[found];
+        options->n_bodies++;
+        list += length;
+        list += *list==',';
+    }
+    return options->n_bodies>0 ? 0 : -1;
+}
+
+// Returns 0, or -1 after printing what is wrong.
+static int parse_options(int argc, char** argv, stream_options* options){
+    memset(options, 0, sizeof(*options));
+    options->time = EPOCH_DAYS_SINCE_J2K;
+    options->icrf = 1;
+    options->format = OUTPUT_CSV;
+    options->header = 1;
+    parse_bodies("mercury,venus,earth,mars,jupiter,saturn,uranus,neptune", options);
+
+    const char* range_text[3] = {NULL, NULL, NULL};
+    for (int i=1; i<argc; i++){
+        const char* arg = argv[i];
+        int has_value = i+1<argc;
+        if (strcmp(arg, "--range")==0 && i+3<argc){
+            range_text[0] = argv[++i];
+            range_text[1] = argv[++i];
+            range_text[2] = argv[++i];
+            options->has_range = 1;
+        } else if (strcmp(arg, "--input")==0 && has_value){
+            options->input_path = argv[++i];
+        } else if (strcmp(arg, "--output")==0 && has_value){
+            options->output_path = argv[++i];
+        } else if (strcmp(arg, "--time")==0 && has_value){
+            const char* value = argv[++i];
+            if (strcmp(value, "days")==0){
+                options->time = EPOCH_DAYS_SINCE_J2K;
+            } else if (strcmp(value, "jd")==0){
+                options->time = EPOCH_JULIAN_DATE;
+            } else {
+                fprintf(stderr, "unknown time scale: %s\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--bodies")==0 && has_value){
+            if (parse_bodies(argv[++i], options)!=0){
+                fprintf(stderr, "bad body list: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(arg, "--frame")==0 && has_value){
+            const char* value = argv[++i];
+            if (strcmp(value, "icrf")==0 || strcmp(value, "ecliptic")==0){
+                options->icrf = strcmp(value, "icrf")==0;
+            } else {
+                fprintf(stderr, "unknown frame: %s\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--format")==0 && has_value){
+            const char* value = argv[++i];
+            if (strcmp(value, "csv")==0 || strcmp(value, "binary")==0){
+                options->format = strcmp(value, "csv")==0 ? OUTPUT_CSV : OUTPUT_BINARY;
+            } else {
+                fprintf(stderr, "unknown format: %s\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--no-header")==0){
+            options->header = 0;
+        } else {
+            fprintf(stderr, "bad argument: %s\n", arg);
+            return -1;
+        }
+    }
 
+    if (options->has_range){
+        char* end;
+        options->range_step = strtod(range_text[2], &end);
+        if (parse_epoch(range_text[0], strlen(range_text[0]), options->time, &options->range_start)!=0
+            || parse_epoch(range_text[1], strlen(range_text[1]), options->time, &options->range_stop)!=0
+            || *end!='\0' || !(options->range_step>0) || options->range_stop<options->range_start){
+            fprintf(stderr, "bad range: %s %s %s\n", range_text[0], range_text[1], range_text[2]);
+            return -1;
+        }
+        if (options->input_path!=NULL){
+            fprintf(stderr, "--range and --input are exclusive\n");
+            return -1;
+        }
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+static void write_header(const stream_options* options, stream_writer* writer){
+    static const char* const axes[3] = {"x", "y", "z"};
+    char* out = stream_writer_reserve(writer, 64);
+    writer->used += (size_t)sprintf(out, "%s", options->time==EPOCH_JULIAN_DATE ? "julian_date" : "days_since_j2k");
+    for (int b=0; b<options->n_bodies; b++){
+        for (int axis=0; axis<3; axis++){
+            out = stream_writer_reserve(writer, 64);
+            writer->used += (size_t)sprintf(out, ",%s_%s_au", options->body_names[b], axes[axis]);
+        }
+    }
+    out = stream_writer_reserve(writer, 1);
+    *out = '\n';
+    writer->used++;
+}
+
+// Positions of the bodies at n epochs, appended to the output.
+static void write_block(const stream_options* options, const double* days_since_j2k, const size_t n, stream_writer* writer){
+    static double xyz[3][8][STREAM_BLOCK];
+    double* x[8]; double* y[8]; double* z[8];
+    for (int b=0; b<options->n_bodies; b++){
+        x[b] = xyz[0][b];
+        y[b] = xyz[1][b];
+        z[b] = xyz[2][b];
+    }
+    if (options->icrf){
+        xyz_in_icrf_frame_batch(options->bodies, (size_t)options->n_bodies, days_since_j2k, n, x, y, z);
+    } else {
+        xyz_in_j2k_ecliptic_frame_batch(options->bodies, (size_t)options->n_bodies, days_since_j2k, n, x, y, z);
+    }
+
+    const double time_offset = options->time==EPOCH_JULIAN_DATE ? J2000_JULIAN_DATE : 0;
+    const size_t n_values = 1 + 3*(size_t)options->n_bodies;
+    for (size_t k=0; k<n; k++){
+        if (options->format==OUTPUT_BINARY){
+            unsigned char* out = (unsigned char*)stream_writer_reserve(writer, 8*n_values);
+            store_le_f64(days_since_j2k[k] + time_offset, out);
+            for (int b=0; b<options->n_bodies; b++){
+                store_le_f64(x[b][k], out + 8*(1+3*b));
+                store_le_f64(y[b][k], out + 8*(2+3*b));
+                store_le_f64(z[b][k], out + 8*(3+3*b));
+            }
+            writer->used += 8*n_values;
+        } else {
+            char* out = stream_writer_reserve(writer, n_values*(STREAM_FIXED_MAX_LENGTH+1));
+            size_t used = format_fixed(days_since_j2k[k] + time_offset, STREAM_TIME_DECIMALS, out);
+            for (int b=0; b<options->n_bodies; b++){
+                out[used++] = ',';
+                used += format_fixed(x[b][k], STREAM_AU_DECIMALS, out+used);
+                out[used++] = ',';
+                used += format_fixed(y[b][k], STREAM_AU_DECIMALS, out+used);
+                out[used++] = ',';
+                used += format_fixed(z[b][k], STREAM_AU_DECIMALS, out+used);
+            }
+            out[used++] = '\n';
+            writer->used += used;
+        }
+    }
+}
+
+// Returns 0 on success, 1 on a bad epoch or an I/O error.
+static int stream_positions(const stream_options* options, FILE* input, stream_writer* writer){
+    double days[STREAM_BLOCK];
+    size_t n = 0;
+    int failed = 0;
+    if (options->header && options->format==OUTPUT_CSV){
+        write_header(options, writer);
+    }
+
+    if (options->has_range){
+        double n_steps = floor((options->range_stop - options->range_start)/options->range_step + 1e-9);
+        for (double k=0; k<=n_steps; k++){
+            days[n++] = options->range_start + k*options->range_step;
+            if (n==STREAM_BLOCK){
+                write_block(options, days, n, writer);
+                n = 0;
+            }
+        }
+    } else {
+        static char input_buffer[STREAM_BUFFER_BYTES];
+        line_reader reader;
+        line_reader_init(&reader, input, input_buffer, sizeof(input_buffer));
+        const char* line;
+        size_t length;
+        int status;
+        while ((status = line_reader_next(&reader, &line, &length))==1){
+            size_t skip = 0;
+            while (skip<length && (line[skip]==' ' || line[skip]=='\t')){
+                skip++;
+            }
+            if (skip==length || line[skip]=='#'){
+                continue;
+            }
+            if (parse_epoch(line, length, options->time, &days[n])!=0){
+                fprintf(stderr, "line %ld: not an epoch: %.*s\n", reader.line_number, (int)(length<80 ? length : 80), line);
+                failed = 1;
+                break;
+            }
+            if (++n==STREAM_BLOCK){
+                write_block(options, days, n, writer);
+                n = 0;
+            }
+        }
+        if (status<0){
+            fprintf(stderr, "cannot read the epochs\n");
+            failed = 1;
+        }
+    }
+    // The epochs before a bad one are still written
+    if (n>0){
+        write_block(options, days, n, writer);
+    }
+    if (stream_writer_flush(writer)!=0){
+        fprintf(stderr, "cannot write the positions\n");
+        return 1;
+    }
+    return failed;
+}
+
+int main(int argc, char** argv){
+    if (argc<2){
+        print_report();
+        return 0;
+    }
+
+    stream_options options;
+    if (parse_options(argc, argv, &options)!=0){
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    FILE* input = stdin;
+    if (options.input_path!=NULL && (input = fopen(options.input_path, "rb"))==NULL){
+        fprintf(stderr, "cannot open %s\n", options.input_path);
+        return 1;
+    }
+    FILE* output = stdout;
+    if (options.output_path!=NULL && (output = fopen(options.output_path, "wb"))==NULL){
+        fprintf(stderr, "cannot open %s\n", options.output_path);
+        return 1;
+    }
+
+    static char output_buffer[STREAM_BUFFER_BYTES];
+    stream_writer writer;
+    stream_writer_init(&writer, output, output_buffer, sizeof(output_buffer));
+    int status = stream_positions(&options, input, &writer);
+    if (input!=stdin){
+        fclose(input);
+    }
+    if (output!=stdout ? fclose(output)!=0 : fflush(output)!=0){
+        fprintf(stderr, "cannot write the positions\n");
+        status = 1;
+    }
+    return status;
+}
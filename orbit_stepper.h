@@ -0,0 +1,222 @@
+/*
+Propagation of one planet over evenly spaced epochs.
+
+At a fixed step every angle that is linear in time (the argument of
+periapsis, the node, the inclination and the phase of the Jupiter-Neptune
+correction) advances by the same amount each step, so its sine and cosine
+are advanced by a rotation instead of being recomputed. Kepler's equation
+is solved by Newton's method warm-started from the previous steps'
+eccentric anomalies; the corrections are small, so sin(E) and cos(E) are
+rotated along with E by a short Taylor series instead of calling libm.
+
+Rounding accumulates in the rotations, so every
+ORBIT_STEPPER_RENORMALIZE_STEPS steps the state is recomputed from scratch
+at the current epoch. Between refreshes positions agree with
+xyz_in_icrf_frame to within the solver tolerance.
+*/
+
+#ifndef ORBIT_STEPPER_H
+#define ORBIT_STEPPER_H
+
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "orbits_batch.h"
+
+#define ORBIT_STEPPER_RENORMALIZE_STEPS 64
+#define ORBIT_STEPPER_NEWTON_STEP_RAD 1e-8  // Last Newton step; the error left is of order its square
+#define ORBIT_STEPPER_MAX_ROTATION_RAD 1e-3 // Largest angle rotated by the Taylor series
+
+// Sine and cosine of an angle that advances by a fixed step.
+typedef struct angle_rotator {
+    double sin_angle;
+    double cos_angle;
+    double sin_step;
+    double cos_step;
+} angle_rotator;
+
+typedef struct orbit_stepper {
+    prepared_elements elements;
+    double start_days_since_j2k;
+    double step_days;
+    long step;                      // Steps taken since the start
+    double days_since_j2k;          // Current epoch
+
+    angle_rotator omega;            // Argument of periapsis
+    angle_rotator Omega;            // Longitude of the ascending node
+    angle_rotator I;                // Inclination
+    angle_rotator phase;            // Jupiter-Neptune correction, f*t
+
+    double eccentric_anomaly_rad;       // Reduced to about [-pi, pi]
+    double eccentric_anomaly_step_rad;  // Change over the last step
+    double sin_E;
+    double cos_E;
+    double cos_obliquity;
+    double sin_obliquity;
+
+    double x_ecl_au;                // Position at the current epoch
+    double y_ecl_au;
+    double z_ecl_au;
+    double x_eq_au;
+    double y_eq_au;
+    double z_eq_au;
+} orbit_stepper;
+
+SSD_INLINE void angle_rotator_set(angle_rotator* rotator, const double angle_rad, const double step_rad){
+    rotator->sin_angle = sin(angle_rad);
+    rotator->cos_angle = cos(angle_rad);
+    rotator->sin_step = sin(step_rad);
+    rotator->cos_step = cos(step_rad);
+}
+
+SSD_INLINE void angle_rotator_advance(angle_rotator* rotator){
+    double s = rotator->sin_angle*rotator->cos_step + rotator->cos_angle*rotator->sin_step;
+    double c = rotator->cos_angle*rotator->cos_step - rotator->sin_angle*rotator->sin_step;
+    rotator->sin_angle = s;
+    rotator->cos_angle = c;
+}
+
+// Adds delta to E and rotates its sine and cosine to match. Up to
+// ORBIT_STEPPER_MAX_ROTATION_RAD the rotation uses Taylor series whose
+// truncation error is below 1e-20; larger steps go through libm.
+SSD_INLINE void orbit_stepper_rotate_E(const double delta, double* E, double* sin_E, double* cos_E){
+    *E += delta;
+    if (fabs(delta)>ORBIT_STEPPER_MAX_ROTATION_RAD){
+        *sin_E = sin(*E);
+        *cos_E = cos(*E);
+        return;
+    }
+    double d2 = delta*delta;
+    double sin_delta = delta*(1 - d2*(1./6)*(1 - d2*(1./20)));
+    double cos_delta = 1 - d2*0.5*(1 - d2*(1./12)*(1 - d2*(1./30)));
+    double s = *sin_E*cos_delta + *cos_E*sin_delta;
+    double c = *cos_E*cos_delta - *sin_E*sin_delta;
+    *sin_E = s;
+    *cos_E = c;
+}
+
+// Newton's method on Kepler's equation, starting from the previous
+// eccentric anomaly extrapolated by the previous step's change. At a fixed
+// cadence that guess is off by the second difference of E only, so one
+// Newton iteration usually suffices.
+SSD_INLINE void orbit_stepper_solve(orbit_stepper* stepper, const double mean_anomaly_rad, const double e){
+    double E = stepper->eccentric_anomaly_rad;
+    double sin_E = stepper->sin_E, cos_E = stepper->cos_E;
+    orbit_stepper_rotate_E(stepper->eccentric_anomaly_step_rad, &E, &sin_E, &cos_E);
+
+    // Follow the mean anomaly across the +-pi wrap; |E-M| is at most e < 1
+    double wrap_rad = 0;
+    if (fabs(mean_anomaly_rad-E)>M_PI){
+        wrap_rad = 2*M_PI*nearbyint((mean_anomaly_rad-E)*(0.5/M_PI));
+        E += wrap_rad;
+    }
+    int i;
+    for (i=0; i<MAX_NEWTON_ITERATIONS; i++){
+        double delta = -(E - e*sin_E - mean_anomaly_rad)/(1 - e*cos_E);
+        orbit_stepper_rotate_E(delta, &E, &sin_E, &cos_E);
+        if (fabs(delta)<ORBIT_STEPPER_NEWTON_STEP_RAD){
+            i++;
+            break;
+        }
+    }
+#ifdef SSD_SOLVER_STATS
+    SOLVER_STATS_BODY(stepper->elements.a_au);
+    SOLVER_STATS_SOLVE(e, i, i<MAX_NEWTON_ITERATIONS || fabs(E - e*sin_E - mean_anomaly_rad)<NEWTON_EPSILON, E - e*sin_E - mean_anomaly_rad);
+#endif
+    stepper->eccentric_anomaly_step_rad = E - wrap_rad - stepper->eccentric_anomaly_rad;
+    stepper->eccentric_anomaly_rad = E;
+    stepper->sin_E = sin_E;
+    stepper->cos_E = cos_E;
+}
+
+// Solve and rotate to the ecliptic and ICRF frames at the current epoch.
+SSD_INLINE void orbit_stepper_update(orbit_stepper* stepper){
+    const prepared_elements* p = &stepper->elements;
+    const double t = stepper->days_since_j2k;
+
+    double mean_anomaly_rad = p->L_rad - p->lon_periapsis_rad + (p->Ldot - p->lon_periapsisdot)*t;
+    if (p->has_corrections){
+        mean_anomaly_rad += p->b*(t*t) + p->c*stepper->phase.cos_angle + p->s*stepper->phase.sin_angle;
+    }
+    mean_anomaly_rad -= 2*M_PI*nearbyint(mean_anomaly_rad*(0.5/M_PI));
+    double e = p->e + p->edot*t;
+    orbit_stepper_solve(stepper, mean_anomaly_rad, e);
+
+    double a = p->a_au + p->adot*t;
+    double x_orbital_au = a*(stepper->cos_E-e);
+    double y_orbital_au = a*sqrt(1-e*e)*stepper->sin_E;
+
+    double sin_omega = stepper->omega.sin_angle, cos_omega = stepper->omega.cos_angle;
+    double sin_Omega = stepper->Omega.sin_angle, cos_Omega = stepper->Omega.cos_angle;
+    double sin_I = stepper->I.sin_angle, cos_I = stepper->I.cos_angle;
+    double x_ecl_au = (cos_omega*cos_Omega-sin_omega*sin_Omega*cos_I) * x_orbital_au + (-sin_omega*cos_Omega-cos_omega*sin_Omega*cos_I)*y_orbital_au;
+    double y_ecl_au = (cos_omega*sin_Omega+sin_omega*cos_Omega*cos_I) * x_orbital_au + (-sin_omega*sin_Omega+cos_omega*cos_Omega*cos_I)*y_orbital_au;
+    double z_ecl_au = sin_omega*sin_I * x_orbital_au + cos_omega*sin_I*y_orbital_au;
+
+    stepper->x_ecl_au = x_ecl_au;
+    stepper->y_ecl_au = y_ecl_au;
+    stepper->z_ecl_au = z_ecl_au;
+    stepper->x_eq_au = x_ecl_au;
+    stepper->y_eq_au = stepper->cos_obliquity*y_ecl_au - stepper->sin_obliquity*z_ecl_au;
+    stepper->z_eq_au = stepper->sin_obliquity*y_ecl_au + stepper->cos_obliquity*z_ecl_au;
+}
+
+// Recompute every sine and cosine with libm at the current epoch, which
+// discards the rounding accumulated by the recurrences.
+SSD_INLINE void orbit_stepper_renormalize(orbit_stepper* stepper){
+    const prepared_elements* p = &stepper->elements;
+    const double t = stepper->days_since_j2k;
+    const double h = stepper->step_days;
+
+    double Omega_rad = p->Omega_rad + p->Omegadot*t;
+    double omega_rad = p->lon_periapsis_rad + p->lon_periapsisdot*t - Omega_rad;
+    angle_rotator_set(&stepper->omega, omega_rad, (p->lon_periapsisdot-p->Omegadot)*h);
+    angle_rotator_set(&stepper->Omega, Omega_rad, p->Omegadot*h);
+    angle_rotator_set(&stepper->I, p->I_rad + p->Idot*t, p->Idot*h);
+    if (p->has_corrections){
+        angle_rotator_set(&stepper->phase, p->f*t, p->f*h);
+    }
+    stepper->sin_E = sin(stepper->eccentric_anomaly_rad);
+    stepper->cos_E = cos(stepper->eccentric_anomaly_rad);
+}
+
+// Start at start_days_since_j2k, stepping by step_days. The position at the
+// start is available straight away.
+SSD_INLINE void orbit_stepper_init(const keplerian_elements* planet, const double start_days_since_j2k, const double step_days, orbit_stepper* stepper){
+    prepare_elements(planet, &stepper->elements);
+    stepper->start_days_since_j2k = start_days_since_j2k;
+    stepper->step_days = step_days;
+    stepper->step = 0;
+    stepper->days_since_j2k = start_days_since_j2k;
+
+    stepper->cos_obliquity = COS_OBLIQUITY_J2K;
+    stepper->sin_obliquity = SIN_OBLIQUITY_J2K;
+
+    // Any starting point works for Newton, M itself is a fine one.
+    const prepared_elements* p = &stepper->elements;
+    double mean_anomaly_rad = p->L_rad - p->lon_periapsis_rad + (p->Ldot - p->lon_periapsisdot)*start_days_since_j2k;
+    stepper->eccentric_anomaly_rad = mean_anomaly_rad - 2*M_PI*nearbyint(mean_anomaly_rad/(2*M_PI));
+    stepper->eccentric_anomaly_step_rad = 0;
+    orbit_stepper_renormalize(stepper);
+    orbit_stepper_update(stepper);
+}
+
+// Advance to the next epoch and update the positions.
+SSD_INLINE void orbit_stepper_next(orbit_stepper* stepper){
+    stepper->step++;
+    // From the step count rather than by accumulation, so the epochs do not
+    // drift either.
+    stepper->days_since_j2k = stepper->start_days_since_j2k + (double)stepper->step*stepper->step_days;
+    if (stepper->step%ORBIT_STEPPER_RENORMALIZE_STEPS==0){
+        orbit_stepper_renormalize(stepper);
+    } else {
+        angle_rotator_advance(&stepper->omega);
+        angle_rotator_advance(&stepper->Omega);
+        angle_rotator_advance(&stepper->I);
+        if (stepper->elements.has_corrections){
+            angle_rotator_advance(&stepper->phase);
+        }
+    }
+    orbit_stepper_update(stepper);
+}
+
+#endif
@@ -10,22 +10,67 @@ https://ssd.jpl.nasa.gov/planets/approx_pos.html
 #include "keplerian_elements.h"
 #include "math.h"
 #include <stdio.h>
+#include "solver_stats.h"
+#include "fast_math.h"
 typedef double jd; 
 
 #define NEWTON_EPSILON 0.000001*M_PI/180 // SSD suggests 1e-6 degrees
 #define MAX_NEWTON_ITERATIONS 100
+#define OBLIQUITY_J2K_DEG 23.43928 // Obliquity of the ecliptic at J2000
+#define COS_OBLIQUITY_J2K 0.9174821392082875 // cos(OBLIQUITY_J2K_DEG), folded
+#define SIN_OBLIQUITY_J2K 0.3977769780087639
+#define GM_SUN_AU3_PER_DAY2 2.959122082855911e-4 // Gaussian constant squared
 
-double epoch_j2k = 2451545.0;
+SSD_CONSTANT double epoch_j2k = 2451545.0;
 
 // Solve Kepler equation for eccentric anomaly.
 // The equation is M = E-esin(E). 
 // We use Newton-Rapson to find a fixed point and following
 // https://en.wikipedia.org/w/index.php?title=Kepler%27s_equation&section=9
-double Enextf(double E, double e, double M){
+SSD_INLINE double Enextf(double E, double e, double M){
     return E-(E-e*sin(E)-M)/(1-e*cos(E));
 };
 
-double eccentric_anomaly_at_date(const keplerian_elements planet, const double days_since_j2k){
+// Newton iteration on Kepler's equation from a given mean anomaly (rad) and
+// eccentricity. The result is not reduced to [-pi, pi]. The number of
+// Newton steps taken is stored in *n_iterations.
+SSD_INLINE double kepler_solve_counted(const double mean_anomaly_rad, const double e, int* n_iterations){
+    // Initial guess from https://ssd.jpl.nasa.gov/planets/approx_pos.html
+    double sin_E, cos_E;
+    SSD_SINCOS(mean_anomaly_rad, &sin_E, &cos_E);
+    double eccentric_anomaly_rad = mean_anomaly_rad + e*sin_E;
+    SSD_SINCOS(eccentric_anomaly_rad, &sin_E, &cos_E);
+
+    // Newton, as Enextf, with the sine and cosine of each iterate taken once
+    // for both the step and the convergence test
+    int i;
+    for (i=0; i<MAX_NEWTON_ITERATIONS; i++){
+        eccentric_anomaly_rad = eccentric_anomaly_rad-(eccentric_anomaly_rad-e*sin_E-mean_anomaly_rad)/(1-e*cos_E);
+        SSD_SINCOS(eccentric_anomaly_rad, &sin_E, &cos_E);
+        if (fabs(eccentric_anomaly_rad-e*sin_E-mean_anomaly_rad)<NEWTON_EPSILON){
+            i++;
+            break;
+        }
+    }
+    *n_iterations = i;
+    return eccentric_anomaly_rad;
+}
+
+SSD_INLINE double kepler_solve(const double mean_anomaly_rad, const double e){
+    int n_iterations;
+    double eccentric_anomaly_rad = kepler_solve_counted(mean_anomaly_rad, e, &n_iterations);
+#ifdef SSD_SOLVER_STATS
+    double sin_E, cos_E;
+    SSD_SINCOS(eccentric_anomaly_rad, &sin_E, &cos_E);
+    double residual_rad = eccentric_anomaly_rad-e*sin_E-mean_anomaly_rad;
+    SOLVER_STATS_CALL(SOLVER_STATS_KEPLER_SOLVE);
+    SOLVER_STATS_SOLVE(e, n_iterations, fabs(residual_rad)<NEWTON_EPSILON, residual_rad);
+#endif
+    return eccentric_anomaly_rad;
+}
+
+SSD_INLINE double mean_anomaly_at_date(const keplerian_elements planet, const double days_since_j2k){
+    SOLVER_STATS_CALL(SOLVER_STATS_MEAN_ANOMALY_AT_DATE);
     // Compute the time since epoch, T
     // double time_since_epoch_centuries = (julian_date-epoch_j2k)/36525;
     double time_since_epoch_centuries = days_since_j2k/36525;
@@ -35,122 +80,264 @@ double eccentric_anomaly_at_date(const keplerian_elements planet, const double d
     // Compute the argument of periapsis from the longitude of periapsis
     // See https://en.wikipedia.org/wiki/Longitude_of_periapsis
     double lon_periapsis_deg = planet.lon_periapsis_deg+planet.lon_periapsisdot*time_since_epoch_centuries;
-    double Omega_deg = planet.Omega_deg+planet.Omegadot*time_since_epoch_centuries;
 
     double L = planet.L_deg+planet.Ldot*time_since_epoch_centuries; // This carries the motion along the orbit
-    double e = planet.e + planet.edot*time_since_epoch_centuries;
-
-    // Compute argument of the perihelion
-    double argument_of_periapsis = lon_periapsis_deg-Omega_deg;
 
     // Compute the mean anomaly
-    double mean_anomaly_deg = L  
-                           - lon_periapsis_deg
-                           + planet.b*(time_since_epoch_centuries*time_since_epoch_centuries)
-                           + planet.c * cos(planet.f*M_PI/180.*time_since_epoch_centuries)
-                           + planet.s * sin(planet.f*M_PI/180.*time_since_epoch_centuries);
+    double mean_anomaly_deg = L - lon_periapsis_deg;
+    // The Jupiter-Neptune corrections are zero for the other planets
+    if (planet.b!=0 || planet.c!=0 || planet.s!=0){
+        double sin_phase, cos_phase;
+        SSD_SINCOS(planet.f*M_PI/180.*time_since_epoch_centuries, &sin_phase, &cos_phase);
+        mean_anomaly_deg += planet.b*(time_since_epoch_centuries*time_since_epoch_centuries);
+        mean_anomaly_deg += planet.c * cos_phase;
+        mean_anomaly_deg += planet.s * sin_phase;
+    }
     // Reduce mean anomaly to [-180, 180]
-    mean_anomaly_deg = fmod(mean_anomaly_deg+180., 360.)-180.;
+    mean_anomaly_deg = SSD_REDUCE_180_DEG(mean_anomaly_deg);
+
+    return mean_anomaly_deg*M_PI/180;
+}
+
+SSD_INLINE double eccentric_anomaly_at_date(const keplerian_elements planet, const double days_since_j2k){
+    SOLVER_STATS_CALL(SOLVER_STATS_ECCENTRIC_ANOMALY_AT_DATE);
+    SOLVER_STATS_BODY(planet.a_au);
+    double time_since_epoch_centuries = days_since_j2k/36525;
+    double e = planet.e + planet.edot*time_since_epoch_centuries;
 
-    double mean_anomaly_rad = mean_anomaly_deg*M_PI/180;
+    double mean_anomaly_rad = mean_anomaly_at_date(planet, days_since_j2k);
 
-    // printf ("Mean anomaly: %f degrees or %f rad\n", mean_anomaly_deg, mean_anomaly_rad);
+    // printf ("Mean anomaly: %f rad\n", mean_anomaly_rad);
 
     // Solve Kepler equation for eccentric anomaly.
     // The equation is M = E-esin(E). 
     // We use Newton-Rapson to find a fixed point/
-
-    // Initial guess from https://ssd.jpl.nasa.gov/planets/approx_pos.html
-    double eccentric_anomaly_rad = mean_anomaly_rad + e*sin(mean_anomaly_rad);
-
-    // printf ("Eccentric anomaly (initial guess): %f rad\n", eccentric_anomaly_rad);
-
-    // Newton
-    for (int i=0; i<MAX_NEWTON_ITERATIONS; i++){
-        eccentric_anomaly_rad = Enextf(eccentric_anomaly_rad, e, mean_anomaly_rad);
-        if ((eccentric_anomaly_rad-e*sin(eccentric_anomaly_rad)-mean_anomaly_rad)<NEWTON_EPSILON){
-            break;
-        }
-    }
-    eccentric_anomaly_rad = fmod(eccentric_anomaly_rad+M_PI, 2*M_PI)-M_PI;
+    double eccentric_anomaly_rad = kepler_solve(mean_anomaly_rad, e);
+    eccentric_anomaly_rad = SSD_REDUCE_PI(eccentric_anomaly_rad);
     // printf ("Eccentric anomaly (Newton-Rapson): %f rad after %d iterations\n", eccentric_anomaly_rad, i);
     
     return eccentric_anomaly_rad;
 };
 
-double true_anomaly_at_date(const keplerian_elements planet, const double days_since_j2k){
-    // Eccentric anomaly
-    double eccentric_anomaly_rad = eccentric_anomaly_at_date(planet, days_since_j2k);
-    // Eccentricity
-    double time_since_epoch_centuries = days_since_j2k/36525;
-    double e = planet.e + planet.edot*time_since_epoch_centuries;
-    double true_anomaly_rad = atan2(sqrt(1-e*e)*sin(eccentric_anomaly_rad),cos(eccentric_anomaly_rad)-e);
-    true_anomaly_rad = fmod(true_anomaly_rad+M_PI, 2*M_PI)-M_PI;
-    // printf(" From eccentric anomaly %f, we find a true anomaly of %f rad\n", eccentric_anomaly_rad, true_anomaly_rad);
-    
-    return true_anomaly_rad;
-}
-
-double longitude_at_date(const keplerian_elements planet, const double days_since_j2k){
-    double true_anomaly_rad = true_anomaly_at_date(planet, days_since_j2k);
-
-    double time_since_epoch_centuries = days_since_j2k/36525;
-    double lon_periapsis_deg = planet.lon_periapsis_deg+planet.lon_periapsisdot*time_since_epoch_centuries;
-    // With respect to the vernal equinox, if i=0, then you rotate by Omega to
-    // find the RAAN; then rotate by omega to find the periapsis; and finally
-    // run along the orbit by the true anomaly to find the location of the body.
-    // And remember that the longitude of the periapsis IS Omega+omega.
-    double longitude_rad = lon_periapsis_deg*M_PI/180. + true_anomaly_rad;
-    longitude_rad = fmod(longitude_rad+M_PI, 2*M_PI)-M_PI;
-    return longitude_rad;
-}
+// Fields of orbital_state filled in by orbital_state_at_date. Fields that
+// others depend on are computed anyway, e.g. STATE_ICRF also fills in the
+// ecliptic and orbital-plane positions.
+#define STATE_ANOMALIES     0x01 // Mean, eccentric and true anomaly
+#define STATE_LONGITUDE     0x02 // Heliocentric longitude
+#define STATE_ORBITAL_PLANE 0x04 // Position in the orbital plane
+#define STATE_ECLIPTIC      0x08 // Position in the J2000 ecliptic frame
+#define STATE_ICRF          0x10 // Position in the ICRF frame
+#define STATE_VELOCITY      0x20 // Velocities for each position frame requested
+#define STATE_ALL           0x3f
+
+typedef struct orbital_state {
+    double mean_anomaly_rad;        // Reduced to [-pi, pi]
+    double eccentric_anomaly_rad;   // Reduced to [-pi, pi]
+    double true_anomaly_rad;        // Reduced to [-pi, pi]
+    double longitude_rad;           // Heliocentric longitude, reduced to [-pi, pi]
+
+    double x_orbital_au;            // Towards the perihelion
+    double y_orbital_au;
+
+    double x_ecl_au;                // J2000 ecliptic frame
+    double y_ecl_au;
+    double z_ecl_au;
+
+    double x_eq_au;                 // ICRF frame
+    double y_eq_au;
+    double z_eq_au;
+
+    double vx_orbital_au_per_day;   // Velocities, AU/day
+    double vy_orbital_au_per_day;
+
+    double vx_ecl_au_per_day;
+    double vy_ecl_au_per_day;
+    double vz_ecl_au_per_day;
+
+    double vx_eq_au_per_day;
+    double vy_eq_au_per_day;
+    double vz_eq_au_per_day;
+} orbital_state;
+
+// Everything derived from the position of a planet at a date, with a single
+// solve of Kepler's equation and each angle's sine and cosine taken once.
+// Only the fields selected by the STATE_* flags in `fields` are valid
+// afterwards.
+//
+// Velocities are the analytic time derivatives of the positions, including
+// the secular rates of every element (and of the Jupiter-Neptune correction
+// terms), so they are consistent with differentiating the positions.
+SSD_INLINE void orbital_state_at_date(const keplerian_elements* planet, const double days_since_j2k, const int fields, orbital_state* state){
+    SOLVER_STATS_CALL(SOLVER_STATS_ORBITAL_STATE_AT_DATE);
+    SOLVER_STATS_BODY(planet->a_au);
+    int need_ecliptic = fields & (STATE_ECLIPTIC | STATE_ICRF);
+    int need_orbital_plane = need_ecliptic || (fields & (STATE_ORBITAL_PLANE | STATE_VELOCITY));
+    int need_true_anomaly = fields & (STATE_ANOMALIES | STATE_LONGITUDE);
 
-void xy_in_orbital_plane(const keplerian_elements planet, const double days_since_j2k, double* x_au, double* y_au){
     double time_since_epoch_centuries = days_since_j2k/36525;
+    double e = planet->e + planet->edot*time_since_epoch_centuries;
+    double lon_periapsis_deg = planet->lon_periapsis_deg+planet->lon_periapsisdot*time_since_epoch_centuries;
+
+    double mean_anomaly_rad = mean_anomaly_at_date(*planet, days_since_j2k);
+    double eccentric_anomaly_rad = kepler_solve(mean_anomaly_rad, e);
+    double sin_E, cos_E;
+    SSD_SINCOS(eccentric_anomaly_rad, &sin_E, &cos_E);
+    double sqrt_one_minus_e2 = sqrt(1-e*e);
+
+    if (need_true_anomaly){
+        double true_anomaly_rad = SSD_REDUCE_PI(SSD_ATAN2(sqrt_one_minus_e2*sin_E, cos_E-e));
+
+        state->mean_anomaly_rad = mean_anomaly_rad;
+        state->eccentric_anomaly_rad = SSD_REDUCE_PI(eccentric_anomaly_rad);
+        state->true_anomaly_rad = true_anomaly_rad;
+
+        // The longitude of the periapsis is Omega+omega, so the longitude
+        // is that plus the true anomaly.
+        double longitude_rad = lon_periapsis_deg*M_PI/180. + true_anomaly_rad;
+        state->longitude_rad = SSD_REDUCE_PI(longitude_rad);
+    }
 
-    double a = planet.a_au + planet.adot*time_since_epoch_centuries;
-    double e = planet.e    + planet.edot*time_since_epoch_centuries;
-    double E = eccentric_anomaly_at_date(planet, days_since_j2k);
-
-    *x_au = a*(cos(E)-e);
-    *y_au = a*sqrt(1-e*e)*sin(E);
-}
-
-void xyz_in_j2k_ecliptic_frame(const keplerian_elements planet, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au){
-    // First find the position in the orbital plane
-    double x_orbital_au, y_orbital_au;
-
-    xy_in_orbital_plane(planet, days_since_j2k, &x_orbital_au, &y_orbital_au);
-
-    // Next, rotate things
-    double time_since_epoch_centuries = days_since_j2k/36525;
+    if (!need_orbital_plane){
+        return;
+    }
+    double a = planet->a_au + planet->adot*time_since_epoch_centuries;
+    double x_orbital_au = a*(cos_E-e);
+    double y_orbital_au = a*sqrt_one_minus_e2*sin_E;
+    state->x_orbital_au = x_orbital_au;
+    state->y_orbital_au = y_orbital_au;
+
+    int need_velocity = fields & STATE_VELOCITY;
+    double vx_orbital = 0, vy_orbital = 0;
+    if (need_velocity){
+        // Rates per day. M = E-esin(E) differentiates to
+        // Mdot = Edot(1-ecos(E)) - edot sin(E).
+        const double deg_per_century = M_PI/180./36525.;
+        double Mdot_deg = planet->Ldot - planet->lon_periapsisdot;
+        if (planet->b!=0 || planet->c!=0 || planet->s!=0){
+            double phase_rad = planet->f*M_PI/180.*time_since_epoch_centuries;
+            Mdot_deg += 2*planet->b*time_since_epoch_centuries;
+            double sin_phase, cos_phase;
+            SSD_SINCOS(phase_rad, &sin_phase, &cos_phase);
+            Mdot_deg += planet->f*M_PI/180.*(planet->s*cos_phase - planet->c*sin_phase);
+        }
+        double Mdot = Mdot_deg*deg_per_century;
+        double adot = planet->adot/36525.;
+        double edot = planet->edot/36525.;
+        double Edot = (Mdot + edot*sin_E)/(1-e*cos_E);
+
+        vx_orbital = adot*(cos_E-e) - a*(sin_E*Edot + edot);
+        vy_orbital = (adot*sqrt_one_minus_e2 - a*e*edot/sqrt_one_minus_e2)*sin_E + a*sqrt_one_minus_e2*cos_E*Edot;
+        state->vx_orbital_au_per_day = vx_orbital;
+        state->vy_orbital_au_per_day = vy_orbital;
+    }
 
-    double lon_periapsis_deg = planet.lon_periapsis_deg+planet.lon_periapsisdot*time_since_epoch_centuries;
-    double Omega_deg = planet.Omega_deg+planet.Omegadot*time_since_epoch_centuries;
+    if (!need_ecliptic){
+        return;
+    }
+    double Omega_deg = planet->Omega_deg+planet->Omegadot*time_since_epoch_centuries;
     double argument_of_periapsis_deg = lon_periapsis_deg-Omega_deg;
-    double I_deg = planet.I_deg + planet.Idot*time_since_epoch_centuries;
+    double I_deg = planet->I_deg + planet->Idot*time_since_epoch_centuries;
 
     double Omega_rad = Omega_deg*M_PI/180.;
     double I_rad=I_deg*M_PI/180.;
     double omega_rad = argument_of_periapsis_deg*M_PI/180.;
-    
-    *x_ecl_au = (cos(omega_rad)*cos(Omega_rad)-sin(omega_rad)*sin(Omega_rad)*cos(I_rad)) * x_orbital_au + (-sin(omega_rad)*cos(Omega_rad)-cos(omega_rad)*sin(Omega_rad)*cos(I_rad))*y_orbital_au;
-    *y_ecl_au = (cos(omega_rad)*sin(Omega_rad)-sin(omega_rad)*cos(Omega_rad)*cos(I_rad)) * x_orbital_au + (-sin(omega_rad)*sin(Omega_rad)-cos(omega_rad)*cos(Omega_rad)*cos(I_rad))*y_orbital_au;
-    *z_ecl_au = sin(omega_rad)*sin(I_rad) * x_orbital_au + cos(omega_rad)*sin(I_rad)*y_orbital_au;
+
+    double cos_omega, sin_omega, cos_Omega, sin_Omega, cos_I, sin_I;
+    SSD_SINCOS(omega_rad, &sin_omega, &cos_omega);
+    SSD_SINCOS(Omega_rad, &sin_Omega, &cos_Omega);
+    SSD_SINCOS(I_rad, &sin_I, &cos_I);
+
+    // Rotation from the orbital plane to the ecliptic
+    double R11 = cos_omega*cos_Omega-sin_omega*sin_Omega*cos_I, R12 = -sin_omega*cos_Omega-cos_omega*sin_Omega*cos_I;
+    double R21 = cos_omega*sin_Omega+sin_omega*cos_Omega*cos_I, R22 = -sin_omega*sin_Omega+cos_omega*cos_Omega*cos_I;
+    double R31 = sin_omega*sin_I,                               R32 = cos_omega*sin_I;
+
+    double x_ecl_au = R11 * x_orbital_au + R12*y_orbital_au;
+    double y_ecl_au = R21 * x_orbital_au + R22*y_orbital_au;
+    double z_ecl_au = R31 * x_orbital_au + R32*y_orbital_au;
+    state->x_ecl_au = x_ecl_au;
+    state->y_ecl_au = y_ecl_au;
+    state->z_ecl_au = z_ecl_au;
+
+    double vx_ecl = 0, vy_ecl = 0, vz_ecl = 0;
+    if (need_velocity){
+        // v = R v_orbital + Rdot r_orbital, with Rdot from the rates of
+        // omega, Omega and I.
+        const double deg_per_century = M_PI/180./36525.;
+        double omegadot = (planet->lon_periapsisdot-planet->Omegadot)*deg_per_century;
+        double Omegadot = planet->Omegadot*deg_per_century;
+        double Idot = planet->Idot*deg_per_century;
+
+        double R11dot = R12*omegadot - R21*Omegadot + sin_omega*sin_Omega*sin_I*Idot;
+        double R12dot = -R11*omegadot - R22*Omegadot + cos_omega*sin_Omega*sin_I*Idot;
+        double R21dot = R22*omegadot + R11*Omegadot - sin_omega*cos_Omega*sin_I*Idot;
+        double R22dot = -R21*omegadot + R12*Omegadot - cos_omega*cos_Omega*sin_I*Idot;
+        double R31dot = R32*omegadot + sin_omega*cos_I*Idot;
+        double R32dot = -R31*omegadot + cos_omega*cos_I*Idot;
+
+        vx_ecl = R11*vx_orbital + R12*vy_orbital + R11dot*x_orbital_au + R12dot*y_orbital_au;
+        vy_ecl = R21*vx_orbital + R22*vy_orbital + R21dot*x_orbital_au + R22dot*y_orbital_au;
+        vz_ecl = R31*vx_orbital + R32*vy_orbital + R31dot*x_orbital_au + R32dot*y_orbital_au;
+        state->vx_ecl_au_per_day = vx_ecl;
+        state->vy_ecl_au_per_day = vy_ecl;
+        state->vz_ecl_au_per_day = vz_ecl;
+    }
+
+    if (fields & STATE_ICRF){
+        const double cos_obliquity = COS_OBLIQUITY_J2K, sin_obliquity = SIN_OBLIQUITY_J2K;
+        state->x_eq_au = x_ecl_au;
+        state->y_eq_au = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+        state->z_eq_au = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+        if (need_velocity){
+            state->vx_eq_au_per_day = vx_ecl;
+            state->vy_eq_au_per_day = cos_obliquity*vy_ecl - sin_obliquity*vz_ecl;
+            state->vz_eq_au_per_day = sin_obliquity*vy_ecl + cos_obliquity*vz_ecl;
+        }
+    }
 }
 
-void xyz_in_icrf_frame(const keplerian_elements planet, const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
-    // First find the position in the orbital plane
-    double x_ecl_au, y_ecl_au, z_ecl_au;
+SSD_INLINE double true_anomaly_at_date(const keplerian_elements planet, const double days_since_j2k){
+    SOLVER_STATS_CALL(SOLVER_STATS_TRUE_ANOMALY_AT_DATE);
+    orbital_state state;
+    orbital_state_at_date(&planet, days_since_j2k, STATE_ANOMALIES, &state);
+    return state.true_anomaly_rad;
+}
 
-    xyz_in_j2k_ecliptic_frame(planet, days_since_j2k, &x_ecl_au, &y_ecl_au, &z_ecl_au);
+SSD_INLINE double longitude_at_date(const keplerian_elements planet, const double days_since_j2k){
+    SOLVER_STATS_CALL(SOLVER_STATS_LONGITUDE_AT_DATE);
+    // With respect to the vernal equinox, if i=0, then you rotate by Omega to
+    // find the RAAN; then rotate by omega to find the periapsis; and finally
+    // run along the orbit by the true anomaly to find the location of the body.
+    // And remember that the longitude of the periapsis IS Omega+omega.
+    orbital_state state;
+    orbital_state_at_date(&planet, days_since_j2k, STATE_LONGITUDE, &state);
+    return state.longitude_rad;
+}
 
-    double obliquity_rad = 23.43928*M_PI/180.;
+SSD_INLINE void xy_in_orbital_plane(const keplerian_elements planet, const double days_since_j2k, double* x_au, double* y_au){
+    SOLVER_STATS_CALL(SOLVER_STATS_XY_IN_ORBITAL_PLANE);
+    orbital_state state;
+    orbital_state_at_date(&planet, days_since_j2k, STATE_ORBITAL_PLANE, &state);
+    *x_au = state.x_orbital_au;
+    *y_au = state.y_orbital_au;
+}
 
-    *x_eq_au = x_ecl_au;
-    *y_eq_au = cos(obliquity_rad)*y_ecl_au - sin(obliquity_rad)*z_ecl_au;
-    *z_eq_au = sin(obliquity_rad)*y_ecl_au + cos(obliquity_rad)*z_ecl_au;
+SSD_INLINE void xyz_in_j2k_ecliptic_frame(const keplerian_elements planet, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au){
+    SOLVER_STATS_CALL(SOLVER_STATS_XYZ_IN_J2K_ECLIPTIC_FRAME);
+    orbital_state state;
+    orbital_state_at_date(&planet, days_since_j2k, STATE_ECLIPTIC, &state);
+    *x_ecl_au = state.x_ecl_au;
+    *y_ecl_au = state.y_ecl_au;
+    *z_ecl_au = state.z_ecl_au;
+}
 
+SSD_INLINE void xyz_in_icrf_frame(const keplerian_elements planet, const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    SOLVER_STATS_CALL(SOLVER_STATS_XYZ_IN_ICRF_FRAME);
+    orbital_state state;
+    orbital_state_at_date(&planet, days_since_j2k, STATE_ICRF, &state);
+    *x_eq_au = state.x_eq_au;
+    *y_eq_au = state.y_eq_au;
+    *z_eq_au = state.z_eq_au;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+/*
+Batched evaluation of the JPL SSD approximate positions for many planets
+over many epochs.
+
+Outputs are structure-of-arrays: for planet p and epoch k the result is
+written to x[p][k], y[p][k], z[p][k]. The caller owns all the buffers.
+
+Kepler's equation and the trig of the orientation angles are evaluated
+a block of epochs at a time through kepler_simd.h, and with SSD_FAST_MATH
+(fast_math.h) the atan2 of the true anomaly as well.
+*/
+
+#ifndef ORBITS_BATCH_H
+#define ORBITS_BATCH_H
+
+#include <stddef.h>
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "kepler_simd.h"
+
+// Keplerian elements with the time-independent work done up front: angles
+// are in radians and rates are per day instead of per century, so the
+// inner loops only have to do a multiply-add per element.
+typedef struct prepared_elements {
+    double a_au;                // Semi-major axis, AU
+    double e;                   // Eccentricity
+    double I_rad;               // Inclination, rad
+    double L_rad;               // Mean longitude, rad
+    double lon_periapsis_rad;   // Longitude of the perihelion, rad
+    double Omega_rad;           // Longitude of the ascending node, rad
+
+    double adot;                // AU/day
+    double edot;                // per day
+    double Idot;                // rad/day
+    double Ldot;                // rad/day
+    double lon_periapsisdot;    // rad/day
+    double Omegadot;            // rad/day
+
+    double b;                   // rad/day^2
+    double c;                   // rad
+    double s;                   // rad
+    double f;                   // rad/day
+
+    int has_corrections;        // Non-zero for Jupiter-Neptune
+} prepared_elements;
+
+SSD_INLINE void prepare_elements(const keplerian_elements* planet, prepared_elements* prepared){
+    const double deg = M_PI/180.;
+    const double per_day = 1./36525.;
+
+    prepared->a_au = planet->a_au;
+    prepared->e = planet->e;
+    prepared->I_rad = planet->I_deg*deg;
+    prepared->L_rad = planet->L_deg*deg;
+    prepared->lon_periapsis_rad = planet->lon_periapsis_deg*deg;
+    prepared->Omega_rad = planet->Omega_deg*deg;
+
+    prepared->adot = planet->adot*per_day;
+    prepared->edot = planet->edot*per_day;
+    prepared->Idot = planet->Idot*deg*per_day;
+    prepared->Ldot = planet->Ldot*deg*per_day;
+    prepared->lon_periapsisdot = planet->lon_periapsisdot*deg*per_day;
+    prepared->Omegadot = planet->Omegadot*deg*per_day;
+
+    prepared->b = planet->b*deg*per_day*per_day;
+    prepared->c = planet->c*deg;
+    prepared->s = planet->s*deg;
+    prepared->f = planet->f*deg*per_day;
+
+    prepared->has_corrections = planet->b!=0 || planet->c!=0 || planet->s!=0;
+}
+
+// Epochs are processed in blocks of this size so that the per-epoch
+// intermediates stay on the stack and in L1.
+#define ORBITS_BATCH_BLOCK 128
+
+// Mean anomaly (rad) and eccentricity for a block of epochs. The mean
+// anomaly is reduced to [-pi, pi].
+SSD_INLINE void prepared_mean_anomaly_block(const prepared_elements* p, const double* days_since_j2k, const size_t n, double* mean_anomaly_rad, double* e){
+    for (size_t k=0; k<n; k++){
+        double t = days_since_j2k[k];
+        mean_anomaly_rad[k] = p->L_rad + p->Ldot*t - (p->lon_periapsis_rad + p->lon_periapsisdot*t);
+        e[k] = p->e + p->edot*t;
+    }
+    if (p->has_corrections){
+        double phase[ORBITS_BATCH_BLOCK], sin_phase[ORBITS_BATCH_BLOCK], cos_phase[ORBITS_BATCH_BLOCK];
+        for (size_t k=0; k<n; k++){
+            phase[k] = p->f*days_since_j2k[k];
+        }
+        sincos_batch(phase, sin_phase, cos_phase, n);
+        for (size_t k=0; k<n; k++){
+            double t = days_since_j2k[k];
+            mean_anomaly_rad[k] += p->b*(t*t) + p->c*cos_phase[k] + p->s*sin_phase[k];
+        }
+    }
+    for (size_t k=0; k<n; k++){
+        mean_anomaly_rad[k] -= 2*M_PI*nearbyint(mean_anomaly_rad[k]/(2*M_PI));
+    }
+}
+
+// Positions in the J2000 ecliptic frame for one prepared planet over a
+// block of at most ORBITS_BATCH_BLOCK epochs.
+SSD_INLINE void prepared_xyz_in_j2k_ecliptic_frame_block(const prepared_elements* p, const double* days_since_j2k, const size_t n, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au){
+    double M[ORBITS_BATCH_BLOCK], e[ORBITS_BATCH_BLOCK];
+    double E[ORBITS_BATCH_BLOCK], sin_E[ORBITS_BATCH_BLOCK], cos_E[ORBITS_BATCH_BLOCK];
+    prepared_mean_anomaly_block(p, days_since_j2k, n, M, e);
+    SOLVER_STATS_BODY(p->a_au);
+    kepler_solve_sincos_batch(M, e, E, sin_E, cos_E, n);
+
+    double omega[ORBITS_BATCH_BLOCK], sin_omega[ORBITS_BATCH_BLOCK], cos_omega[ORBITS_BATCH_BLOCK];
+    double Omega[ORBITS_BATCH_BLOCK], sin_Omega[ORBITS_BATCH_BLOCK], cos_Omega[ORBITS_BATCH_BLOCK];
+    double I[ORBITS_BATCH_BLOCK], sin_I[ORBITS_BATCH_BLOCK], cos_I[ORBITS_BATCH_BLOCK];
+    for (size_t k=0; k<n; k++){
+        double t = days_since_j2k[k];
+        Omega[k] = p->Omega_rad + p->Omegadot*t;
+        omega[k] = p->lon_periapsis_rad + p->lon_periapsisdot*t - Omega[k];
+        I[k] = p->I_rad + p->Idot*t;
+    }
+    sincos_batch(omega, sin_omega, cos_omega, n);
+    sincos_batch(Omega, sin_Omega, cos_Omega, n);
+    sincos_batch(I, sin_I, cos_I, n);
+
+    for (size_t k=0; k<n; k++){
+        double a = p->a_au + p->adot*days_since_j2k[k];
+        double x_orbital_au = a*(cos_E[k]-e[k]);
+        double y_orbital_au = a*sqrt(1-e[k]*e[k])*sin_E[k];
+
+        x_ecl_au[k] = (cos_omega[k]*cos_Omega[k]-sin_omega[k]*sin_Omega[k]*cos_I[k]) * x_orbital_au + (-sin_omega[k]*cos_Omega[k]-cos_omega[k]*sin_Omega[k]*cos_I[k])*y_orbital_au;
+        y_ecl_au[k] = (cos_omega[k]*sin_Omega[k]+sin_omega[k]*cos_Omega[k]*cos_I[k]) * x_orbital_au + (-sin_omega[k]*sin_Omega[k]+cos_omega[k]*cos_Omega[k]*cos_I[k])*y_orbital_au;
+        z_ecl_au[k] = sin_omega[k]*sin_I[k] * x_orbital_au + cos_omega[k]*sin_I[k]*y_orbital_au;
+    }
+}
+
+// Heliocentric longitudes (rad) for one prepared planet over a block of at
+// most ORBITS_BATCH_BLOCK epochs.
+SSD_INLINE void prepared_longitude_block(const prepared_elements* p, const double* days_since_j2k, const size_t n, double* longitude_rad){
+    double M[ORBITS_BATCH_BLOCK], e[ORBITS_BATCH_BLOCK];
+    double E[ORBITS_BATCH_BLOCK], sin_E[ORBITS_BATCH_BLOCK], cos_E[ORBITS_BATCH_BLOCK];
+    prepared_mean_anomaly_block(p, days_since_j2k, n, M, e);
+    SOLVER_STATS_BODY(p->a_au);
+    kepler_solve_sincos_batch(M, e, E, sin_E, cos_E, n);
+
+#ifdef SSD_FAST_MATH
+    double y[ORBITS_BATCH_BLOCK], x[ORBITS_BATCH_BLOCK], true_anomaly_rad[ORBITS_BATCH_BLOCK];
+    for (size_t k=0; k<n; k++){
+        y[k] = sqrt(1-e[k]*e[k])*sin_E[k];
+        x[k] = cos_E[k]-e[k];
+    }
+    atan2_batch(y, x, true_anomaly_rad, n);
+    for (size_t k=0; k<n; k++){
+        double lon = p->lon_periapsis_rad + p->lon_periapsisdot*days_since_j2k[k] + true_anomaly_rad[k];
+        longitude_rad[k] = fast_reduce_pi(lon);
+    }
+#else
+    for (size_t k=0; k<n; k++){
+        double true_anomaly_rad = atan2(sqrt(1-e[k]*e[k])*sin_E[k], cos_E[k]-e[k]);
+        double lon = p->lon_periapsis_rad + p->lon_periapsisdot*days_since_j2k[k] + true_anomaly_rad;
+        longitude_rad[k] = libm_reduce_pi(lon);
+    }
+#endif
+}
+
+// Positions in the J2000 ecliptic frame of n_planets planets at n_epochs
+// epochs. x_ecl_au[p], y_ecl_au[p] and z_ecl_au[p] must each hold n_epochs
+// doubles.
+SSD_INLINE void xyz_in_j2k_ecliptic_frame_batch(const keplerian_elements* planets, const size_t n_planets, const double* days_since_j2k, const size_t n_epochs, double* const* x_ecl_au, double* const* y_ecl_au, double* const* z_ecl_au){
+    for (size_t p=0; p<n_planets; p++){
+        prepared_elements prepared;
+        prepare_elements(&planets[p], &prepared);
+        double* x = x_ecl_au[p];
+        double* y = y_ecl_au[p];
+        double* z = z_ecl_au[p];
+        for (size_t k=0; k<n_epochs; k+=ORBITS_BATCH_BLOCK){
+            size_t n = n_epochs-k < ORBITS_BATCH_BLOCK ? n_epochs-k : ORBITS_BATCH_BLOCK;
+            prepared_xyz_in_j2k_ecliptic_frame_block(&prepared, days_since_j2k+k, n, x+k, y+k, z+k);
+        }
+    }
+}
+
+// Same as xyz_in_j2k_ecliptic_frame_batch, rotated into the ICRF frame.
+SSD_INLINE void xyz_in_icrf_frame_batch(const keplerian_elements* planets, const size_t n_planets, const double* days_since_j2k, const size_t n_epochs, double* const* x_eq_au, double* const* y_eq_au, double* const* z_eq_au){
+    const double cos_obliquity = COS_OBLIQUITY_J2K;
+    const double sin_obliquity = SIN_OBLIQUITY_J2K;
+
+    xyz_in_j2k_ecliptic_frame_batch(planets, n_planets, days_since_j2k, n_epochs, x_eq_au, y_eq_au, z_eq_au);
+
+    for (size_t p=0; p<n_planets; p++){
+        double* y = y_eq_au[p];
+        double* z = z_eq_au[p];
+        for (size_t k=0; k<n_epochs; k++){
+            double y_ecl_au = y[k];
+            double z_ecl_au = z[k];
+            y[k] = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+            z[k] = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+        }
+    }
+}
+
+// Heliocentric longitudes (rad) of n_planets planets at n_epochs epochs.
+SSD_INLINE void longitude_at_date_batch(const keplerian_elements* planets, const size_t n_planets, const double* days_since_j2k, const size_t n_epochs, double* const* longitude_rad){
+    for (size_t p=0; p<n_planets; p++){
+        prepared_elements prepared;
+        prepare_elements(&planets[p], &prepared);
+        double* lon = longitude_rad[p];
+        for (size_t k=0; k<n_epochs; k+=ORBITS_BATCH_BLOCK){
+            size_t n = n_epochs-k < ORBITS_BATCH_BLOCK ? n_epochs-k : ORBITS_BATCH_BLOCK;
+            prepared_longitude_block(&prepared, days_since_j2k+k, n, lon+k);
+        }
+    }
+}
+
+#endif
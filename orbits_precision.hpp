@@ -0,0 +1,186 @@
+/*
+Batched positions with the arithmetic precision as a template argument.
+
+    std::vector<float> x(n), y(n), z(n);
+    float* xs[1] = {x.data()}; ...
+    xyz_in_icrf_frame_batch<precision_mixed>(&Mars, 1, days, n, xs, ys, zs);
+
+- precision_double: the block kernel of orbits_batch.h itself, through a
+  specialization, so its positions are bit-identical to the untemplated
+  xyz_in_icrf_frame_batch.
+- precision_float: float throughout, including the epoch itself. Kepler's
+  equation and the trig run 16 lanes per vector instead of 8 and the
+  output buffers are half the size, but a float epoch is only good to
+  about 1e-7 relative, so the large Ldot*t terms lose accuracy far from
+  J2000.
+- precision_mixed: the time arguments, the angles linear in t and their
+  reduction to [-pi, pi], are evaluated in double and everything after
+  that in float. Nearly as fast as precision_float, and the error stays
+  at a few float ulp of the result over the whole 1800-2050 range.
+
+Each precision carries max_error_au, a bound on the distance from the
+double-precision positions over 1800-2050 for Mercury to Neptune; the
+tests check it every 0.37 days. Measured maxima:
+
+    precision   Mercury  Earth    Jupiter  Neptune
+    double      0        0        0        0
+    mixed       2e-7     4e-7     2e-6     1.5e-5
+    float       5e-4     2e-4     1.2e-4   3e-5
+    float, 1990-2010
+                3e-5     8e-6     6e-6     3e-5
+*/
+
+#ifndef ORBITS_PRECISION_HPP
+#define ORBITS_PRECISION_HPP
+
+#include <cmath>
+#include <cstddef>
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "orbits_batch.h"
+#include "kepler_simd.h"
+
+struct precision_double {
+    typedef double real;            // Kepler's equation, trig and output
+    typedef double time_argument;   // t and the angles linear in t
+    static constexpr double max_error_au = 0;
+};
+
+struct precision_float {
+    typedef float real;
+    typedef float time_argument;
+    static constexpr double max_error_au = 6e-4;
+};
+
+struct precision_mixed {
+    typedef float real;
+    typedef double time_argument;
+    static constexpr double max_error_au = 2e-5;
+};
+
+inline void kepler_solve_sincos_batch_of(const double* M, const double* e, double* E, double* sin_E, double* cos_E, const size_t n){
+    kepler_solve_sincos_batch(M, e, E, sin_E, cos_E, n);
+}
+
+inline void kepler_solve_sincos_batch_of(const float* M, const float* e, float* E, float* sin_E, float* cos_E, const size_t n){
+    kepler_solve_sincos_batch_f(M, e, E, sin_E, cos_E, n);
+}
+
+inline void sincos_batch_of(const double* x, double* s, double* c, const size_t n){
+    sincos_batch(x, s, c, n);
+}
+
+inline void sincos_batch_of(const float* x, float* s, float* c, const size_t n){
+    sincos_batch_f(x, s, c, n);
+}
+
+// Angle reduced to [-pi, pi] in its own precision.
+template <typename T>
+inline T reduce_angle_rad(const T angle_rad){
+    const T two_pi = T(2*M_PI);
+    return angle_rad - two_pi*std::nearbyint(angle_rad*T(0.5/M_PI));
+}
+
+// Positions in the ICRF frame for one prepared planet over a block of at
+// most ORBITS_BATCH_BLOCK epochs. The float and mixed precisions go through
+// the pipeline below; precision_double is specialized after it.
+template <typename precision>
+inline void prepared_xyz_in_icrf_frame_block(const prepared_elements* p, const double* days_since_j2k, const size_t n, typename precision::real* x_eq_au, typename precision::real* y_eq_au, typename precision::real* z_eq_au){
+    typedef typename precision::real real;
+    typedef typename precision::time_argument time_argument;
+
+    // Elements in the precision of the time arguments
+    const time_argument L_minus_periapsis = time_argument(p->L_rad - p->lon_periapsis_rad);
+    const time_argument Ldot_minus_periapsisdot = time_argument(p->Ldot - p->lon_periapsisdot);
+    const time_argument lon_periapsis = time_argument(p->lon_periapsis_rad), lon_periapsisdot = time_argument(p->lon_periapsisdot);
+    const time_argument Omega0 = time_argument(p->Omega_rad), Omegadot = time_argument(p->Omegadot);
+    const time_argument I0 = time_argument(p->I_rad), Idot = time_argument(p->Idot);
+    const time_argument e0 = time_argument(p->e), edot = time_argument(p->edot);
+    const time_argument a0 = time_argument(p->a_au), adot = time_argument(p->adot);
+
+    time_argument t[ORBITS_BATCH_BLOCK], M_t[ORBITS_BATCH_BLOCK];
+    for (size_t k=0; k<n; k++){
+        t[k] = time_argument(days_since_j2k[k]);
+        M_t[k] = L_minus_periapsis + Ldot_minus_periapsisdot*t[k];
+    }
+    if (p->has_corrections){
+        const time_argument b = time_argument(p->b), c = time_argument(p->c), s = time_argument(p->s), f = time_argument(p->f);
+        time_argument phase[ORBITS_BATCH_BLOCK], sin_phase[ORBITS_BATCH_BLOCK], cos_phase[ORBITS_BATCH_BLOCK];
+        for (size_t k=0; k<n; k++){
+            phase[k] = f*t[k];
+        }
+        sincos_batch_of(phase, sin_phase, cos_phase, n);
+        for (size_t k=0; k<n; k++){
+            M_t[k] += b*(t[k]*t[k]) + c*cos_phase[k] + s*sin_phase[k];
+        }
+    }
+
+    real M[ORBITS_BATCH_BLOCK], e[ORBITS_BATCH_BLOCK], a[ORBITS_BATCH_BLOCK];
+    real omega[ORBITS_BATCH_BLOCK], Omega[ORBITS_BATCH_BLOCK], I[ORBITS_BATCH_BLOCK];
+    for (size_t k=0; k<n; k++){
+        time_argument Omega_t = Omega0 + Omegadot*t[k];
+        M[k] = real(reduce_angle_rad(M_t[k]));
+        omega[k] = real(reduce_angle_rad(lon_periapsis + lon_periapsisdot*t[k] - Omega_t));
+        Omega[k] = real(reduce_angle_rad(Omega_t));
+        I[k] = real(I0 + Idot*t[k]);
+        e[k] = real(e0 + edot*t[k]);
+        a[k] = real(a0 + adot*t[k]);
+    }
+
+    real E[ORBITS_BATCH_BLOCK], sin_E[ORBITS_BATCH_BLOCK], cos_E[ORBITS_BATCH_BLOCK];
+    SOLVER_STATS_BODY(p->a_au);
+    kepler_solve_sincos_batch_of(M, e, E, sin_E, cos_E, n);
+
+    real sin_omega[ORBITS_BATCH_BLOCK], cos_omega[ORBITS_BATCH_BLOCK];
+    real sin_Omega[ORBITS_BATCH_BLOCK], cos_Omega[ORBITS_BATCH_BLOCK];
+    real sin_I[ORBITS_BATCH_BLOCK], cos_I[ORBITS_BATCH_BLOCK];
+    sincos_batch_of(omega, sin_omega, cos_omega, n);
+    sincos_batch_of(Omega, sin_Omega, cos_Omega, n);
+    sincos_batch_of(I, sin_I, cos_I, n);
+
+    const real cos_obliquity = real(COS_OBLIQUITY_J2K);
+    const real sin_obliquity = real(SIN_OBLIQUITY_J2K);
+    for (size_t k=0; k<n; k++){
+        real x_orbital_au = a[k]*(cos_E[k]-e[k]);
+        real y_orbital_au = a[k]*std::sqrt(1-e[k]*e[k])*sin_E[k];
+
+        real x_ecl_au = (cos_omega[k]*cos_Omega[k]-sin_omega[k]*sin_Omega[k]*cos_I[k]) * x_orbital_au + (-sin_omega[k]*cos_Omega[k]-cos_omega[k]*sin_Omega[k]*cos_I[k])*y_orbital_au;
+        real y_ecl_au = (cos_omega[k]*sin_Omega[k]+sin_omega[k]*cos_Omega[k]*cos_I[k]) * x_orbital_au + (-sin_omega[k]*sin_Omega[k]+cos_omega[k]*cos_Omega[k]*cos_I[k])*y_orbital_au;
+        real z_ecl_au = sin_omega[k]*sin_I[k] * x_orbital_au + cos_omega[k]*sin_I[k]*y_orbital_au;
+
+        x_eq_au[k] = x_ecl_au;
+        y_eq_au[k] = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+        z_eq_au[k] = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+    }
+}
+
+// The ecliptic block of orbits_batch.h, rotated into the ICRF frame as its
+// xyz_in_icrf_frame_batch does.
+template <>
+inline void prepared_xyz_in_icrf_frame_block<precision_double>(const prepared_elements* p, const double* days_since_j2k, const size_t n, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    const double cos_obliquity = COS_OBLIQUITY_J2K;
+    const double sin_obliquity = SIN_OBLIQUITY_J2K;
+    prepared_xyz_in_j2k_ecliptic_frame_block(p, days_since_j2k, n, x_eq_au, y_eq_au, z_eq_au);
+    for (size_t k=0; k<n; k++){
+        double y_ecl_au = y_eq_au[k];
+        double z_ecl_au = z_eq_au[k];
+        y_eq_au[k] = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+        z_eq_au[k] = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+    }
+}
+
+// xyz_in_icrf_frame_batch in the given precision: x_eq_au[p], y_eq_au[p]
+// and z_eq_au[p] must each hold n_epochs values of precision::real.
+template <typename precision>
+inline void xyz_in_icrf_frame_batch(const keplerian_elements* planets, const size_t n_planets, const double* days_since_j2k, const size_t n_epochs, typename precision::real* const* x_eq_au, typename precision::real* const* y_eq_au, typename precision::real* const* z_eq_au){
+    for (size_t p=0; p<n_planets; p++){
+        prepared_elements prepared;
+        prepare_elements(&planets[p], &prepared);
+        for (size_t k=0; k<n_epochs; k+=ORBITS_BATCH_BLOCK){
+            size_t n = n_epochs-k < ORBITS_BATCH_BLOCK ? n_epochs-k : ORBITS_BATCH_BLOCK;
+            prepared_xyz_in_icrf_frame_block<precision>(&prepared, days_since_j2k+k, n, x_eq_au[p]+k, y_eq_au[p]+k, z_eq_au[p]+k);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+The planets with their elements known at compile time.
+
+prepared_elements_of converts keplerian_elements to radians and per-day
+rates, the prepared_elements of orbits_batch.h, as a constant expression;
+planets_rad holds the planets of planets.h converted that way.
+
+The function templates take the elements as a template argument,
+
+    double x, y, z;
+    xyz_in_icrf_frame<Mars>(days_since_j2k, &x, &y, &z);
+
+so the conversion is folded into the code, and for the bodies whose
+Jupiter-Neptune corrections are zero those terms are not compiled at all.
+The rotation to the ICRF frame is the constant ecliptic_to_icrf matrix.
+Results agree with the functions of orbits.h to rounding.
+*/
+
+#ifndef PLANETS_HPP
+#define PLANETS_HPP
+
+#include <cmath>
+#include "planets.h"
+#include "orbits.h"
+#include "orbits_batch.h"
+
+constexpr prepared_elements prepared_elements_of(const keplerian_elements& planet){
+    const double deg = M_PI/180.;
+    const double per_day = 1./36525.;
+    return prepared_elements{
+        planet.a_au,
+        planet.e,
+        planet.I_deg*deg,
+        planet.L_deg*deg,
+        planet.lon_periapsis_deg*deg,
+        planet.Omega_deg*deg,
+
+        planet.adot*per_day,
+        planet.edot*per_day,
+        planet.Idot*deg*per_day,
+        planet.Ldot*deg*per_day,
+        planet.lon_periapsisdot*deg*per_day,
+        planet.Omegadot*deg*per_day,
+
+        planet.b*deg*per_day*per_day,
+        planet.c*deg,
+        planet.s*deg,
+        planet.f*deg*per_day,
+
+        planet.b!=0 || planet.c!=0 || planet.s!=0
+    };
+}
+
+// Mercury to Neptune
+inline constexpr prepared_elements planets_rad[8] = {
+    prepared_elements_of(Mercury), prepared_elements_of(Venus), prepared_elements_of(Earth_Moon_barycenter), prepared_elements_of(Mars),
+    prepared_elements_of(Jupiter), prepared_elements_of(Saturn), prepared_elements_of(Uranus), prepared_elements_of(Neptune)
+};
+
+// J2000 ecliptic to ICRF: a rotation by the obliquity about the x axis.
+inline constexpr double ecliptic_to_icrf[3][3] = {
+    {1, 0, 0},
+    {0, COS_OBLIQUITY_J2K, -SIN_OBLIQUITY_J2K},
+    {0, SIN_OBLIQUITY_J2K, COS_OBLIQUITY_J2K}
+};
+
+// Mean anomaly (rad), reduced to [-pi, pi].
+template <const keplerian_elements& planet>
+inline double mean_anomaly_at_date(const double days_since_j2k){
+    constexpr prepared_elements p = prepared_elements_of(planet);
+    const double t = days_since_j2k;
+    double mean_anomaly_rad = p.L_rad - p.lon_periapsis_rad + (p.Ldot - p.lon_periapsisdot)*t;
+    if constexpr (p.has_corrections!=0){
+        mean_anomaly_rad += p.b*(t*t) + p.c*cos(p.f*t) + p.s*sin(p.f*t);
+    }
+    return mean_anomaly_rad - 2*M_PI*nearbyint(mean_anomaly_rad*(0.5/M_PI));
+}
+
+// Eccentric anomaly (rad), reduced to [-pi, pi].
+template <const keplerian_elements& planet>
+inline double eccentric_anomaly_at_date(const double days_since_j2k){
+    constexpr prepared_elements p = prepared_elements_of(planet);
+    double E = kepler_solve(mean_anomaly_at_date<planet>(days_since_j2k), p.e + p.edot*days_since_j2k);
+    return E - 2*M_PI*nearbyint(E*(0.5/M_PI));
+}
+
+template <const keplerian_elements& planet>
+inline double longitude_at_date(const double days_since_j2k){
+    constexpr prepared_elements p = prepared_elements_of(planet);
+    const double t = days_since_j2k;
+    double e = p.e + p.edot*t;
+    double E = kepler_solve(mean_anomaly_at_date<planet>(t), e);
+    double true_anomaly_rad = atan2(sqrt(1-e*e)*sin(E), cos(E)-e);
+    double longitude_rad = p.lon_periapsis_rad + p.lon_periapsisdot*t + true_anomaly_rad;
+    return longitude_rad - 2*M_PI*nearbyint(longitude_rad*(0.5/M_PI));
+}
+
+template <const keplerian_elements& planet>
+inline void xyz_in_j2k_ecliptic_frame(const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au){
+    constexpr prepared_elements p = prepared_elements_of(planet);
+    const double t = days_since_j2k;
+    double e = p.e + p.edot*t;
+    double E = kepler_solve(mean_anomaly_at_date<planet>(t), e);
+    double a = p.a_au + p.adot*t;
+    double x_orbital_au = a*(cos(E)-e);
+    double y_orbital_au = a*sqrt(1-e*e)*sin(E);
+
+    double Omega_rad = p.Omega_rad + p.Omegadot*t;
+    double omega_rad = p.lon_periapsis_rad + p.lon_periapsisdot*t - Omega_rad;
+    double I_rad = p.I_rad + p.Idot*t;
+    double sin_omega = sin(omega_rad), cos_omega = cos(omega_rad);
+    double sin_Omega = sin(Omega_rad), cos_Omega = cos(Omega_rad);
+    double sin_I = sin(I_rad), cos_I = cos(I_rad);
+    *x_ecl_au = (cos_omega*cos_Omega-sin_omega*sin_Omega*cos_I) * x_orbital_au + (-sin_omega*cos_Omega-cos_omega*sin_Omega*cos_I)*y_orbital_au;
+    *y_ecl_au = (cos_omega*sin_Omega+sin_omega*cos_Omega*cos_I) * x_orbital_au + (-sin_omega*sin_Omega+cos_omega*cos_Omega*cos_I)*y_orbital_au;
+    *z_ecl_au = sin_omega*sin_I * x_orbital_au + cos_omega*sin_I*y_orbital_au;
+}
+
+template <const keplerian_elements& planet>
+inline void xyz_in_icrf_frame(const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    double x_ecl_au, y_ecl_au, z_ecl_au;
+    xyz_in_j2k_ecliptic_frame<planet>(days_since_j2k, &x_ecl_au, &y_ecl_au, &z_ecl_au);
+    // Only the non-zero entries of the rotation
+    *x_eq_au = x_ecl_au;
+    *y_eq_au = ecliptic_to_icrf[1][1]*y_ecl_au + ecliptic_to_icrf[1][2]*z_ecl_au;
+    *z_eq_au = ecliptic_to_icrf[2][1]*y_ecl_au + ecliptic_to_icrf[2][2]*z_ecl_au;
+}
+
+#endif
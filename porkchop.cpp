@@ -0,0 +1,115 @@
+/*
+Compute a porkchop plot with porkchop.hpp and write it to a file that
+porkchop_read can load.
+
+    porkchop output.pork [--from BODY] [--to BODY]
+             [--departure START STOP N] [--arrival START STOP N] [--threads N]
+
+Bodies are mercury, venus, earth (the Earth-Moon barycenter), mars,
+jupiter, saturn, uranus and neptune; earth to mars by default. START and
+STOP are days since J2000 or ISO-8601 timestamps, both included; the
+default is the 2026 Mars window on a 2000 x 2000 grid. --threads 0, the
+default, uses every core.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "planets.h"
+#include "porkchop.hpp"
+#include "stream_io.h"
+
+static const char* const porkchop_body_names[8] = {"mercury", "venus", "earth", "mars", "jupiter", "saturn", "uranus", "neptune"};
+
+static void porkchop_usage(const char* program){
+    fprintf(stderr, "usage: %s output.pork [--from BODY] [--to BODY] [--departure START STOP N] [--arrival START STOP N] [--threads N]\n", program);
+}
+
+static int porkchop_body(const char* name){
+    for (int i=0; i<8; i++){
+        if (strcmp(name, porkchop_body_names[i])==0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+// START STOP N into axis. Returns 0, or -1 for unparsable epochs, N < 1 or
+// STOP before START.
+static int porkchop_parse_axis(char** argv, porkchop_axis* axis){
+    double start, stop;
+    long n = atol(argv[2]);
+    if (parse_epoch(argv[0], strlen(argv[0]), EPOCH_DAYS_SINCE_J2K, &start)!=0
+        || parse_epoch(argv[1], strlen(argv[1]), EPOCH_DAYS_SINCE_J2K, &stop)!=0
+        || n<1 || stop<start){
+        return -1;
+    }
+    axis->start_days_since_j2k = start;
+    axis->step_days = n>1 ? (stop-start)/(double)(n-1) : 0;
+    axis->n = (size_t)n;
+    return 0;
+}
+
+int main(int argc, char** argv){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    if (argc<2 || argv[1][0]=='-'){
+        porkchop_usage(argv[0]);
+        return 2;
+    }
+    const char* output = argv[1];
+    int from = 2, to = 3;
+    long n_threads = 0;
+    // 2026-06-01 to 2027-06-01, arriving 2027-01-01 to 2028-06-01
+    porkchop_axis departure = {9647.5, 365./1999, 2000};
+    porkchop_axis arrival = {9861.5, 517./1999, 2000};
+    for (int i=2; i<argc; i++){
+        std::string arg = argv[i];
+        if (arg=="--from" && i+1<argc){
+            from = porkchop_body(argv[++i]);
+        } else if (arg=="--to" && i+1<argc){
+            to = porkchop_body(argv[++i]);
+        } else if (arg=="--departure" && i+3<argc && porkchop_parse_axis(&argv[i+1], &departure)==0){
+            i += 3;
+        } else if (arg=="--arrival" && i+3<argc && porkchop_parse_axis(&argv[i+1], &arrival)==0){
+            i += 3;
+        } else if (arg=="--threads" && i+1<argc){
+            n_threads = atol(argv[++i]);
+        } else {
+            porkchop_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (from<0 || to<0 || from==to || n_threads<0){
+        porkchop_usage(argv[0]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    porkchop_grid grid;
+    {
+        thread_pool pool((size_t)n_threads);
+        porkchop_compute(planets[from], planets[to], departure, arrival, pool, &grid);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    size_t best = grid.c3_km2_per_s2.size();
+    for (size_t cell=0; cell<grid.c3_km2_per_s2.size(); cell++){
+        if (std::isfinite(grid.c3_km2_per_s2[cell]) && (best==grid.c3_km2_per_s2.size() || grid.c3_km2_per_s2[cell]<grid.c3_km2_per_s2[best])){
+            best = cell;
+        }
+    }
+    printf("%s to %s: %zu x %zu cells in %.2f s\n", porkchop_body_names[from], porkchop_body_names[to], departure.n, arrival.n, elapsed);
+    if (best<grid.c3_km2_per_s2.size()){
+        double departure_days = departure.start_days_since_j2k + (double)(best/arrival.n)*departure.step_days;
+        printf("lowest C3 %.3f km^2/s^2 departing %.2f days since J2000, %.1f days of flight, arriving at %.3f km/s\n",
+            grid.c3_km2_per_s2[best], departure_days, grid.tof_days[best], grid.v_infinity_arrival_km_per_s[best]);
+    }
+    if (porkchop_write(output, grid)!=0){
+        fprintf(stderr, "Could not write %s\n", output);
+        return 1;
+    }
+    return 0;
+}
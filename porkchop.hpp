@@ -0,0 +1,203 @@
+/*
+Porkchop plots: launch energy and arrival speed for every pair of a
+departure and an arrival epoch between two bodies.
+
+Each body's heliocentric position and velocity in the J2000 ecliptic frame
+is computed once per epoch of its axis, with the arithmetic of
+xyz_in_j2k_ecliptic_frame, so an n x m grid costs n + m Kepler solves. The
+cells are then cut into PORKCHOP_TILE x PORKCHOP_TILE tiles scheduled on a
+thread_pool, each solving Lambert's problem (lambert.h) cell by cell from
+the cached states, which stay in cache across a tile. Every cell is
+computed with the same arithmetic whatever thread runs it, so the grid
+does not depend on the number of threads.
+
+A cell holds, for the prograde transfer of less than one revolution:
+
+    c3_km2_per_s2                   |v1 - v_departure|^2, launch energy
+    v_infinity_arrival_km_per_s     |v2 - v_arrival|, hyperbolic arrival speed
+    tof_days                        arrival - departure
+
+C3 and the arrival speed are NaN where the arrival is not after the
+departure or Lambert's problem has no solution.
+
+porkchop_write stores a grid as a header followed by the three grids as
+float32, row-major by departure. As for ephemeris_file.h, numbers are in
+the byte order of the machine that wrote the file, with an endian tag.
+*/
+
+#ifndef PORKCHOP_HPP
+#define PORKCHOP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "keplerian_elements.h"
+#include "orbits.h"
+#include "lambert.h"
+#include "thread_pool.hpp"
+
+#define PORKCHOP_TILE 64
+#define KM_PER_S_PER_AU_PER_DAY 1731.4568368055555 // 149597870.7 km / 86400 s
+
+#define PORKCHOP_FILE_MAGIC "SSDPORKC"
+#define PORKCHOP_FILE_ENDIAN_TAG 0x01020304u
+#define PORKCHOP_FILE_VERSION 1
+
+// Epochs start + k*step for k in [0, n).
+struct porkchop_axis {
+    double start_days_since_j2k;
+    double step_days;
+    size_t n;
+};
+
+struct porkchop_grid {
+    porkchop_axis departure;
+    porkchop_axis arrival;
+    std::vector<float> c3_km2_per_s2;               // [departure*arrival.n + arrival]
+    std::vector<float> v_infinity_arrival_km_per_s;
+    std::vector<float> tof_days;
+};
+
+typedef struct porkchop_file_header {
+    char magic[8];              // PORKCHOP_FILE_MAGIC, not NUL-terminated
+    uint32_t endian_tag;        // PORKCHOP_FILE_ENDIAN_TAG as written
+    uint32_t version;           // PORKCHOP_FILE_VERSION
+    uint32_t n_departures;
+    uint32_t n_arrivals;
+    double departure_start_days_since_j2k;
+    double departure_step_days;
+    double arrival_start_days_since_j2k;
+    double arrival_step_days;
+    uint8_t padding[8];
+} porkchop_file_header;
+
+// Heliocentric J2000 ecliptic states of body along axis, six doubles per
+// epoch: x, y, z in AU, then vx, vy, vz in AU/day.
+inline std::vector<double> porkchop_states(const keplerian_elements& body, const porkchop_axis& axis){
+    std::vector<double> states(6*axis.n);
+    for (size_t k=0; k<axis.n; k++){
+        orbital_state state;
+        orbital_state_at_date(&body, axis.start_days_since_j2k + (double)k*axis.step_days, STATE_ECLIPTIC | STATE_VELOCITY, &state);
+        double* s = &states[6*k];
+        s[0] = state.x_ecl_au;
+        s[1] = state.y_ecl_au;
+        s[2] = state.z_ecl_au;
+        s[3] = state.vx_ecl_au_per_day;
+        s[4] = state.vy_ecl_au_per_day;
+        s[5] = state.vz_ecl_au_per_day;
+    }
+    return states;
+}
+
+// One cell from the cached states of both ends.
+inline void porkchop_cell(const double* departure_state, const double* arrival_state, const double tof_days, float* c3_km2_per_s2, float* v_infinity_arrival_km_per_s){
+    double v1[3], v2[3];
+    if (lambert_solve(departure_state, arrival_state, tof_days, GM_SUN_AU3_PER_DAY2, LAMBERT_PROGRADE, v1, v2)!=0){
+        *c3_km2_per_s2 = NAN;
+        *v_infinity_arrival_km_per_s = NAN;
+        return;
+    }
+    double c3 = 0, v_infinity_squared = 0;
+    for (int axis=0; axis<3; axis++){
+        double departure_excess = v1[axis] - departure_state[3+axis];
+        double arrival_excess = v2[axis] - arrival_state[3+axis];
+        c3 += departure_excess*departure_excess;
+        v_infinity_squared += arrival_excess*arrival_excess;
+    }
+    *c3_km2_per_s2 = (float)(c3*KM_PER_S_PER_AU_PER_DAY*KM_PER_S_PER_AU_PER_DAY);
+    *v_infinity_arrival_km_per_s = (float)(sqrt(v_infinity_squared)*KM_PER_S_PER_AU_PER_DAY);
+}
+
+// Fill grid for transfers from departure_body to arrival_body over the
+// departure and arrival axes, on pool.
+inline void porkchop_compute(const keplerian_elements& departure_body, const keplerian_elements& arrival_body, const porkchop_axis& departure, const porkchop_axis& arrival, thread_pool& pool, porkchop_grid* grid){
+    grid->departure = departure;
+    grid->arrival = arrival;
+    const size_t n_cells = departure.n*arrival.n;
+    grid->c3_km2_per_s2.assign(n_cells, 0.f);
+    grid->v_infinity_arrival_km_per_s.assign(n_cells, 0.f);
+    grid->tof_days.assign(n_cells, 0.f);
+
+    const std::vector<double> departure_states = porkchop_states(departure_body, departure);
+    const std::vector<double> arrival_states = porkchop_states(arrival_body, arrival);
+
+    const size_t departure_tiles = (departure.n+PORKCHOP_TILE-1)/PORKCHOP_TILE;
+    const size_t arrival_tiles = (arrival.n+PORKCHOP_TILE-1)/PORKCHOP_TILE;
+    pool.run(departure_tiles*arrival_tiles, [&](size_t tile){
+        size_t first_departure = (tile/arrival_tiles)*PORKCHOP_TILE;
+        size_t first_arrival = (tile%arrival_tiles)*PORKCHOP_TILE;
+        size_t last_departure = std::min(first_departure+PORKCHOP_TILE, departure.n);
+        size_t last_arrival = std::min(first_arrival+PORKCHOP_TILE, arrival.n);
+        for (size_t i=first_departure; i<last_departure; i++){
+            double departure_days = departure.start_days_since_j2k + (double)i*departure.step_days;
+            for (size_t j=first_arrival; j<last_arrival; j++){
+                double tof_days = arrival.start_days_since_j2k + (double)j*arrival.step_days - departure_days;
+                size_t cell = i*arrival.n + j;
+                grid->tof_days[cell] = (float)tof_days;
+                porkchop_cell(&departure_states[6*i], &arrival_states[6*j], tof_days, &grid->c3_km2_per_s2[cell], &grid->v_infinity_arrival_km_per_s[cell]);
+            }
+        }
+    });
+}
+
+// Write grid to path. Returns 0 on success, -1 on I/O errors.
+inline int porkchop_write(const char* path, const porkchop_grid& grid){
+    porkchop_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PORKCHOP_FILE_MAGIC, sizeof(header.magic));
+    header.endian_tag = PORKCHOP_FILE_ENDIAN_TAG;
+    header.version = PORKCHOP_FILE_VERSION;
+    header.n_departures = (uint32_t)grid.departure.n;
+    header.n_arrivals = (uint32_t)grid.arrival.n;
+    header.departure_start_days_since_j2k = grid.departure.start_days_since_j2k;
+    header.departure_step_days = grid.departure.step_days;
+    header.arrival_start_days_since_j2k = grid.arrival.start_days_since_j2k;
+    header.arrival_step_days = grid.arrival.step_days;
+
+    FILE* file = fopen(path, "wb");
+    if (file==NULL){
+        return -1;
+    }
+    const size_t n_cells = grid.departure.n*grid.arrival.n;
+    bool ok = fwrite(&header, sizeof(header), 1, file)==1
+        && fwrite(grid.c3_km2_per_s2.data(), sizeof(float), n_cells, file)==n_cells
+        && fwrite(grid.v_infinity_arrival_km_per_s.data(), sizeof(float), n_cells, file)==n_cells
+        && fwrite(grid.tof_days.data(), sizeof(float), n_cells, file)==n_cells;
+    if (fclose(file)!=0){
+        ok = false;
+    }
+    return ok ? 0 : -1;
+}
+
+// Read a grid written by porkchop_write. Returns 0 on success, -1 if the
+// file cannot be read, was written with the other byte order or another
+// format version, or is truncated.
+inline int porkchop_read(const char* path, porkchop_grid* grid){
+    FILE* file = fopen(path, "rb");
+    if (file==NULL){
+        return -1;
+    }
+    porkchop_file_header header;
+    bool ok = fread(&header, sizeof(header), 1, file)==1
+        && memcmp(header.magic, PORKCHOP_FILE_MAGIC, sizeof(header.magic))==0
+        && header.endian_tag==PORKCHOP_FILE_ENDIAN_TAG
+        && header.version==PORKCHOP_FILE_VERSION;
+    if (ok){
+        grid->departure = {header.departure_start_days_since_j2k, header.departure_step_days, header.n_departures};
+        grid->arrival = {header.arrival_start_days_since_j2k, header.arrival_step_days, header.n_arrivals};
+        const size_t n_cells = (size_t)header.n_departures*header.n_arrivals;
+        grid->c3_km2_per_s2.resize(n_cells);
+        grid->v_infinity_arrival_km_per_s.resize(n_cells);
+        grid->tof_days.resize(n_cells);
+        ok = fread(grid->c3_km2_per_s2.data(), sizeof(float), n_cells, file)==n_cells
+            && fread(grid->v_infinity_arrival_km_per_s.data(), sizeof(float), n_cells, file)==n_cells
+            && fread(grid->tof_days.data(), sizeof(float), n_cells, file)==n_cells;
+    }
+    fclose(file);
+    return ok ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,472 @@
+/*
+Catalogs of asteroids and other small bodies on osculating elliptic
+orbits, loaded from MPC or JPL element files.
+
+Each body is kept as the two-body orbit fixed at its osculating epoch: the
+mean anomaly advances at the mean motion n, and the orbit's orientation
+does not change. The catalog is structure-of-arrays, one 64-byte aligned
+array per quantity, and stores what evaluation needs rather than the raw
+elements: the mean anomaly at J2000, n, a, e and the two in-plane unit
+vectors P (towards the perihelion) and Q in the J2000 ecliptic frame. That
+is 80 bytes of numbers per body plus an 8-byte designation, and evaluating
+the catalog at an epoch is a Kepler solve and a few multiply-adds per body,
+done a block at a time through kepler_simd.h.
+
+Hyperbolic and parabolic orbits (e >= 1) are skipped by the loaders.
+*/
+
+#ifndef SMALL_BODIES_H
+#define SMALL_BODIES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "orbits.h"
+#include "orbits_batch.h"
+#include "kepler_simd.h"
+#include "julian_date.h"
+
+#define SMALL_BODY_ALIGNMENT 64
+#define SMALL_BODY_DESIGNATION_LENGTH 8
+#define SMALL_BODY_LINE_LENGTH 512
+#define SMALL_BODY_GAUSS_K 0.01720209895   // Gaussian gravitational constant, rad/day
+
+typedef struct small_body_catalog {
+    size_t n_bodies;
+    size_t capacity;
+
+    double* mean_anomaly_j2k_rad;   // Mean anomaly at J2000, reduced to [-pi, pi]
+    double* mean_motion_rad_per_day;
+    double* a_au;
+    double* e;
+    double* px;                     // Unit vector towards the perihelion
+    double* py;
+    double* pz;
+    double* qx;                     // Unit vector 90 degrees ahead of P in the orbital plane
+    double* qy;
+    double* qz;
+
+    char (*designations)[SMALL_BODY_DESIGNATION_LENGTH];  // NUL-padded, not terminated
+} small_body_catalog;
+
+SSD_INLINE void* small_body_alloc(const size_t bytes){
+    void* memory = NULL;
+    if (posix_memalign(&memory, SMALL_BODY_ALIGNMENT, bytes>0 ? bytes : SMALL_BODY_ALIGNMENT)!=0){
+        return NULL;
+    }
+    return memory;
+}
+
+SSD_INLINE void small_body_catalog_init(small_body_catalog* catalog){
+    memset(catalog, 0, sizeof(*catalog));
+}
+
+SSD_INLINE void small_body_catalog_free(small_body_catalog* catalog){
+    double** arrays[10] = {&catalog->mean_anomaly_j2k_rad, &catalog->mean_motion_rad_per_day, &catalog->a_au, &catalog->e,
+                           &catalog->px, &catalog->py, &catalog->pz, &catalog->qx, &catalog->qy, &catalog->qz};
+    for (int k=0; k<10; k++){
+        free(*arrays[k]);
+    }
+    free(catalog->designations);
+    memset(catalog, 0, sizeof(*catalog));
+}
+
+// Make room for at least capacity bodies. Returns 0 on success, -1 on
+// allocation failure, in which case the catalog is unchanged.
+SSD_INLINE int small_body_catalog_reserve(small_body_catalog* catalog, const size_t capacity){
+    if (capacity<=catalog->capacity){
+        return 0;
+    }
+    double** arrays[10] = {&catalog->mean_anomaly_j2k_rad, &catalog->mean_motion_rad_per_day, &catalog->a_au, &catalog->e,
+                           &catalog->px, &catalog->py, &catalog->pz, &catalog->qx, &catalog->qy, &catalog->qz};
+    double* grown[10];
+    void* grown_designations = small_body_alloc(capacity*SMALL_BODY_DESIGNATION_LENGTH);
+    int ok = grown_designations!=NULL;
+    for (int k=0; k<10; k++){
+        grown[k] = ok ? (double*)small_body_alloc(capacity*sizeof(double)) : NULL;
+        ok = ok && grown[k]!=NULL;
+    }
+    if (!ok){
+        for (int k=0; k<10; k++){
+            free(grown[k]);
+        }
+        free(grown_designations);
+        return -1;
+    }
+
+    for (int k=0; k<10; k++){
+        if (catalog->n_bodies>0){
+            memcpy(grown[k], *arrays[k], catalog->n_bodies*sizeof(double));
+        }
+        free(*arrays[k]);
+        *arrays[k] = grown[k];
+    }
+    if (catalog->n_bodies>0){
+        memcpy(grown_designations, catalog->designations, catalog->n_bodies*SMALL_BODY_DESIGNATION_LENGTH);
+    }
+    free(catalog->designations);
+    catalog->designations = (char (*)[SMALL_BODY_DESIGNATION_LENGTH])grown_designations;
+    catalog->capacity = capacity;
+    return 0;
+}
+
+// Append a body from its osculating elements in the J2000 ecliptic frame:
+// angles in degrees, the mean anomaly M at the osculating epoch, and the
+// mean motion in degrees per day (0 to derive it from a). Only the first
+// SMALL_BODY_DESIGNATION_LENGTH characters of the designation are kept.
+// Returns 0 on success, -1 for orbits that are not elliptic or on
+// allocation failure.
+SSD_INLINE int small_body_catalog_add(small_body_catalog* catalog, const char* designation, const double epoch_days_since_j2k,
+                           const double a_au, const double e, const double I_deg, const double Omega_deg,
+                           const double argument_of_periapsis_deg, const double mean_anomaly_deg, double mean_motion_deg_per_day){
+    if (!(a_au>0) || !(e>=0 && e<1)){
+        return -1;
+    }
+    if (catalog->n_bodies==catalog->capacity
+        && small_body_catalog_reserve(catalog, catalog->capacity>0 ? 2*catalog->capacity : 1024)!=0){
+        return -1;
+    }
+    const double deg = M_PI/180.;
+    double mean_motion_rad_per_day = mean_motion_deg_per_day>0 ? mean_motion_deg_per_day*deg : SMALL_BODY_GAUSS_K/(a_au*sqrt(a_au));
+    double mean_anomaly_j2k_rad = mean_anomaly_deg*deg - mean_motion_rad_per_day*epoch_days_since_j2k;
+
+    double cos_omega = cos(argument_of_periapsis_deg*deg), sin_omega = sin(argument_of_periapsis_deg*deg);
+    double cos_Omega = cos(Omega_deg*deg), sin_Omega = sin(Omega_deg*deg);
+    double cos_I = cos(I_deg*deg), sin_I = sin(I_deg*deg);
+
+    size_t i = catalog->n_bodies++;
+    catalog->mean_anomaly_j2k_rad[i] = mean_anomaly_j2k_rad - 2*M_PI*nearbyint(mean_anomaly_j2k_rad/(2*M_PI));
+    catalog->mean_motion_rad_per_day[i] = mean_motion_rad_per_day;
+    catalog->a_au[i] = a_au;
+    catalog->e[i] = e;
+    catalog->px[i] = cos_omega*cos_Omega-sin_omega*sin_Omega*cos_I;
+    catalog->py[i] = cos_omega*sin_Omega+sin_omega*cos_Omega*cos_I;
+    catalog->pz[i] = sin_omega*sin_I;
+    catalog->qx[i] = -sin_omega*cos_Omega-cos_omega*sin_Omega*cos_I;
+    catalog->qy[i] = -sin_omega*sin_Omega+cos_omega*cos_Omega*cos_I;
+    catalog->qz[i] = cos_omega*sin_I;
+    memset(catalog->designations[i], 0, SMALL_BODY_DESIGNATION_LENGTH);
+    memcpy(catalog->designations[i], designation, strnlen(designation, SMALL_BODY_DESIGNATION_LENGTH));
+    return 0;
+}
+
+// Number in columns [first, first+length) of line (0-based), or -1 if they
+// do not hold one.
+SSD_INLINE int small_body_field(const char* line, const size_t line_length, const size_t first, const size_t length, double* value){
+    char buffer[32];
+    if (first+length>line_length || length>=sizeof(buffer)){
+        return -1;
+    }
+    memcpy(buffer, line+first, length);
+    buffer[length] = '\0';
+    char* end;
+    *value = strtod(buffer, &end);
+    while (*end==' '){
+        end++;
+    }
+    return end!=buffer && *end=='\0' ? 0 : -1;
+}
+
+// Packed dates such as K2555 (2025-05-05): century letter, two-digit
+// year, month and day as 1-9 then A-V.
+SSD_INLINE int small_body_unpack_epoch(const char* packed, double* days_since_j2k){
+    static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV";
+    if (packed[0]<'A' || packed[0]>'Z' || packed[1]<'0' || packed[1]>'9' || packed[2]<'0' || packed[2]>'9'){
+        return -1;
+    }
+    const char* month = strchr(digits, packed[3]);
+    const char* day = strchr(digits, packed[4]);
+    if (month==NULL || day==NULL || packed[3]=='\0' || packed[4]=='\0'){
+        return -1;
+    }
+    long year = (packed[0]-'A'+10)*100 + (packed[1]-'0')*10 + (packed[2]-'0');
+    int m = (int)(month-digits), d = (int)(day-digits);
+    if (m<1 || m>12 || d<1 || d>days_in_month(year, m)){
+        return -1;
+    }
+    *days_since_j2k = days_since_j2k_from_utc(year, m, d, 0, 0, 0);
+    return 0;
+}
+
+// Parse one line of the MPC's MPCORB.DAT format. Returns 0 and appends the
+// body, or -1 if the line does not hold an elliptic orbit.
+SSD_INLINE int small_body_catalog_add_mpcorb_line(small_body_catalog* catalog, const char* line){
+    size_t length = strlen(line);
+    while (length>0 && (line[length-1]=='\n' || line[length-1]=='\r')){
+        length--;
+    }
+    double epoch, M, omega, Omega, I, e, n, a;
+    if (length<103 || line[25]!=' ' || small_body_unpack_epoch(line+20, &epoch)!=0
+        || small_body_field(line, length, 26, 9, &M)!=0
+        || small_body_field(line, length, 37, 9, &omega)!=0
+        || small_body_field(line, length, 48, 9, &Omega)!=0
+        || small_body_field(line, length, 59, 9, &I)!=0
+        || small_body_field(line, length, 70, 9, &e)!=0
+        || small_body_field(line, length, 80, 11, &n)!=0
+        || small_body_field(line, length, 92, 11, &a)!=0){
+        return -1;
+    }
+    char designation[SMALL_BODY_DESIGNATION_LENGTH+1] = {0};
+    memcpy(designation, line, 7);
+    for (int k=6; k>=0 && designation[k]==' '; k--){
+        designation[k] = '\0';
+    }
+    return small_body_catalog_add(catalog, designation, epoch, a, e, I, Omega, omega, M, n);
+}
+
+// Column of each field of a JPL Small-Body Database CSV export, found from
+// its header line.
+typedef struct small_body_csv_columns {
+    int name, epoch, a, e, i, om, w, ma, n;
+} small_body_csv_columns;
+
+SSD_INLINE int small_body_csv_header(const char* line, small_body_csv_columns* columns){
+    static const char* names[9] = {"pdes", "epoch", "a", "e", "i", "om", "w", "ma", "n"};
+    int* slots[9] = {&columns->name, &columns->epoch, &columns->a, &columns->e, &columns->i, &columns->om, &columns->w, &columns->ma, &columns->n};
+    for (int k=0; k<9; k++){
+        *slots[k] = -1;
+    }
+    int column = 0;
+    for (const char* p=line; ; column++){
+        size_t length = strcspn(p, ",\r\n");
+        const char* field = p;
+        size_t field_length = length;
+        if (field_length>=2 && field[0]=='"' && field[field_length-1]=='"'){
+            field++;
+            field_length -= 2;
+        }
+        for (int k=0; k<9; k++){
+            if (strlen(names[k])==field_length && strncmp(names[k], field, field_length)==0){
+                *slots[k] = column;
+            }
+        }
+        if (field_length==9 && strncmp(field, "full_name", 9)==0 && columns->name<0){
+            columns->name = column;
+        }
+        if (p[length]!=','){
+            break;
+        }
+        p += length+1;
+    }
+    // Everything but the name and the mean motion is required
+    return columns->epoch>=0 && columns->a>=0 && columns->e>=0 && columns->i>=0
+        && columns->om>=0 && columns->w>=0 && columns->ma>=0 ? 0 : -1;
+}
+
+// Parse one data line of a JPL Small-Body Database CSV export. epoch is a
+// Julian date. Returns 0 and appends the body, or -1 if the line does not
+// hold an elliptic orbit.
+SSD_INLINE int small_body_catalog_add_csv_line(small_body_catalog* catalog, const small_body_csv_columns* columns, const char* line){
+    double values[8];
+    int wanted[8] = {columns->epoch, columns->a, columns->e, columns->i, columns->om, columns->w, columns->ma, columns->n};
+    char designation[SMALL_BODY_DESIGNATION_LENGTH+1] = {0};
+    int found = 0;
+    values[7] = 0;
+
+    int column = 0;
+    for (const char* p=line; ; column++){
+        size_t length = strcspn(p, ",\r\n");
+        const char* field = p;
+        size_t field_length = length;
+        if (field_length>=2 && field[0]=='"' && field[field_length-1]=='"'){
+            field++;
+            field_length -= 2;
+        }
+        if (column==columns->name){
+            while (field_length>0 && *field==' '){
+                field++;
+                field_length--;
+            }
+            memcpy(designation, field, field_length<SMALL_BODY_DESIGNATION_LENGTH ? field_length : SMALL_BODY_DESIGNATION_LENGTH);
+        }
+        for (int k=0; k<8; k++){
+            if (column==wanted[k]){
+                if (field_length==0 && k==7){
+                    continue; // Mean motion left empty
+                }
+                if (small_body_field(field, field_length, 0, field_length, &values[k])!=0){
+                    return -1;
+                }
+                found |= 1<<k;
+            }
+        }
+        if (p[length]!=','){
+            break;
+        }
+        p += length+1;
+    }
+    if ((found & 0x7f)!=0x7f){
+        return -1;
+    }
+    return small_body_catalog_add(catalog, designation, values[0]-J2000_JULIAN_DATE, values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+}
+
+// Stream an element file into the catalog, appending to what is there. A
+// first line with commas is taken as the header of a JPL Small-Body
+// Database CSV export (fields pdes or full_name, epoch, a, e, i, om, w,
+// ma and optionally n); anything else as MPCORB.DAT, whose header lines
+// are skipped. The number of data lines that could not be used is stored
+// in *n_skipped if it is not NULL. Returns 0 on success, -1 if the file
+// cannot be read or on allocation failure.
+SSD_INLINE int small_body_catalog_load(const char* path, small_body_catalog* catalog, size_t* n_skipped){
+    FILE* file = fopen(path, "r");
+    if (file==NULL){
+        return -1;
+    }
+    char line[SMALL_BODY_LINE_LENGTH];
+    size_t skipped = 0;
+    int csv = -1;
+    int mpcorb_data = 0; // Past the dashed line ending the MPCORB header
+    small_body_csv_columns columns;
+    int status = 0;
+
+    while (fgets(line, sizeof(line), file)!=NULL){
+        if (strchr(line, '\n')==NULL && !feof(file)){
+            // Longer than any element record: drop the rest of it
+            int c;
+            while ((c = fgetc(file))!=EOF && c!='\n'){}
+            skipped++;
+            continue;
+        }
+        if (csv<0){
+            csv = strchr(line, ',')!=NULL;
+            if (csv){
+                if (small_body_csv_header(line, &columns)!=0){
+                    status = -1;
+                    break;
+                }
+                continue;
+            }
+        }
+        if (line[strspn(line, " \r\n")]=='\0'){
+            continue;
+        }
+        if (catalog->n_bodies==catalog->capacity
+            && small_body_catalog_reserve(catalog, catalog->capacity>0 ? 2*catalog->capacity : 1024)!=0){
+            status = -1;
+            break;
+        }
+        if (csv){
+            if (small_body_catalog_add_csv_line(catalog, &columns, line)!=0){
+                skipped++;
+            }
+        } else if (strncmp(line, "-----", 5)==0){
+            mpcorb_data = 1;
+        } else if (small_body_catalog_add_mpcorb_line(catalog, line)!=0){
+            // Lines before the dashes are the file's preamble
+            skipped += mpcorb_data;
+        }
+    }
+    if (ferror(file)){
+        status = -1;
+    }
+    fclose(file);
+    if (n_skipped!=NULL){
+        *n_skipped = skipped;
+    }
+    return status;
+}
+
+// Positions (AU) and, if vx_ecl_au_per_day is not NULL, velocities (AU/day)
+// in the J2000 ecliptic frame of bodies [first, end) at one epoch, written
+// to x_ecl_au[i-first] and so on.
+SSD_INLINE void small_body_catalog_states_in_j2k_ecliptic_frame(const small_body_catalog* catalog, const size_t first, const size_t end, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au, double* vx_ecl_au_per_day, double* vy_ecl_au_per_day, double* vz_ecl_au_per_day){
+    double M[ORBITS_BATCH_BLOCK], E[ORBITS_BATCH_BLOCK], sin_E[ORBITS_BATCH_BLOCK], cos_E[ORBITS_BATCH_BLOCK];
+    for (size_t block=first; block<end; block+=ORBITS_BATCH_BLOCK){
+        const size_t n = end-block<ORBITS_BATCH_BLOCK ? end-block : ORBITS_BATCH_BLOCK;
+        const double* M0 = catalog->mean_anomaly_j2k_rad + block;
+        const double* mean_motion = catalog->mean_motion_rad_per_day + block;
+        for (size_t k=0; k<n; k++){
+            double mean_anomaly_rad = M0[k] + mean_motion[k]*days_since_j2k;
+            M[k] = mean_anomaly_rad - 2*M_PI*nearbyint(mean_anomaly_rad*(0.5/M_PI));
+        }
+        SOLVER_STATS_BODY(0);
+        kepler_solve_sincos_batch(M, catalog->e+block, E, sin_E, cos_E, n);
+
+        const double* a = catalog->a_au + block;
+        const double* e = catalog->e + block;
+        double* x = x_ecl_au + (block-first);
+        double* y = y_ecl_au + (block-first);
+        double* z = z_ecl_au + (block-first);
+        for (size_t k=0; k<n; k++){
+            double x_orbital_au = a[k]*(cos_E[k]-e[k]);
+            double y_orbital_au = a[k]*sqrt(1-e[k]*e[k])*sin_E[k];
+            x[k] = catalog->px[block+k]*x_orbital_au + catalog->qx[block+k]*y_orbital_au;
+            y[k] = catalog->py[block+k]*x_orbital_au + catalog->qy[block+k]*y_orbital_au;
+            z[k] = catalog->pz[block+k]*x_orbital_au + catalog->qz[block+k]*y_orbital_au;
+        }
+        if (vx_ecl_au_per_day==NULL){
+            continue;
+        }
+        double* vx = vx_ecl_au_per_day + (block-first);
+        double* vy = vy_ecl_au_per_day + (block-first);
+        double* vz = vz_ecl_au_per_day + (block-first);
+        for (size_t k=0; k<n; k++){
+            double Edot = mean_motion[k]/(1-e[k]*cos_E[k]);
+            double vx_orbital = -a[k]*sin_E[k]*Edot;
+            double vy_orbital = a[k]*sqrt(1-e[k]*e[k])*cos_E[k]*Edot;
+            vx[k] = catalog->px[block+k]*vx_orbital + catalog->qx[block+k]*vy_orbital;
+            vy[k] = catalog->py[block+k]*vx_orbital + catalog->qy[block+k]*vy_orbital;
+            vz[k] = catalog->pz[block+k]*vx_orbital + catalog->qz[block+k]*vy_orbital;
+        }
+    }
+}
+
+// Positions in the J2000 ecliptic frame of bodies [first, end) at one
+// epoch, written to x_ecl_au[i-first] and so on.
+SSD_INLINE void small_body_catalog_xyz_in_j2k_ecliptic_frame(const small_body_catalog* catalog, const size_t first, const size_t end, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au){
+    small_body_catalog_states_in_j2k_ecliptic_frame(catalog, first, end, days_since_j2k, x_ecl_au, y_ecl_au, z_ecl_au, NULL, NULL, NULL);
+}
+
+// Position (AU) and velocity (AU/day) of body i in the J2000 ecliptic frame
+// at one epoch.
+SSD_INLINE void small_body_catalog_state_in_j2k_ecliptic_frame(const small_body_catalog* catalog, const size_t i, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au, double* vx_ecl_au_per_day, double* vy_ecl_au_per_day, double* vz_ecl_au_per_day){
+    double n = catalog->mean_motion_rad_per_day[i];
+    double a = catalog->a_au[i], e = catalog->e[i];
+    double mean_anomaly_rad = catalog->mean_anomaly_j2k_rad[i] + n*days_since_j2k;
+    mean_anomaly_rad -= 2*M_PI*nearbyint(mean_anomaly_rad*(0.5/M_PI));
+    SOLVER_STATS_BODY(0);
+    double E = kepler_solve(mean_anomaly_rad, e);
+    double sin_E = sin(E), cos_E = cos(E);
+    double sqrt_one_minus_e2 = sqrt(1-e*e);
+
+    double x_orbital_au = a*(cos_E-e);
+    double y_orbital_au = a*sqrt_one_minus_e2*sin_E;
+    double Edot = n/(1-e*cos_E);
+    double vx_orbital = -a*sin_E*Edot;
+    double vy_orbital = a*sqrt_one_minus_e2*cos_E*Edot;
+
+    *x_ecl_au = catalog->px[i]*x_orbital_au + catalog->qx[i]*y_orbital_au;
+    *y_ecl_au = catalog->py[i]*x_orbital_au + catalog->qy[i]*y_orbital_au;
+    *z_ecl_au = catalog->pz[i]*x_orbital_au + catalog->qz[i]*y_orbital_au;
+    *vx_ecl_au_per_day = catalog->px[i]*vx_orbital + catalog->qx[i]*vy_orbital;
+    *vy_ecl_au_per_day = catalog->py[i]*vx_orbital + catalog->qy[i]*vy_orbital;
+    *vz_ecl_au_per_day = catalog->pz[i]*vx_orbital + catalog->qz[i]*vy_orbital;
+}
+
+// Largest heliocentric speed (AU/day) of body i, reached at the perihelion.
+SSD_INLINE double small_body_max_speed_au_per_day(const small_body_catalog* catalog, const size_t i){
+    double e = catalog->e[i];
+    return catalog->mean_motion_rad_per_day[i]*catalog->a_au[i]*sqrt((1+e)/(1-e));
+}
+
+// Largest acceleration (AU/day^2) of body i, GM/r^2 at the perihelion with
+// GM = n^2 a^3.
+SSD_INLINE double small_body_max_acceleration_au_per_day2(const small_body_catalog* catalog, const size_t i){
+    double n = catalog->mean_motion_rad_per_day[i];
+    double one_minus_e = 1-catalog->e[i];
+    return n*n*catalog->a_au[i]/(one_minus_e*one_minus_e);
+}
+
+// Positions in the ICRF frame of bodies [first, end) at one epoch.
+SSD_INLINE void small_body_catalog_xyz_in_icrf_frame(const small_body_catalog* catalog, const size_t first, const size_t end, const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    small_body_catalog_xyz_in_j2k_ecliptic_frame(catalog, first, end, days_since_j2k, x_eq_au, y_eq_au, z_eq_au);
+    const double cos_obliquity = COS_OBLIQUITY_J2K, sin_obliquity = SIN_OBLIQUITY_J2K;
+    for (size_t k=0; k<end-first; k++){
+        double y_ecl_au = y_eq_au[k], z_ecl_au = z_eq_au[k];
+        y_eq_au[k] = cos_obliquity*y_ecl_au - sin_obliquity*z_ecl_au;
+        z_eq_au[k] = sin_obliquity*y_ecl_au + cos_obliquity*z_ecl_au;
+    }
+}
+
+#endif
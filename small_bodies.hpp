@@ -0,0 +1,40 @@
+/*
+Whole-catalog evaluation of small_bodies.h spread over a thread_pool.
+
+The catalog is cut into runs of SMALL_BODY_BODIES_PER_TASK bodies, each
+evaluated by the single-threaded range functions into its own slice of the
+output, so the result is the same whatever the number of threads.
+*/
+
+#ifndef SMALL_BODIES_HPP
+#define SMALL_BODIES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include "small_bodies.h"
+#include "thread_pool.hpp"
+
+#define SMALL_BODY_BODIES_PER_TASK 8192
+
+// Positions in the J2000 ecliptic frame of every body of the catalog at one
+// epoch; each output array holds catalog->n_bodies doubles.
+inline void small_body_catalog_xyz_in_j2k_ecliptic_frame(const small_body_catalog* catalog, const double days_since_j2k, double* x_ecl_au, double* y_ecl_au, double* z_ecl_au, thread_pool& pool){
+    const size_t n_tasks = (catalog->n_bodies+SMALL_BODY_BODIES_PER_TASK-1)/SMALL_BODY_BODIES_PER_TASK;
+    pool.run(n_tasks, [&](size_t task){
+        size_t first = task*SMALL_BODY_BODIES_PER_TASK;
+        size_t end = std::min<size_t>(first+SMALL_BODY_BODIES_PER_TASK, catalog->n_bodies);
+        small_body_catalog_xyz_in_j2k_ecliptic_frame(catalog, first, end, days_since_j2k, x_ecl_au+first, y_ecl_au+first, z_ecl_au+first);
+    });
+}
+
+// Positions in the ICRF frame of every body of the catalog at one epoch.
+inline void small_body_catalog_xyz_in_icrf_frame(const small_body_catalog* catalog, const double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au, thread_pool& pool){
+    const size_t n_tasks = (catalog->n_bodies+SMALL_BODY_BODIES_PER_TASK-1)/SMALL_BODY_BODIES_PER_TASK;
+    pool.run(n_tasks, [&](size_t task){
+        size_t first = task*SMALL_BODY_BODIES_PER_TASK;
+        size_t end = std::min<size_t>(first+SMALL_BODY_BODIES_PER_TASK, catalog->n_bodies);
+        small_body_catalog_xyz_in_icrf_frame(catalog, first, end, days_since_j2k, x_eq_au+first, y_eq_au+first, z_eq_au+first);
+    });
+}
+
+#endif
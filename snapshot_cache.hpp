@@ -0,0 +1,188 @@
+/*
+Whole solar system snapshots, cached and computed in batches, for the
+ephemeris daemon.
+
+An ephemeris_snapshot holds everything the daemon serves about the eight
+planets at one epoch. snapshot_cache hands them out by epoch, rounded to a
+quantum so that nearby requests share one snapshot:
+
+- Snapshots already computed come from an LRU cache of the most recent
+  capacity epochs.
+- Requests for an epoch that is being computed wait for that computation
+  instead of starting their own.
+- Misses are computed in batches. The first thread to miss evaluates every
+  epoch missing at that moment in one call of the batch functions of
+  orbits_batch.h; threads missing while it works queue their epochs for
+  the next batch, which one of them then evaluates. No thread waits on a
+  timer, so a lone request costs one single-epoch batch.
+*/
+
+#ifndef SNAPSHOT_CACHE_HPP
+#define SNAPSHOT_CACHE_HPP
+
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "planets.h"
+#include "orbits.h"
+#include "orbits_batch.h"
+
+struct ephemeris_snapshot {
+    double days_since_j2k;
+    double xyz_icrf_au[8][3];               // Mercury to Neptune
+    double xyz_j2k_ecliptic_au[8][3];
+    double longitude_rad[8];
+};
+
+struct snapshot_cache_stats {
+    uint64_t hits;                          // Served from the cache
+    uint64_t coalesced;                     // Waited for another request's batch
+    uint64_t misses;                        // Queued their epoch for a batch
+    uint64_t batches;                       // Batch evaluations
+    uint64_t evictions;
+};
+
+// Snapshots of the eight planets at n epochs.
+inline void compute_snapshots(const double* days_since_j2k, const size_t n, ephemeris_snapshot* snapshots){
+    const keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    std::vector<double> values(4*8*n);
+    double* x[8]; double* y[8]; double* z[8]; double* longitude[8];
+    for (int p=0; p<8; p++){
+        x[p] = &values[(4*p)*n];
+        y[p] = &values[(4*p+1)*n];
+        z[p] = &values[(4*p+2)*n];
+        longitude[p] = &values[(4*p+3)*n];
+    }
+    xyz_in_j2k_ecliptic_frame_batch(planets, 8, days_since_j2k, n, x, y, z);
+    longitude_at_date_batch(planets, 8, days_since_j2k, n, longitude);
+    for (size_t k=0; k<n; k++){
+        ephemeris_snapshot& snapshot = snapshots[k];
+        snapshot.days_since_j2k = days_since_j2k[k];
+        for (int p=0; p<8; p++){
+            double x_ecl_au = x[p][k], y_ecl_au = y[p][k], z_ecl_au = z[p][k];
+            snapshot.xyz_j2k_ecliptic_au[p][0] = x_ecl_au;
+            snapshot.xyz_j2k_ecliptic_au[p][1] = y_ecl_au;
+            snapshot.xyz_j2k_ecliptic_au[p][2] = z_ecl_au;
+            snapshot.xyz_icrf_au[p][0] = x_ecl_au;
+            snapshot.xyz_icrf_au[p][1] = COS_OBLIQUITY_J2K*y_ecl_au - SIN_OBLIQUITY_J2K*z_ecl_au;
+            snapshot.xyz_icrf_au[p][2] = SIN_OBLIQUITY_J2K*y_ecl_au + COS_OBLIQUITY_J2K*z_ecl_au;
+            snapshot.longitude_rad[p] = longitude[p][k];
+        }
+    }
+}
+
+class snapshot_cache {
+public:
+    // Keeps the snapshots of the last capacity epochs used, at least one.
+    // Epochs are rounded to multiples of quantum_days.
+    snapshot_cache(size_t capacity, double quantum_days)
+        : capacity(capacity>0 ? capacity : 1), quantum_days(quantum_days) {}
+
+    snapshot_cache(const snapshot_cache&) = delete;
+    snapshot_cache& operator=(const snapshot_cache&) = delete;
+
+    // The epoch a request for days_since_j2k is answered for.
+    double quantize(const double days_since_j2k) const {
+        return key_of(days_since_j2k)*quantum_days;
+    }
+
+    // Snapshot at days_since_j2k rounded to the quantum, copied to *snapshot.
+    void get(const double days_since_j2k, ephemeris_snapshot* snapshot){
+        const int64_t key = key_of(days_since_j2k);
+        std::unique_lock<std::mutex> lock(mutex);
+        auto found = entries.find(key);
+        if (found==entries.end()){
+            stats.misses++;
+        } else if (found->second.ready){
+            stats.hits++;
+        } else {
+            stats.coalesced++;
+        }
+        while (true){
+            found = entries.find(key);
+            if (found!=entries.end() && found->second.ready){
+                lru.splice(lru.begin(), lru, found->second.lru_position);
+                *snapshot = found->second.snapshot;
+                return;
+            }
+            // Queued again if evicted before this thread could read it
+            if (found==entries.end()){
+                entries[key].ready = false;
+                pending.push_back(key);
+            }
+            if (!evaluating){
+                evaluate_pending(lock);
+            } else {
+                batch_done.wait(lock);
+            }
+        }
+    }
+
+    snapshot_cache_stats statistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    struct entry {
+        ephemeris_snapshot snapshot;
+        bool ready;                         // Else pending
+        std::list<int64_t>::iterator lru_position;
+    };
+
+    int64_t key_of(const double days_since_j2k) const {
+        return (int64_t)std::llround(days_since_j2k/quantum_days);
+    }
+
+    // Compute every pending epoch in one batch with the lock released, then
+    // publish them and evict the least recently used down to the capacity.
+    void evaluate_pending(std::unique_lock<std::mutex>& lock){
+        evaluating = true;
+        std::vector<int64_t> keys;
+        keys.swap(pending);
+        lock.unlock();
+
+        std::vector<double> days(keys.size());
+        for (size_t k=0; k<keys.size(); k++){
+            days[k] = keys[k]*quantum_days;
+        }
+        std::vector<ephemeris_snapshot> snapshots(keys.size());
+        compute_snapshots(days.data(), days.size(), snapshots.data());
+
+        lock.lock();
+        for (size_t k=0; k<keys.size(); k++){
+            entry& computed = entries[keys[k]];
+            computed.snapshot = snapshots[k];
+            computed.ready = true;
+            lru.push_front(keys[k]);
+            computed.lru_position = lru.begin();
+        }
+        // A batch larger than the capacity is kept whole until the next
+        while (lru.size()>capacity && lru.size()>keys.size()){
+            entries.erase(lru.back());
+            lru.pop_back();
+            stats.evictions++;
+        }
+        stats.batches++;
+        evaluating = false;
+        batch_done.notify_all();
+    }
+
+    const size_t capacity;
+    const double quantum_days;
+
+    mutable std::mutex mutex;
+    std::condition_variable batch_done;
+    std::unordered_map<int64_t, entry> entries; // Ready and pending epochs
+    std::list<int64_t> lru;                     // Ready epochs, most recent first
+    std::vector<int64_t> pending;               // Epochs for the next batch
+    bool evaluating = false;
+    snapshot_cache_stats stats = {0, 0, 0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*
+Opt-in counters for the Kepler solvers.
+
+Compiled in only when SSD_SOLVER_STATS is defined; otherwise the
+SOLVER_STATS_* hooks expand to nothing and solver_stats_collect returns -1.
+
+Each thread counts into its own solver_stats block, allocated on the
+thread's first count and linked into a global list, so counting takes no
+lock. Blocks are never freed: the counts of threads that have exited (a
+finished thread_pool, say) are still part of the totals.
+solver_stats_collect sums every block. It reads the counters without
+synchronization, so call it (and solver_stats_reset) once the solves to
+be counted are done, e.g. after thread_pool::run has returned.
+
+What is counted:
+- calls to each entry point of orbits.h. Entry points that go through
+  another one count for both, e.g. longitude_at_date also counts an
+  orbital_state_at_date call;
+- for every solve of Kepler's equation (kepler_solve, the SIMD kernel, the
+  stepper and kepler_solvers.h), the iterations, whether it converged and
+  the final residual |E - e sin(E) - M|;
+- the iterations by eccentricity, in a histogram, and by body. Bodies are
+  told apart by their J2000 semi-major axis; solves of the small-body
+  catalog, and any past SOLVER_STATS_MAX_BODIES bodies, are unattributed.
+*/
+
+#ifndef SOLVER_STATS_H
+#define SOLVER_STATS_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssd_linkage.h"
+
+#define SOLVER_STATS_MAX_ITERATIONS 16      // Histogram bins; the last one holds every longer solve
+#define SOLVER_STATS_ECCENTRICITY_BINS 10   // Of width 0.1
+#define SOLVER_STATS_RESIDUAL_DECADES 18    // [1e-1, inf), [1e-2, 1e-1), ..., [0, 1e-17)
+#define SOLVER_STATS_MAX_BODIES 15          // Bodies counted separately, plus one unattributed slot
+
+typedef enum solver_stats_entry {
+    SOLVER_STATS_KEPLER_SOLVE = 0,
+    SOLVER_STATS_MEAN_ANOMALY_AT_DATE,
+    SOLVER_STATS_ECCENTRIC_ANOMALY_AT_DATE,
+    SOLVER_STATS_ORBITAL_STATE_AT_DATE,
+    SOLVER_STATS_TRUE_ANOMALY_AT_DATE,
+    SOLVER_STATS_LONGITUDE_AT_DATE,
+    SOLVER_STATS_XY_IN_ORBITAL_PLANE,
+    SOLVER_STATS_XYZ_IN_J2K_ECLIPTIC_FRAME,
+    SOLVER_STATS_XYZ_IN_ICRF_FRAME,
+    SOLVER_STATS_N_ENTRIES
+} solver_stats_entry;
+
+typedef struct solver_stats_body {
+    double a_au;                    // J2000 semi-major axis; 0 for the unattributed slot
+    long solves;
+    long iterations;
+    long max_iterations;
+    long non_converged;
+} solver_stats_body;
+
+typedef struct solver_stats {
+    long calls[SOLVER_STATS_N_ENTRIES];
+
+    long solves;
+    long iterations;
+    long non_converged;             // Stopped at MAX_NEWTON_ITERATIONS
+    // Solves by eccentricity bin and number of Newton iterations
+    long iterations_histogram[SOLVER_STATS_ECCENTRICITY_BINS][SOLVER_STATS_MAX_ITERATIONS+1];
+    // Solves by decade of the final residual
+    long residual_histogram[SOLVER_STATS_RESIDUAL_DECADES];
+    double max_residual_rad;
+
+    // Slot 0 is the unattributed one
+    solver_stats_body bodies[SOLVER_STATS_MAX_BODIES+1];
+    int n_bodies;                   // Slots in use, including slot 0
+
+    int current_body;               // Slot the next solves are counted in
+    struct solver_stats* next;      // Registry of the threads' blocks
+} solver_stats;
+
+#ifdef SSD_SOLVER_STATS
+
+#ifndef __GNUC__
+#error "SSD_SOLVER_STATS needs the GCC/Clang __atomic builtins"
+#endif
+
+#ifdef __cplusplus
+#define SOLVER_STATS_THREAD_LOCAL thread_local
+#else
+#define SOLVER_STATS_THREAD_LOCAL __thread
+#endif
+
+// Weak, so that every translation unit shares one list
+__attribute__((weak)) solver_stats* solver_stats_registry = NULL;
+
+// This thread's block, created and registered on first use. The pointer is
+// a static of this SSD_INLINE function, so in C++ it is one object for the
+// whole program.
+SSD_INLINE solver_stats* solver_stats_thread(void){
+    static SOLVER_STATS_THREAD_LOCAL solver_stats* solver_stats_local = NULL;
+    if (solver_stats_local==NULL){
+        solver_stats* stats = (solver_stats*)calloc(1, sizeof(solver_stats));
+        if (stats==NULL){
+            abort();
+        }
+        stats->n_bodies = 1;
+        stats->next = __atomic_load_n(&solver_stats_registry, __ATOMIC_ACQUIRE);
+        while (!__atomic_compare_exchange_n(&solver_stats_registry, &stats->next, stats, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+        }
+        solver_stats_local = stats;
+    }
+    return solver_stats_local;
+}
+
+SSD_INLINE void solver_stats_count_call(const solver_stats_entry entry){
+    solver_stats_thread()->calls[entry]++;
+}
+
+// Count the following solves of this thread for the body with this J2000
+// semi-major axis, or as unattributed if a_au is 0.
+SSD_INLINE void solver_stats_set_body(const double a_au){
+    solver_stats* stats = solver_stats_thread();
+    int slot = 0;
+    if (a_au!=0){
+        for (slot=1; slot<stats->n_bodies && stats->bodies[slot].a_au!=a_au; slot++){
+        }
+        if (slot==stats->n_bodies){
+            if (slot>SOLVER_STATS_MAX_BODIES){
+                slot = 0;
+            } else {
+                stats->bodies[slot].a_au = a_au;
+                stats->n_bodies++;
+            }
+        }
+    }
+    stats->current_body = slot;
+}
+
+SSD_INLINE void solver_stats_record_solve(const double e, const int n_iterations, const int converged, const double residual_rad){
+    solver_stats* stats = solver_stats_thread();
+    double abs_residual = fabs(residual_rad);
+    stats->solves++;
+    stats->iterations += n_iterations;
+    stats->non_converged += !converged;
+
+    int e_bin = (int)(e*SOLVER_STATS_ECCENTRICITY_BINS);
+    e_bin = e_bin<0 ? 0 : (e_bin>=SOLVER_STATS_ECCENTRICITY_BINS ? SOLVER_STATS_ECCENTRICITY_BINS-1 : e_bin);
+    stats->iterations_histogram[e_bin][n_iterations<SOLVER_STATS_MAX_ITERATIONS ? n_iterations : SOLVER_STATS_MAX_ITERATIONS]++;
+
+    int decade = abs_residual>0 ? (int)floor(-log10(abs_residual)) : SOLVER_STATS_RESIDUAL_DECADES;
+    decade = decade<0 ? 0 : (decade>=SOLVER_STATS_RESIDUAL_DECADES ? SOLVER_STATS_RESIDUAL_DECADES-1 : decade);
+    stats->residual_histogram[decade]++;
+    if (abs_residual>stats->max_residual_rad){
+        stats->max_residual_rad = abs_residual;
+    }
+
+    solver_stats_body* body = &stats->bodies[stats->current_body];
+    body->solves++;
+    body->iterations += n_iterations;
+    body->non_converged += !converged;
+    if (n_iterations>body->max_iterations){
+        body->max_iterations = n_iterations;
+    }
+}
+
+#define SOLVER_STATS_CALL(entry) solver_stats_count_call(entry)
+#define SOLVER_STATS_BODY(a_au) solver_stats_set_body(a_au)
+#define SOLVER_STATS_SOLVE(e, n_iterations, converged, residual_rad) solver_stats_record_solve(e, n_iterations, converged, residual_rad)
+
+#else
+
+#define SOLVER_STATS_CALL(entry) ((void)0)
+#define SOLVER_STATS_BODY(a_au) ((void)0)
+#define SOLVER_STATS_SOLVE(e, n_iterations, converged, residual_rad) ((void)0)
+
+#endif // SSD_SOLVER_STATS
+
+// Sum of the counts of every thread into *total. Returns -1, with *total
+// zeroed, if the counters are compiled out.
+SSD_INLINE int solver_stats_collect(solver_stats* total){
+    memset(total, 0, sizeof(*total));
+    total->n_bodies = 1;
+#ifdef SSD_SOLVER_STATS
+    for (const solver_stats* stats=__atomic_load_n(&solver_stats_registry, __ATOMIC_ACQUIRE); stats!=NULL; stats=stats->next){
+        for (int k=0; k<SOLVER_STATS_N_ENTRIES; k++){
+            total->calls[k] += stats->calls[k];
+        }
+        total->solves += stats->solves;
+        total->iterations += stats->iterations;
+        total->non_converged += stats->non_converged;
+        for (int b=0; b<SOLVER_STATS_ECCENTRICITY_BINS; b++){
+            for (int k=0; k<=SOLVER_STATS_MAX_ITERATIONS; k++){
+                total->iterations_histogram[b][k] += stats->iterations_histogram[b][k];
+            }
+        }
+        for (int k=0; k<SOLVER_STATS_RESIDUAL_DECADES; k++){
+            total->residual_histogram[k] += stats->residual_histogram[k];
+        }
+        if (stats->max_residual_rad>total->max_residual_rad){
+            total->max_residual_rad = stats->max_residual_rad;
+        }
+        // Threads number their bodies in the order they first saw them
+        for (int slot=0; slot<stats->n_bodies; slot++){
+            const solver_stats_body* body = &stats->bodies[slot];
+            int t = 0;
+            if (slot>0){
+                for (t=1; t<total->n_bodies && total->bodies[t].a_au!=body->a_au; t++){
+                }
+                if (t==total->n_bodies){
+                    if (t>SOLVER_STATS_MAX_BODIES){
+                        t = 0;
+                    } else {
+                        total->bodies[t].a_au = body->a_au;
+                        total->n_bodies++;
+                    }
+                }
+            }
+            total->bodies[t].solves += body->solves;
+            total->bodies[t].iterations += body->iterations;
+            total->bodies[t].non_converged += body->non_converged;
+            if (body->max_iterations>total->bodies[t].max_iterations){
+                total->bodies[t].max_iterations = body->max_iterations;
+            }
+        }
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+// Zero the counts of every thread.
+SSD_INLINE void solver_stats_reset(void){
+#ifdef SSD_SOLVER_STATS
+    for (solver_stats* stats=__atomic_load_n(&solver_stats_registry, __ATOMIC_ACQUIRE); stats!=NULL; stats=stats->next){
+        solver_stats* next = stats->next;
+        memset(stats, 0, sizeof(*stats));
+        stats->n_bodies = 1;
+        stats->next = next;
+    }
+#endif
+}
+
+SSD_INLINE void solver_stats_print(FILE* file, const solver_stats* stats){
+    static const char* entry_names[SOLVER_STATS_N_ENTRIES] = {
+        "kepler_solve", "mean_anomaly_at_date", "eccentric_anomaly_at_date", "orbital_state_at_date",
+        "true_anomaly_at_date", "longitude_at_date", "xy_in_orbital_plane",
+        "xyz_in_j2k_ecliptic_frame", "xyz_in_icrf_frame"
+    };
+    fprintf(file, "Calls:\n");
+    for (int k=0; k<SOLVER_STATS_N_ENTRIES; k++){
+        fprintf(file, "  %-28s %ld\n", entry_names[k], stats->calls[k]);
+    }
+    fprintf(file, "Solves: %ld, %.3f Newton iterations each, %ld not converged, largest residual %.3g rad\n",
+            stats->solves, stats->solves>0 ? (double)stats->iterations/stats->solves : 0., stats->non_converged, stats->max_residual_rad);
+
+    fprintf(file, "Solves by eccentricity and iterations (last column: %d or more):\n  e       ", SOLVER_STATS_MAX_ITERATIONS);
+    for (int k=0; k<=SOLVER_STATS_MAX_ITERATIONS; k++){
+        fprintf(file, " %8d", k);
+    }
+    fprintf(file, "\n");
+    for (int b=0; b<SOLVER_STATS_ECCENTRICITY_BINS; b++){
+        long row = 0;
+        for (int k=0; k<=SOLVER_STATS_MAX_ITERATIONS; k++){
+            row += stats->iterations_histogram[b][k];
+        }
+        if (row==0){
+            continue;
+        }
+        fprintf(file, "  %.1f-%.1f ", (double)b/SOLVER_STATS_ECCENTRICITY_BINS, (double)(b+1)/SOLVER_STATS_ECCENTRICITY_BINS);
+        for (int k=0; k<=SOLVER_STATS_MAX_ITERATIONS; k++){
+            fprintf(file, " %8ld", stats->iterations_histogram[b][k]);
+        }
+        fprintf(file, "\n");
+    }
+
+    fprintf(file, "Solves by final residual (rad):\n");
+    for (int k=0; k<SOLVER_STATS_RESIDUAL_DECADES; k++){
+        if (stats->residual_histogram[k]==0){
+            continue;
+        }
+        if (k+1==SOLVER_STATS_RESIDUAL_DECADES){
+            fprintf(file, "  below 1e-%d: %ld\n", k, stats->residual_histogram[k]);
+        } else {
+            fprintf(file, "  1e-%d and up: %ld\n", k+1, stats->residual_histogram[k]);
+        }
+    }
+
+    fprintf(file, "Solves by body:\n");
+    for (int slot=0; slot<stats->n_bodies; slot++){
+        const solver_stats_body* body = &stats->bodies[slot];
+        if (body->solves==0){
+            continue;
+        }
+        if (slot==0){
+            fprintf(file, "  %-12s", "unattributed");
+        } else {
+            fprintf(file, "  a=%-10.6g", body->a_au);
+        }
+        fprintf(file, " %ld solves, %.3f iterations each, at most %ld, %ld not converged\n",
+                body->solves, (double)body->iterations/body->solves, body->max_iterations, body->non_converged);
+    }
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+Linkage of what the headers define, so that they can be included from any
+number of translation units of one program.
+
+SSD_INLINE functions are static inline in C, each translation unit keeping
+its own copy, and inline in C++, with one definition program-wide. The
+helpers they call are SSD_INLINE too, never static inline: an inline
+function referring to internal-linkage functions or data would differ
+between translation units, which breaks the one-definition rule.
+SSD_CONSTANT data is static const in C and constexpr in C++, so it can
+also be used in constant expressions and as a template argument.
+*/
+
+#ifndef SSD_LINKAGE_H
+#define SSD_LINKAGE_H
+
+#ifdef __cplusplus
+#define SSD_INLINE inline
+#if __cplusplus>=201703L
+#define SSD_CONSTANT inline constexpr
+#else
+#define SSD_CONSTANT constexpr
+#endif
+#else
+#define SSD_INLINE static inline
+#define SSD_CONSTANT static const
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+/*
+Buffered, allocation-free I/O for streaming many epochs through the
+ephemeris, as the Planets command does.
+
+- line_reader splits a FILE into lines through one caller-provided buffer,
+  reading it in large blocks and handing out pointers into it.
+- parse_epoch reads one epoch as a number of days since J2000, a Julian
+  date or an ISO-8601 timestamp.
+- stream_writer collects output in one caller-provided buffer and writes
+  it out a buffer at a time. format_fixed and store_le_f64 format straight
+  into it, with no allocation and no locale.
+*/
+
+#ifndef STREAM_IO_H
+#define STREAM_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "ssd_linkage.h"
+#include "julian_date.h"
+
+#define STREAM_FIXED_MAX_DECIMALS 17
+#define STREAM_FIXED_MAX_LENGTH 48          // Longest format_fixed output
+#define STREAM_FIXED_EXACT_LIMIT 9007199254740992.  // 2^53, digits below are exact
+#define STREAM_EPOCH_MAX_LENGTH 63
+
+typedef enum epoch_format {
+    EPOCH_DAYS_SINCE_J2K = 0,
+    EPOCH_JULIAN_DATE
+} epoch_format;
+
+typedef struct line_reader {
+    FILE* file;
+    char* buffer;
+    size_t capacity;
+    size_t begin;               // Start of the unread data
+    size_t end;                 // End of the data read so far
+    int eof;
+    long line_number;           // Of the line last returned
+} line_reader;
+
+typedef struct stream_writer {
+    FILE* file;
+    char* buffer;
+    size_t capacity;
+    size_t used;
+    int failed;                 // Non-zero once a write has failed
+} stream_writer;
+
+SSD_INLINE void line_reader_init(line_reader* reader, FILE* file, char* buffer, const size_t capacity){
+    reader->file = file;
+    reader->buffer = buffer;
+    reader->capacity = capacity;
+    reader->begin = 0;
+    reader->end = 0;
+    reader->eof = 0;
+    reader->line_number = 0;
+}
+
+// Next line, without its end of line ("\n" or "\r\n"), as a pointer into
+// the buffer that stays valid until the next call. Returns 1 for a line,
+// 0 at the end of the file and -1 on a read error or a line longer than
+// the buffer.
+SSD_INLINE int line_reader_next(line_reader* reader, const char** line, size_t* length){
+    for (;;){
+        char* begin = reader->buffer + reader->begin;
+        char* newline = (char*)memchr(begin, '\n', reader->end - reader->begin);
+        if (newline!=NULL || (reader->eof && reader->begin<reader->end)){
+            size_t n = newline!=NULL ? (size_t)(newline-begin) : reader->end - reader->begin;
+            reader->begin += newline!=NULL ? n+1 : n;
+            if (n>0 && begin[n-1]=='\r'){
+                n--;
+            }
+            *line = begin;
+            *length = n;
+            reader->line_number++;
+            return 1;
+        }
+        if (reader->eof){
+            return 0;
+        }
+        if (reader->begin>0){
+            memmove(reader->buffer, begin, reader->end - reader->begin);
+            reader->end -= reader->begin;
+            reader->begin = 0;
+        }
+        if (reader->end==reader->capacity){
+            return -1;
+        }
+        size_t n_read = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end, reader->file);
+        reader->end += n_read;
+        if (n_read==0){
+            if (ferror(reader->file)){
+                return -1;
+            }
+            reader->eof = 1;
+        }
+    }
+}
+
+// Parse one epoch of length characters, surrounding blanks allowed: an
+// ISO-8601 timestamp as iso8601_to_days_since_j2k reads it, or else a
+// number read as numbers_are says. Returns 0 and sets *days_since_j2k on
+// success, -1 otherwise.
+SSD_INLINE int parse_epoch(const char* text, size_t length, const epoch_format numbers_are, double* days_since_j2k){
+    while (length>0 && (*text==' ' || *text=='\t')){
+        text++;
+        length--;
+    }
+    while (length>0 && (text[length-1]==' ' || text[length-1]=='\t')){
+        length--;
+    }
+    if (length==0 || length>STREAM_EPOCH_MAX_LENGTH){
+        return -1;
+    }
+    if (length>=10 && text[4]=='-'){
+        return iso8601_to_days_since_j2k(text, length, days_since_j2k);
+    }
+
+    // strtod wants a terminated string
+    char number[STREAM_EPOCH_MAX_LENGTH+1];
+    memcpy(number, text, length);
+    number[length] = '\0';
+    char* end;
+    double value = strtod(number, &end);
+    if (end!=number+length || !isfinite(value)){
+        return -1;
+    }
+    *days_since_j2k = numbers_are==EPOCH_JULIAN_DATE ? value - J2000_JULIAN_DATE : value;
+    return 0;
+}
+
+// Write value with the given number of decimals (at most
+// STREAM_FIXED_MAX_DECIMALS) to out, which must hold
+// STREAM_FIXED_MAX_LENGTH characters, and return the number of characters
+// written; no terminating NUL. The digits are printf's "%.*f" digits,
+// rounded from the exact binary value with ties to even, except that
+// values that round to zero have no sign. Values whose "%.*f" would not
+// fit are written as "%.17g".
+SSD_INLINE size_t format_fixed(const double value, const int decimals, char* out){
+    static const double powers_of_ten[STREAM_FIXED_MAX_DECIMALS+1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+    };
+    double scaled = fabs(value)*powers_of_ten[decimals];
+    if (!(scaled<STREAM_FIXED_EXACT_LIMIT)){
+        // Too large for exact integer digits, or not a number
+        char text[STREAM_FIXED_MAX_LENGTH+1];
+        int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+        if (n<0 || n>STREAM_FIXED_MAX_LENGTH){
+            n = snprintf(text, sizeof(text), "%.17g", value);
+        }
+        memcpy(out, text, (size_t)n);
+        return (size_t)n;
+    }
+    // scaled + error is the exact product, so that the rounding is that of
+    // the exact decimal expansion
+    double error;
+#ifdef FP_FAST_FMA
+    error = fma(fabs(value), powers_of_ten[decimals], -scaled);
+#else
+    {
+        // Dekker's product, with the factors split into 26-bit halves
+        const double split = 134217729.; // 2^27+1
+        double a = fabs(value), b = powers_of_ten[decimals];
+        double ta = split*a, a_hi = ta - (ta - a), a_lo = a - a_hi;
+        double tb = split*b, b_hi = tb - (tb - b), b_lo = b - b_hi;
+        error = ((a_hi*b_hi - scaled) + a_hi*b_lo + a_lo*b_hi) + a_lo*b_lo;
+    }
+#endif
+    // Past half a unit; scaled - units - 0.5 is exact
+    uint64_t units = (uint64_t)scaled;
+    double past_half = ((scaled - (double)units) - 0.5) + error;
+    units += past_half>0 || (past_half==0 && (units & 1));
+    uint64_t unit = (uint64_t)powers_of_ten[decimals];
+    uint64_t whole = units/unit, fraction = units%unit;
+
+    // Laid out from the end, two digits at a time
+    static const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    size_t n_whole = 1;
+    for (uint64_t w=whole; w>=10; w/=10){
+        n_whole++;
+    }
+    size_t n = (value<0 && units>0) + n_whole + (decimals>0) + (size_t)decimals;
+    char* p = out + n;
+    for (int i=decimals; i>=2; i-=2){
+        p -= 2;
+        memcpy(p, digit_pairs + 2*(fraction%100), 2);
+        fraction /= 100;
+    }
+    if (decimals & 1){
+        *--p = (char)('0' + fraction);
+    }
+    if (decimals>0){
+        *--p = '.';
+    }
+    for (; whole>=10; whole/=100){
+        p -= 2;
+        memcpy(p, digit_pairs + 2*(whole%100), 2);
+    }
+    if (n_whole & 1){
+        *--p = (char)('0' + whole);
+    }
+    if (p>out){
+        *--p = '-';
+    }
+    return n;
+}
+
+// value as 8 bytes, least significant first, whatever the host order.
+SSD_INLINE void store_le_f64(const double value, unsigned char* out){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i=0; i<8; i++){
+        out[i] = (unsigned char)(bits >> (8*i));
+    }
+}
+
+SSD_INLINE void stream_writer_init(stream_writer* writer, FILE* file, char* buffer, const size_t capacity){
+    writer->file = file;
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    writer->used = 0;
+    writer->failed = 0;
+}
+
+// Write out the buffered bytes. Returns 0 on success, -1 if this or any
+// earlier write failed.
+SSD_INLINE int stream_writer_flush(stream_writer* writer){
+    if (writer->used>0 && !writer->failed){
+        writer->failed = fwrite(writer->buffer, 1, writer->used, writer->file)!=writer->used;
+    }
+    writer->used = 0;
+    return writer->failed ? -1 : 0;
+}
+
+// Room for n more bytes, at most the capacity, flushing first if needed.
+// Fill it and then advance writer->used by the number of bytes written.
+SSD_INLINE char* stream_writer_reserve(stream_writer* writer, const size_t n){
+    if (writer->used + n > writer->capacity){
+        stream_writer_flush(writer);
+    }
+    return writer->buffer + writer->used;
+}
+
+#endif
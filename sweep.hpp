@@ -0,0 +1,99 @@
+/*
+Parallel sweeps of positions over evenly spaced epochs.
+
+The epochs are start + k*step for k in [0, n_steps). The range is cut into
+chunks of SWEEP_CHUNK_STEPS epochs that are scheduled on a thread_pool;
+each chunk goes through xyz_in_icrf_frame_batch for all the bodies. Every
+epoch is computed with the same arithmetic whatever chunk it lands in, so
+the output is bit-identical to sweep_icrf_serial.
+*/
+
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "keplerian_elements.h"
+#include "orbits_batch.h"
+#include "thread_pool.hpp"
+
+#define SWEEP_CHUNK_STEPS 4096
+
+// A finished chunk as handed to a sweep sink: epochs first_step to
+// first_step+n_steps-1, with x[b][k], y[b][k], z[b][k] the ICRF position of
+// body b at epoch first_step+k. The buffers belong to the sweep and are
+// reused once the sink returns.
+struct sweep_chunk {
+    size_t first_step;
+    size_t n_steps;
+    const double* days_since_j2k;
+    const double* const* x_eq_au;
+    const double* const* y_eq_au;
+    const double* const* z_eq_au;
+};
+
+inline void sweep_epochs(const double start_days_since_j2k, const double step_days, const size_t first_step, const size_t n_steps, double* days_since_j2k){
+    for (size_t k=0; k<n_steps; k++){
+        days_since_j2k[k] = start_days_since_j2k + (double)(first_step+k)*step_days;
+    }
+}
+
+// Reference single-threaded sweep into preallocated buffers: x_eq_au[b],
+// y_eq_au[b] and z_eq_au[b] must hold n_steps doubles each.
+inline void sweep_icrf_serial(const keplerian_elements* bodies, const size_t n_bodies, const double start_days_since_j2k, const double step_days, const size_t n_steps, double* const* x_eq_au, double* const* y_eq_au, double* const* z_eq_au){
+    std::vector<double> days_since_j2k(n_steps);
+    sweep_epochs(start_days_since_j2k, step_days, 0, n_steps, days_since_j2k.data());
+    xyz_in_icrf_frame_batch(bodies, n_bodies, days_since_j2k.data(), n_steps, x_eq_au, y_eq_au, z_eq_au);
+}
+
+// Parallel sweep into preallocated buffers laid out as for
+// sweep_icrf_serial. Each chunk writes its own slice of every buffer, so
+// there is no locking on the output.
+inline void sweep_icrf(const keplerian_elements* bodies, const size_t n_bodies, const double start_days_since_j2k, const double step_days, const size_t n_steps, double* const* x_eq_au, double* const* y_eq_au, double* const* z_eq_au, thread_pool& pool){
+    const size_t n_chunks = (n_steps+SWEEP_CHUNK_STEPS-1)/SWEEP_CHUNK_STEPS;
+    pool.run(n_chunks, [&](size_t chunk){
+        size_t first_step = chunk*SWEEP_CHUNK_STEPS;
+        size_t count = std::min<size_t>(SWEEP_CHUNK_STEPS, n_steps-first_step);
+
+        double days_since_j2k[SWEEP_CHUNK_STEPS];
+        sweep_epochs(start_days_since_j2k, step_days, first_step, count, days_since_j2k);
+
+        std::vector<double*> x(n_bodies), y(n_bodies), z(n_bodies);
+        for (size_t b=0; b<n_bodies; b++){
+            x[b] = x_eq_au[b]+first_step;
+            y[b] = y_eq_au[b]+first_step;
+            z[b] = z_eq_au[b]+first_step;
+        }
+        xyz_in_icrf_frame_batch(bodies, n_bodies, days_since_j2k, count, x.data(), y.data(), z.data());
+    });
+}
+
+// Parallel sweep that hands each finished chunk to sink instead of
+// writing to a whole-range buffer, so memory stays at one chunk per
+// thread however long the range is. sink is called concurrently from the
+// pool's threads and in no particular order.
+inline void sweep_icrf(const keplerian_elements* bodies, const size_t n_bodies, const double start_days_since_j2k, const double step_days, const size_t n_steps, const std::function<void(const sweep_chunk&)>& sink, thread_pool& pool){
+    const size_t n_chunks = (n_steps+SWEEP_CHUNK_STEPS-1)/SWEEP_CHUNK_STEPS;
+    pool.run(n_chunks, [&](size_t chunk){
+        size_t first_step = chunk*SWEEP_CHUNK_STEPS;
+        size_t count = std::min<size_t>(SWEEP_CHUNK_STEPS, n_steps-first_step);
+
+        std::vector<double> days_since_j2k(count);
+        std::vector<double> buffer(3*n_bodies*count);
+        std::vector<double*> x(n_bodies), y(n_bodies), z(n_bodies);
+        for (size_t b=0; b<n_bodies; b++){
+            x[b] = &buffer[(3*b)*count];
+            y[b] = &buffer[(3*b+1)*count];
+            z[b] = &buffer[(3*b+2)*count];
+        }
+        sweep_epochs(start_days_since_j2k, step_days, first_step, count, days_since_j2k.data());
+        xyz_in_icrf_frame_batch(bodies, n_bodies, days_since_j2k.data(), count, x.data(), y.data(), z.data());
+
+        sweep_chunk finished = {first_step, count, days_since_j2k.data(), x.data(), y.data(), z.data()};
+        sink(finished);
+    });
+}
+
+#endif
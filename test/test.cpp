@@ -1,8 +1,32 @@
 #include "doctest/doctest.h"
 #include "time.h"
+#include <float.h>
 #include "../planets.h"
 #include "../planets_1800-2050.h"
+#include "../planets.hpp"
+#include "../orbits_precision.hpp"
 #include "../orbits.h"
+#include "../orbits_batch.h"
+#include "../julian_date.h"
+#include "../orbit_stepper.h"
+#include "../kepler_solvers.h"
+#include "../chebyshev_ephemeris.h"
+#include "../ephemeris_file.h"
+#include "../alignments.hpp"
+#include "../sweep.hpp"
+#include "../small_bodies.hpp"
+#include "../close_approaches.hpp"
+#include "../stream_io.h"
+#include "../fast_math.h"
+#include "../geocentric.h"
+#include "../porkchop.hpp"
+#include "../ephemeris_stream.hpp"
+#include "../libplanets.h"
+#include "../snapshot_cache.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include "../ephemeris_server.hpp"
+#endif
 
 typedef struct alignment {
     int planet1;
@@ -11,17 +35,6 @@ typedef struct alignment {
 } alignment;
 
 TEST_CASE("Checking conjunctions and oppositions"){
-    struct tm j2000_tm = {
-        .tm_sec=0,    // Seconds after the minute
-        .tm_min=0,    // Minutes after the hour
-        .tm_hour=12,  // Hours since midnight
-        .tm_mday=1,   // Day of the month, 1-31
-        .tm_mon=0,    // Months since Jan, 0-11
-        .tm_year=100, // Years since 1900
-    };
-    time_t j2000_localtime = mktime(&j2000_tm);
-    time_t j2000_utctime = j2000_localtime-timezone;
-
     keplerian_elements planets_lr[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
     keplerian_elements planets_sr[8]={Mercury_sr, Venus_sr, Earth_Moon_barycenter_sr, Mars_sr, Jupiter_sr, Saturn_sr, Uranus_sr, Neptune_sr};
     // This is a container of containers? It's all pointers anyway.
@@ -89,9 +102,8 @@ TEST_CASE("Checking conjunctions and oppositions"){
             // Iterate over sets of planets
             keplerian_elements * planets = all_planets[j]; 
             for (int i=0; i<6; i++){ // Iterate over oppositions
-                time_t opposition_timer = mktime(&oppositions[i].date);
-                double seconds_since_j2k = difftime(opposition_timer, j2000_utctime);
-                double days_since_j2k = seconds_since_j2k/(60*60*24);
+                const tm& date = oppositions[i].date;
+                double days_since_j2k = days_since_j2k_from_utc(date.tm_year+1900, date.tm_mon+1, date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec);
                 double p1_lon = longitude_at_date(planets[oppositions[i].planet1], days_since_j2k);
                 double p2_lon = longitude_at_date(planets[oppositions[i].planet2], days_since_j2k);
                 CHECK(abs(p1_lon-p2_lon)<1./180.*M_PI);
@@ -208,9 +220,8 @@ TEST_CASE("Checking conjunctions and oppositions"){
             // Iterate over sets of planets
             keplerian_elements * planets = all_planets[j]; 
             for (int i=0; i<11; i++){
-                time_t conjunction_timer = mktime(&conjunctions[i].date);
-                double seconds_since_j2k = difftime(conjunction_timer, j2000_utctime);
-                double days_since_j2k = seconds_since_j2k/(60*60*24);
+                const tm& date = conjunctions[i].date;
+                double days_since_j2k = days_since_j2k_from_utc(date.tm_year+1900, date.tm_mon+1, date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec);
                 double p1_lon = longitude_at_date(planets[conjunctions[i].planet1], days_since_j2k);
                 double p2_lon = longitude_at_date(planets[conjunctions[i].planet2], days_since_j2k);
                 double longitude_difference = abs(p1_lon-p2_lon);
@@ -229,4 +240,1489 @@ TEST_CASE("Checking conjunctions and oppositions"){
             }
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Batched evaluation matches the scalar entry points"){
+    keplerian_elements planets_lr[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    keplerian_elements planets_sr[8]={Mercury_sr, Venus_sr, Earth_Moon_barycenter_sr, Mars_sr, Jupiter_sr, Saturn_sr, Uranus_sr, Neptune_sr};
+    keplerian_elements * all_planets[2]={planets_lr, planets_sr};
+
+    const size_t n_epochs = 97;
+    double days_since_j2k[n_epochs];
+    for (size_t k=0; k<n_epochs; k++){
+        days_since_j2k[k] = -73000. + 1523.7*k; // 1800 to 2200
+    }
+
+    double x[8][n_epochs], y[8][n_epochs], z[8][n_epochs], lon[8][n_epochs];
+    double* xs[8]; double* ys[8]; double* zs[8]; double* lons[8];
+    for (int p=0; p<8; p++){
+        xs[p]=x[p]; ys[p]=y[p]; zs[p]=z[p]; lons[p]=lon[p];
+    }
+
+    for (int j=0; j<2; j++){
+        keplerian_elements * planets = all_planets[j];
+
+        SUBCASE("Ecliptic frame"){
+            xyz_in_j2k_ecliptic_frame_batch(planets, 8, days_since_j2k, n_epochs, xs, ys, zs);
+            for (int p=0; p<8; p++){
+                for (size_t k=0; k<n_epochs; k++){
+                    double x_au, y_au, z_au;
+                    xyz_in_j2k_ecliptic_frame(planets[p], days_since_j2k[k], &x_au, &y_au, &z_au);
+                    CHECK(fabs(x[p][k]-x_au)<1e-9);
+                    CHECK(fabs(y[p][k]-y_au)<1e-9);
+                    CHECK(fabs(z[p][k]-z_au)<1e-9);
+                }
+            }
+        }
+
+        SUBCASE("ICRF frame"){
+            xyz_in_icrf_frame_batch(planets, 8, days_since_j2k, n_epochs, xs, ys, zs);
+            for (int p=0; p<8; p++){
+                for (size_t k=0; k<n_epochs; k++){
+                    double x_au, y_au, z_au;
+                    xyz_in_icrf_frame(planets[p], days_since_j2k[k], &x_au, &y_au, &z_au);
+                    CHECK(fabs(x[p][k]-x_au)<1e-9);
+                    CHECK(fabs(y[p][k]-y_au)<1e-9);
+                    CHECK(fabs(z[p][k]-z_au)<1e-9);
+                }
+            }
+        }
+
+        SUBCASE("Longitudes"){
+            longitude_at_date_batch(planets, 8, days_since_j2k, n_epochs, lons);
+            for (int p=0; p<8; p++){
+                for (size_t k=0; k<n_epochs; k++){
+                    double expected = longitude_at_date(planets[p], days_since_j2k[k]);
+                    CHECK(fabs(remainder(lon[p][k]-expected, 2*M_PI))<1e-9);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Ecliptic position agrees with the longitude for a near-zero inclination"){
+    for (double days_since_j2k=-36525.; days_since_j2k<36525.; days_since_j2k+=1000.){
+        double x_au, y_au, z_au;
+        xyz_in_j2k_ecliptic_frame(Earth_Moon_barycenter, days_since_j2k, &x_au, &y_au, &z_au);
+        double longitude_rad = longitude_at_date(Earth_Moon_barycenter, days_since_j2k);
+        CHECK(fabs(remainder(atan2(y_au, x_au)-longitude_rad, 2*M_PI))<1e-4);
+        CHECK(fabs(z_au)<5e-4); // I stays below 0.02 degrees
+    }
+}
+
+TEST_CASE("Vectorized Kepler solver matches kepler_solve on every instruction set"){
+    const size_t n = 1001; // Not a multiple of the lane count
+    double M[n], e[n], E[n], sin_E[n], cos_E[n];
+    for (size_t k=0; k<n; k++){
+        M[k] = -M_PI + 2*M_PI*k/(n-1);
+        e[k] = 0.9*((k*37)%100)/100.;
+    }
+
+    for (int isa=KEPLER_SIMD_SCALAR; isa<=(int)kepler_simd_best_isa(); isa++){
+        kepler_solve_sincos_batch_isa((kepler_simd_isa)isa, M, e, E, sin_E, cos_E, n);
+        for (size_t k=0; k<n; k++){
+            CHECK(fabs(E[k]-kepler_solve(M[k], e[k]))<1e-12);
+            CHECK(fabs(sin_E[k]-sin(E[k]))<1e-15);
+            CHECK(fabs(cos_E[k]-cos(E[k]))<1e-15);
+        }
+    }
+}
+
+TEST_CASE("Fused orbital state is self-consistent"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    for (int p=0; p<8; p++){
+        for (double days_since_j2k=-73000.; days_since_j2k<18000.; days_since_j2k+=3217.){
+            orbital_state all, longitude_only, icrf_only;
+            orbital_state_at_date(&planets[p], days_since_j2k, STATE_ALL, &all);
+            orbital_state_at_date(&planets[p], days_since_j2k, STATE_LONGITUDE, &longitude_only);
+            orbital_state_at_date(&planets[p], days_since_j2k, STATE_ICRF, &icrf_only);
+
+            // Subsets are the same numbers as the full evaluation
+            CHECK(longitude_only.longitude_rad==all.longitude_rad);
+            CHECK(icrf_only.x_eq_au==all.x_eq_au);
+            CHECK(icrf_only.y_eq_au==all.y_eq_au);
+            CHECK(icrf_only.z_eq_au==all.z_eq_au);
+
+            // The orbital-plane position is along the true anomaly
+            CHECK(fabs(remainder(atan2(all.y_orbital_au, all.x_orbital_au)-all.true_anomaly_rad, 2*M_PI))<1e-12);
+
+            // Rotations preserve the heliocentric distance
+            double r_orbital = hypot(all.x_orbital_au, all.y_orbital_au);
+            double r_ecl = sqrt(all.x_ecl_au*all.x_ecl_au+all.y_ecl_au*all.y_ecl_au+all.z_ecl_au*all.z_ecl_au);
+            double r_eq = sqrt(all.x_eq_au*all.x_eq_au+all.y_eq_au*all.y_eq_au+all.z_eq_au*all.z_eq_au);
+            CHECK(fabs(r_ecl-r_orbital)<1e-12*r_orbital);
+            CHECK(fabs(r_eq-r_orbital)<1e-12*r_orbital);
+
+            // Same answers as the single-purpose entry points
+            CHECK(all.longitude_rad==longitude_at_date(planets[p], days_since_j2k));
+            CHECK(all.eccentric_anomaly_rad==eccentric_anomaly_at_date(planets[p], days_since_j2k));
+        }
+    }
+}
+
+TEST_CASE("Analytic velocities match differentiated positions"){
+    keplerian_elements planets_lr[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    keplerian_elements planets_sr[8]={Mercury_sr, Venus_sr, Earth_Moon_barycenter_sr, Mars_sr, Jupiter_sr, Saturn_sr, Uranus_sr, Neptune_sr};
+    keplerian_elements * all_planets[2]={planets_lr, planets_sr};
+    const double h = 0.05; // days
+    // Dominated by the truncation error of the central differences
+    const double tolerance = 1e-5;
+
+    for (int j=0; j<2; j++){
+        for (int p=0; p<8; p++){
+            for (double days_since_j2k=-36000.; days_since_j2k<36000.; days_since_j2k+=4321.){
+                orbital_state state, before, after;
+                orbital_state_at_date(&all_planets[j][p], days_since_j2k, STATE_ICRF | STATE_VELOCITY, &state);
+                orbital_state_at_date(&all_planets[j][p], days_since_j2k-h, STATE_ICRF, &before);
+                orbital_state_at_date(&all_planets[j][p], days_since_j2k+h, STATE_ICRF, &after);
+
+                double speed = sqrt(state.vx_ecl_au_per_day*state.vx_ecl_au_per_day
+                                  + state.vy_ecl_au_per_day*state.vy_ecl_au_per_day
+                                  + state.vz_ecl_au_per_day*state.vz_ecl_au_per_day);
+                CHECK(fabs(state.vx_ecl_au_per_day-(after.x_ecl_au-before.x_ecl_au)/(2*h))<tolerance*speed);
+                CHECK(fabs(state.vy_ecl_au_per_day-(after.y_ecl_au-before.y_ecl_au)/(2*h))<tolerance*speed);
+                CHECK(fabs(state.vz_ecl_au_per_day-(after.z_ecl_au-before.z_ecl_au)/(2*h))<tolerance*speed);
+                CHECK(fabs(state.vx_eq_au_per_day-(after.x_eq_au-before.x_eq_au)/(2*h))<tolerance*speed);
+                CHECK(fabs(state.vy_eq_au_per_day-(after.y_eq_au-before.y_eq_au)/(2*h))<tolerance*speed);
+                CHECK(fabs(state.vz_eq_au_per_day-(after.z_eq_au-before.z_eq_au)/(2*h))<tolerance*speed);
+            }
+        }
+    }
+}
+
+TEST_CASE("Chebyshev ephemeris agrees with the analytic positions"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    const double start = -73048.5; // 1800-01-01
+    const double end = 18262.5;    // 2050-01-01
+    const double tolerance_au = 1e-6;
+
+    for (int p=0; p<8; p++){
+        chebyshev_ephemeris ephemeris;
+        REQUIRE(chebyshev_ephemeris_build(&planets[p], start, end, CHEBYSHEV_DEFAULT_COEFFICIENTS, tolerance_au, &ephemeris)==0);
+        CHECK(ephemeris.max_error_au<=tolerance_au);
+
+        for (double days_since_j2k=start; days_since_j2k<=end; days_since_j2k+=97.31){
+            double x, y, z, x_au, y_au, z_au;
+            chebyshev_ephemeris_xyz(&ephemeris, days_since_j2k, &x, &y, &z);
+            xyz_in_icrf_frame(planets[p], days_since_j2k, &x_au, &y_au, &z_au);
+            CHECK(sqrt((x-x_au)*(x-x_au)+(y-y_au)*(y-y_au)+(z-z_au)*(z-z_au))<2*tolerance_au);
+        }
+        chebyshev_ephemeris_free(&ephemeris);
+    }
+
+    chebyshev_ephemeris ephemeris;
+    CHECK(chebyshev_ephemeris_build(&Mars, end, start, CHEBYSHEV_DEFAULT_COEFFICIENTS, tolerance_au, &ephemeris)==-1);
+
+    // Both ends of the span are in it; NAN and epochs outside it, near or
+    // far enough to overflow an int segment index, are rejected
+    REQUIRE(chebyshev_ephemeris_build(&Mars, 0, 3650, CHEBYSHEV_DEFAULT_COEFFICIENTS, tolerance_au, &ephemeris)==0);
+    double x, y, z;
+    CHECK(chebyshev_ephemeris_xyz(&ephemeris, 0, &x, &y, &z)==0);
+    CHECK(chebyshev_ephemeris_xyz(&ephemeris, 3650, &x, &y, &z)==0);
+    CHECK(sqrt(x*x + y*y + z*z)<2);
+    const double outside[6] = {NAN, -1e-3, 3650.001, 1e5, 1e12, -1e12};
+    for (int i=0; i<6; i++){
+        CHECK(chebyshev_ephemeris_xyz(&ephemeris, outside[i], &x, &y, &z)==-1);
+        CHECK(std::isnan(x));
+        CHECK(std::isnan(y));
+        CHECK(std::isnan(z));
+    }
+    chebyshev_ephemeris_free(&ephemeris);
+}
+
+TEST_CASE("Memory-mapped ephemeris file round trip"){
+    const char* path = "test_ephemeris_file.eph";
+    const char* names[2]={"Earth_Moon_barycenter", "Jupiter"};
+    keplerian_elements planets[2]={Earth_Moon_barycenter, Jupiter};
+    chebyshev_ephemeris ephemerides[2];
+    for (int i=0; i<2; i++){
+        REQUIRE(chebyshev_ephemeris_build(&planets[i], -3652.5, 3652.5, CHEBYSHEV_DEFAULT_COEFFICIENTS, 1e-6, &ephemerides[i])==0);
+    }
+    REQUIRE(ephemeris_file_write(path, names, ephemerides, 2)==0);
+
+    ephemeris_file file;
+    REQUIRE(ephemeris_file_open(path, &file)==0);
+    CHECK(file.header->n_bodies==2);
+    CHECK(ephemeris_file_find(&file, "Mars")==-1);
+    for (int i=0; i<2; i++){
+        int index = ephemeris_file_find(&file, names[i]);
+        REQUIRE(index==i);
+        chebyshev_ephemeris view;
+        ephemeris_file_body_view(&file, index, &view);
+        CHECK(view.n_segments==ephemerides[i].n_segments);
+        for (double days_since_j2k=-3652.5; days_since_j2k<=3652.5; days_since_j2k+=17.3){
+            double x, y, z, x_ref, y_ref, z_ref;
+            chebyshev_ephemeris_xyz(&view, days_since_j2k, &x, &y, &z);
+            chebyshev_ephemeris_xyz(&ephemerides[i], days_since_j2k, &x_ref, &y_ref, &z_ref);
+            CHECK(x==x_ref);
+            CHECK(y==y_ref);
+            CHECK(z==z_ref);
+        }
+    }
+    ephemeris_file_close(&file);
+
+    // A file written on a machine with the other byte order is rejected
+    FILE* f = fopen(path, "r+b");
+    REQUIRE(f!=NULL);
+    uint32_t swapped = __builtin_bswap32(EPHEMERIS_FILE_ENDIAN_TAG);
+    fseek(f, offsetof(ephemeris_file_header, endian_tag), SEEK_SET);
+    fwrite(&swapped, sizeof(swapped), 1, f);
+    fclose(f);
+    CHECK(ephemeris_file_open(path, &file)==-1);
+
+    // Crafted body records are rejected instead of reading past the mapping
+    auto open_with_body_field = [&](const size_t field_offset, const void* value, const size_t size){
+        REQUIRE(ephemeris_file_write(path, names, ephemerides, 2)==0);
+        FILE* crafted = fopen(path, "r+b");
+        REQUIRE(crafted!=NULL);
+        fseek(crafted, (long)(sizeof(ephemeris_file_header) + field_offset), SEEK_SET);
+        fwrite(value, size, 1, crafted);
+        fclose(crafted);
+        int result = ephemeris_file_open(path, &file);
+        if (result==0){
+            ephemeris_file_close(&file);
+        }
+        return result;
+    };
+    // Counts whose product wraps around 2^64
+    uint32_t int_max = INT_MAX;
+    REQUIRE(ephemeris_file_write(path, names, ephemerides, 2)==0);
+    f = fopen(path, "r+b");
+    REQUIRE(f!=NULL);
+    fseek(f, (long)(sizeof(ephemeris_file_header) + offsetof(ephemeris_file_body, n_segments)), SEEK_SET);
+    fwrite(&int_max, sizeof(int_max), 1, f);
+    fwrite(&int_max, sizeof(int_max), 1, f);
+    fclose(f);
+    CHECK(ephemeris_file_open(path, &file)==-1);
+    // Counts that do not fit in an int
+    uint32_t too_many = (uint32_t)INT_MAX+1;
+    CHECK(open_with_body_field(offsetof(ephemeris_file_body, n_segments), &too_many, sizeof(too_many))==-1);
+    CHECK(open_with_body_field(offsetof(ephemeris_file_body, n_coefficients), &too_many, sizeof(too_many))==-1);
+    // An offset that wraps around when the coefficients are added to it
+    uint64_t wrapping_offset = UINT64_MAX - (EPHEMERIS_FILE_ALIGNMENT-1);
+    CHECK(open_with_body_field(offsetof(ephemeris_file_body, coefficients_offset), &wrapping_offset, sizeof(wrapping_offset))==-1);
+    // Segments of no or undefined length, or too short for segments_per_day
+    for (double segment_days : {0., -1., (double)NAN, (double)INFINITY, DBL_MIN/4}){
+        CHECK(open_with_body_field(offsetof(ephemeris_file_body, segment_days), &segment_days, sizeof(segment_days))==-1);
+    }
+    double start = NAN;
+    CHECK(open_with_body_field(offsetof(ephemeris_file_body, start_days_since_j2k), &start, sizeof(start))==-1);
+    // And an untouched record still opens
+    uint32_t n_segments = (uint32_t)ephemerides[0].n_segments;
+    CHECK(open_with_body_field(offsetof(ephemeris_file_body, n_segments), &n_segments, sizeof(n_segments))==0);
+
+    remove(path);
+    CHECK(ephemeris_file_open(path, &file)==-1);
+    for (int i=0; i<2; i++){
+        chebyshev_ephemeris_free(&ephemerides[i]);
+    }
+}
+
+TEST_CASE("Alignment search finds the known Mars oppositions"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    thread_pool pool(3);
+
+    // 2000-01-01 to 2026-01-01, every event involving the Earth
+    std::vector<alignment_event> events = find_alignments(planets, alignment_pairs_with(2, 8), 0., 9497., pool);
+    REQUIRE(!events.empty());
+    for (size_t k=0; k<events.size(); k++){
+        if (k>0){
+            CHECK(events[k-1].days_since_j2k<=events[k].days_since_j2k);
+        }
+        double difference = wrap_angle_rad(longitude_at_date(planets[events[k].planet1], events[k].days_since_j2k)
+                                         - longitude_at_date(planets[events[k].planet2], events[k].days_since_j2k));
+        double target = events[k].kind==ALIGNMENT_SAME_LONGITUDE ? 0. : M_PI;
+        CHECK(fabs(wrap_angle_rad(difference-target))<1e-6);
+    }
+
+    // Mars oppositions, 2003-2025
+    double mars_oppositions[11]={1334.5, 2136.5, 2913.5, 3680.5, 4444.5, 5210.5, 5985.5, 6781.5, 7590.5, 8376.5, 9146.5};
+    std::vector<double> found;
+    for (const alignment_event& event : events){
+        CHECK(seen_from_earth(planets, event, 2)!=GEOCENTRIC_NONE);
+        if (event.planet2==3 && seen_from_earth(planets, event, 2)==GEOCENTRIC_OPPOSITION && event.days_since_j2k>1000.){
+            CHECK(event.kind==ALIGNMENT_SAME_LONGITUDE);
+            found.push_back(event.days_since_j2k);
+        }
+        // Mercury and Venus only ever have conjunctions
+        if (event.planet2<2){
+            CHECK((seen_from_earth(planets, event, 2)==GEOCENTRIC_INFERIOR_CONJUNCTION)==(event.kind==ALIGNMENT_SAME_LONGITUDE));
+            CHECK((seen_from_earth(planets, event, 2)==GEOCENTRIC_SUPERIOR_CONJUNCTION)==(event.kind==ALIGNMENT_OPPOSITE_LONGITUDE));
+        }
+    }
+    alignment_event jupiter_saturn = {4, 5, 0., ALIGNMENT_SAME_LONGITUDE};
+    CHECK(seen_from_earth(planets, jupiter_saturn, 2)==GEOCENTRIC_NONE);
+    alignment_event earth_mars = {3, 2, 0., ALIGNMENT_OPPOSITE_LONGITUDE};
+    CHECK(seen_from_earth(planets, earth_mars, 2)==GEOCENTRIC_CONJUNCTION);
+    REQUIRE(found.size()==11);
+    for (int k=0; k<11; k++){
+        CHECK(fabs(found[k]-mars_oppositions[k])<3.);
+    }
+
+    // The split over threads does not change the answer
+    thread_pool serial(0);
+    std::vector<alignment_event> serial_events = find_alignments(planets, alignment_pairs_with(2, 8), 0., 9497., serial);
+    REQUIRE(serial_events.size()==events.size());
+    for (size_t k=0; k<events.size(); k++){
+        CHECK(serial_events[k].days_since_j2k==events[k].days_since_j2k);
+    }
+}
+
+TEST_CASE("Parallel sweep is bit-identical to the serial sweep"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    // Ten days at one-minute resolution, not a whole number of chunks
+    const size_t n_steps = 14400+123;
+    const double start = 9000.25, step = 1./1440;
+
+    std::vector<double> serial(3*8*n_steps), parallel(3*8*n_steps, 0.);
+    double* xs[8]; double* ys[8]; double* zs[8];
+    double* xp[8]; double* yp[8]; double* zp[8];
+    for (int b=0; b<8; b++){
+        xs[b] = &serial[(3*b)*n_steps]; ys[b] = &serial[(3*b+1)*n_steps]; zs[b] = &serial[(3*b+2)*n_steps];
+        xp[b] = &parallel[(3*b)*n_steps]; yp[b] = &parallel[(3*b+1)*n_steps]; zp[b] = &parallel[(3*b+2)*n_steps];
+    }
+    sweep_icrf_serial(planets, 8, start, step, n_steps, xs, ys, zs);
+
+    thread_pool pool(3);
+    sweep_icrf(planets, 8, start, step, n_steps, xp, yp, zp, pool);
+    CHECK(memcmp(serial.data(), parallel.data(), serial.size()*sizeof(double))==0);
+
+    // The sink variant sees every epoch exactly once, with the same values
+    std::vector<double> streamed(3*8*n_steps, 0.);
+    std::vector<int> seen(n_steps, 0);
+    std::mutex seen_mutex;
+    sweep_icrf(planets, 8, start, step, n_steps, [&](const sweep_chunk& chunk){
+        for (int b=0; b<8; b++){
+            memcpy(&streamed[(3*b)*n_steps+chunk.first_step], chunk.x_eq_au[b], chunk.n_steps*sizeof(double));
+            memcpy(&streamed[(3*b+1)*n_steps+chunk.first_step], chunk.y_eq_au[b], chunk.n_steps*sizeof(double));
+            memcpy(&streamed[(3*b+2)*n_steps+chunk.first_step], chunk.z_eq_au[b], chunk.n_steps*sizeof(double));
+        }
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        for (size_t k=0; k<chunk.n_steps; k++){
+            seen[chunk.first_step+k]++;
+        }
+    }, pool);
+    CHECK(memcmp(serial.data(), streamed.data(), serial.size()*sizeof(double))==0);
+    CHECK(std::count(seen.begin(), seen.end(), 1)==(long)n_steps);
+
+    // And agrees with the scalar entry point
+    double x, y, z;
+    xyz_in_icrf_frame(planets[3], start+777*step, &x, &y, &z);
+    CHECK(fabs(xs[3][777]-x)<1e-12);
+}
+
+TEST_CASE("UTC dates and ISO-8601 timestamps convert to days since J2000"){
+    static_assert(days_from_civil(1970, 1, 1)==0, "Unix epoch");
+    static_assert(days_from_civil(2000, 1, 1)==J2000_DAYS_SINCE_UNIX_EPOCH, "J2000 day");
+    static_assert(days_since_j2k_from_utc(2000, 1, 1, 12, 0, 0)==0., "J2000 is noon UTC");
+
+    CHECK(days_from_civil(2000, 3, 1)-days_from_civil(2000, 2, 28)==2);
+    CHECK(days_from_civil(1900, 3, 1)-days_from_civil(1900, 2, 28)==1);
+    CHECK(days_from_civil(1600, 1, 1)==-135140);
+    CHECK(julian_date_from_days_since_j2k(days_since_j2k_from_utc(1858, 11, 17, 0, 0, 0))==2400000.5);
+    CHECK(days_since_j2k_from_unix(J2000_UNIX_SECONDS+86400.)==1.);
+
+    // Same as timegm, which unlike mktime ignores TZ, over a few centuries
+    for (long year=1800; year<=2100; year+=7){
+        for (int month=1; month<=12; month++){
+            struct tm date = {};
+            date.tm_year = (int)year-1900;
+            date.tm_mon = month-1;
+            date.tm_mday = days_in_month(year, month);
+            date.tm_hour = 17;
+            date.tm_min = 3;
+            date.tm_sec = 9;
+            CHECK(days_since_j2k_from_unix((double)timegm(&date))==doctest::Approx(days_since_j2k_from_utc(year, month, date.tm_mday, 17, 3, 9)).epsilon(1e-15));
+        }
+    }
+
+    SUBCASE("Single timestamps"){
+        double days = -1;
+        const char* valid[] = {"2000-01-01T12:00:00Z", "2000-01-01 12:00", "2000-01-01T12:00:00.000", "2000-01-01T13:30:00+01:30", "2000-01-01T10:00-0200", "2000-01-01T14:00:00+02"};
+        for (const char* text : valid){
+            REQUIRE(iso8601_to_days_since_j2k(text, strlen(text), &days)==0);
+            CHECK(fabs(days)<1e-12);
+        }
+        REQUIRE(iso8601_to_days_since_j2k("2025-01-16", 10, &days)==0);
+        CHECK(days==days_since_j2k_from_utc(2025, 1, 16, 0, 0, 0));
+        REQUIRE(iso8601_to_days_since_j2k("2024-02-29T06:00:00.25", 22, &days)==0);
+        CHECK(days==doctest::Approx(days_since_j2k_from_utc(2024, 2, 29, 6, 0, 0.25)).epsilon(1e-15));
+
+        const char* invalid[] = {"", "2000-1-01", "2023-02-29", "2000-13-01", "2000-01-01T24:00", "2000-01-01T12:00:00.", "2000-01-01X", "2000-01-01T12:00Zjunk", "2000-01-01T12:00+1"};
+        for (const char* text : invalid){
+            CHECK(iso8601_to_days_since_j2k(text, strlen(text), &days)==-1);
+        }
+    }
+
+    SUBCASE("Batches"){
+        const char* timestamps[] = {"2019-09-02", "garbage", "2025-01-16T00:00:00Z"};
+        double days[3];
+        CHECK(iso8601_to_days_since_j2k_batch(timestamps, 3, days)==1);
+        CHECK(days[0]==days_since_j2k_from_utc(2019, 9, 2, 0, 0, 0));
+        CHECK(std::isnan(days[1]));
+        CHECK(days[2]==days_since_j2k_from_utc(2025, 1, 16, 0, 0, 0));
+
+        // Log lines with the timestamp in a fixed-width column
+        const char log[] =
+            "2000-01-01T12:00:00 ok\n"
+            "2024-02-29 23:59:60 ok\n"
+            "2023-02-29T00:00:00 no\n"
+            "1999-12-31T1x:00:00 no\n"
+            "1800-03-01T00:00:01 ok\n";
+        const size_t stride = 23;
+        double fixed[5];
+        CHECK(iso8601_fixed_to_days_since_j2k_batch(log, stride, 5, fixed)==2);
+        CHECK(fixed[0]==0.);
+        CHECK(fixed[1]==days_since_j2k_from_utc(2024, 3, 1, 0, 0, 0));
+        CHECK(std::isnan(fixed[2]));
+        CHECK(std::isnan(fixed[3]));
+        CHECK(fixed[4]==days_since_j2k_from_utc(1800, 3, 1, 0, 0, 1));
+        for (int i : {0, 1, 4}){
+            double parsed;
+            REQUIRE(iso8601_to_days_since_j2k(log+i*stride, JULIAN_DATE_ISO8601_FIXED_LENGTH, &parsed)==0);
+            CHECK(parsed==fixed[i]);
+        }
+
+        // The branch-free calendar of the fixed-width parser against the
+        // general one, over month and leap-year edges of every century rule
+        std::string records;
+        for (int year : {0, 1, 4, 100, 400, 1582, 1700, 1800, 1900, 1999, 2000, 2023, 2024, 2100, 2400, 9999}){
+            for (int month=0; month<=13; month++){
+                for (int day=0; day<=32; day++){
+                    char record[32];
+                    snprintf(record, sizeof(record), "%04d-%02d-%02dT%02d:%02d:%02d", year, month, day, day%25, (day*7)%61, (day*11)%62);
+                    records += record;
+                }
+            }
+        }
+        size_t n_records = records.size()/JULIAN_DATE_ISO8601_FIXED_LENGTH;
+        std::vector<double> batch(n_records);
+        size_t n_failed = iso8601_fixed_to_days_since_j2k_batch(records.data(), JULIAN_DATE_ISO8601_FIXED_LENGTH, n_records, batch.data());
+        size_t n_failed_scalar = 0;
+        for (size_t i=0; i<n_records; i++){
+            double parsed;
+            if (iso8601_to_days_since_j2k(records.data() + i*JULIAN_DATE_ISO8601_FIXED_LENGTH, JULIAN_DATE_ISO8601_FIXED_LENGTH, &parsed)!=0){
+                n_failed_scalar++;
+                CHECK(std::isnan(batch[i]));
+            } else {
+                CHECK(batch[i]==parsed);
+            }
+        }
+        CHECK(n_failed==n_failed_scalar);
+        CHECK(n_failed<n_records);
+    }
+}
+
+TEST_CASE("Stepping propagator follows the direct evaluation"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    const double start = -3000.3;
+    const long n_steps = 5000;
+
+    // A coarse step, and a one-minute cadence where the Kepler corrections
+    // go through the Taylor rotations
+    for (double step : {0.37, 1./1440})
+    for (int i=0; i<8; i++){
+        orbit_stepper stepper;
+        orbit_stepper_init(&planets[i], start, step, &stepper);
+        double max_error = 0;
+        for (long k=0; k<n_steps; k++){
+            if (k>0){
+                orbit_stepper_next(&stepper);
+            }
+            CHECK(stepper.days_since_j2k==start+k*step);
+            double x, y, z;
+            xyz_in_icrf_frame(planets[i], stepper.days_since_j2k, &x, &y, &z);
+            max_error = fmax(max_error, sqrt((stepper.x_eq_au-x)*(stepper.x_eq_au-x) + (stepper.y_eq_au-y)*(stepper.y_eq_au-y) + (stepper.z_eq_au-z)*(stepper.z_eq_au-z)));
+
+            // Just before a renormalization the recurrences have drifted the
+            // most: compare with a stepper started fresh at that epoch.
+            if (k%ORBIT_STEPPER_RENORMALIZE_STEPS==ORBIT_STEPPER_RENORMALIZE_STEPS-1){
+                orbit_stepper fresh;
+                orbit_stepper_init(&planets[i], stepper.days_since_j2k, step, &fresh);
+                CHECK(fabs(fresh.x_eq_au-stepper.x_eq_au)<1e-12*planets[i].a_au);
+                CHECK(fabs(fresh.y_eq_au-stepper.y_eq_au)<1e-12*planets[i].a_au);
+                CHECK(fabs(fresh.z_eq_au-stepper.z_eq_au)<1e-12*planets[i].a_au);
+            }
+        }
+        // Limited by the convergence test of kepler_solve, not the stepper
+        CHECK(max_error<2*NEWTON_EPSILON*planets[i].a_au);
+    }
+}
+
+TEST_CASE("Small-body catalogs load and propagate"){
+    const char* mpcorb_path = "test_small_bodies_mpcorb.dat";
+    const char* csv_path = "test_small_bodies.csv";
+    FILE* file = fopen(mpcorb_path, "w");
+    REQUIRE(file!=NULL);
+    fputs("MINOR PLANET CENTER ORBIT DATABASE (MPCORB)\n"
+          "Des'n     H     G   Epoch     M        Peri.      Node       Incl.       e            n           a        Reference #Obs #Opp    Arc    rms  Perts   Computer\n"
+          "----------------------------------------------------------------------------------------------------------------------------------------------------------------\n"
+          "00001    3.34  0.15 K2555 188.70269   73.27216   80.25221   10.58780  0.0789175  0.21429254   2.7660512  0 MPO000000  7330 125 1801-2024 0.80 M-v 30k MPCLINUX   4000      (1) Ceres\n"
+          "\n"
+          "00002    4.12  0.15 K2555 168.80377  310.91065  172.88606   34.92832  0.2305404  0.21373269   2.7708949  0 MPO000000  8950 123 1804-2024 0.83 M-c 28k MPCLINUX   4000      (2) Pallas\n"
+          "00003    5.17  0.15 K25XX 188.70269   73.27216   80.25221   10.58780  0.0789175  0.21429254   2.7660512  0 Bad epoch\n"
+          "K24A00B 18.30  0.15 K255F 331.03412  105.49812  234.71253    5.12000  1.0700000  0.00000000   0.0000000  0 Hyperbolic\n", file);
+    fclose(file);
+
+    file = fopen(csv_path, "w");
+    REQUIRE(file!=NULL);
+    fputs("\"full_name\",\"pdes\",\"epoch\",\"e\",\"a\",\"i\",\"om\",\"w\",\"ma\",\"n\"\n"
+          "\"     4 Vesta (A807 FA)\",\"4\",2460800.5,.08851,2.3612,7.1437,103.7,151.5,26.8,\n"
+          "\"     5 Astraea (A845 XA)\",\"5\",2460800.5,.18744,2.5739,5.3574,141.5,359.1,181.6,0.23835\n"
+          "\"   C/2019 Y4\",\"C/2019 Y4\",2460800.5,1.0004,,45.4,120.5,177.4,,\n", file);
+    fclose(file);
+
+    small_body_catalog catalog;
+    small_body_catalog_init(&catalog);
+    size_t skipped = 0;
+    REQUIRE(small_body_catalog_load(mpcorb_path, &catalog, &skipped)==0);
+    CHECK(catalog.n_bodies==2);
+    CHECK(skipped==2);
+    REQUIRE(small_body_catalog_load(csv_path, &catalog, &skipped)==0);
+    CHECK(skipped==1);
+    REQUIRE(catalog.n_bodies==4);
+    CHECK(strncmp(catalog.designations[0], "00001", SMALL_BODY_DESIGNATION_LENGTH)==0);
+    CHECK(strncmp(catalog.designations[3], "5", SMALL_BODY_DESIGNATION_LENGTH)==0);
+    for (size_t i=0; i<catalog.n_bodies; i++){
+        CHECK((uintptr_t)&catalog.a_au[i]%SMALL_BODY_ALIGNMENT==i*sizeof(double)%SMALL_BODY_ALIGNMENT);
+    }
+    CHECK(catalog.mean_motion_rad_per_day[2]==doctest::Approx(SMALL_BODY_GAUSS_K/pow(2.3612, 1.5)));
+    remove(mpcorb_path);
+    remove(csv_path);
+
+    // The same orbit as Ceres through the planets' code path, with only the
+    // mean longitude moving
+    double epoch = days_since_j2k_from_utc(2025, 5, 5, 0, 0, 0);
+    double n_deg_per_day = 0.21429254;
+    keplerian_elements ceres = {2.7660512, 0.0789175, 10.58780, 188.70269+73.27216+80.25221-n_deg_per_day*epoch, 73.27216+80.25221, 80.25221,
+                                0, 0, 0, n_deg_per_day*36525, 0, 0, 0, 0, 0, 0};
+    for (double days_since_j2k : {epoch, epoch-4000., epoch+12345.6}){
+        double x, y, z, x_ref, y_ref, z_ref;
+        small_body_catalog_xyz_in_j2k_ecliptic_frame(&catalog, 0, 1, days_since_j2k, &x, &y, &z);
+        xyz_in_j2k_ecliptic_frame(ceres, days_since_j2k, &x_ref, &y_ref, &z_ref);
+        CHECK(fabs(x-x_ref)<1e-9);
+        CHECK(fabs(y-y_ref)<1e-9);
+        CHECK(fabs(z-z_ref)<1e-9);
+        small_body_catalog_xyz_in_icrf_frame(&catalog, 0, 1, days_since_j2k, &x, &y, &z);
+        xyz_in_icrf_frame(ceres, days_since_j2k, &x_ref, &y_ref, &z_ref);
+        CHECK(fabs(x-x_ref)<1e-9);
+        CHECK(fabs(y-y_ref)<1e-9);
+        CHECK(fabs(z-z_ref)<1e-9);
+    }
+
+    // A synthetic main belt: the parallel evaluation matches the serial one
+    for (int i=0; i<50000; i++){
+        char designation[16];
+        snprintf(designation, sizeof(designation), "%07d", i+10);
+        double u = (i*0.618033988749895) - floor(i*0.618033988749895);
+        REQUIRE(small_body_catalog_add(&catalog, designation, 9000.5, 2.1+1.2*u, 0.3*u, 20*u, 360*u, 720*u, 1080*u, 0)==0);
+    }
+    const size_t n = catalog.n_bodies;
+    std::vector<double> serial(3*n), parallel(3*n);
+    small_body_catalog_xyz_in_j2k_ecliptic_frame(&catalog, 0, n, 9500.25, &serial[0], &serial[n], &serial[2*n]);
+    thread_pool pool(3);
+    small_body_catalog_xyz_in_j2k_ecliptic_frame(&catalog, 9500.25, &parallel[0], &parallel[n], &parallel[2*n], pool);
+    CHECK(memcmp(serial.data(), parallel.data(), serial.size()*sizeof(double))==0);
+    for (size_t i=0; i<n; i++){
+        double r = sqrt(serial[i]*serial[i] + serial[n+i]*serial[n+i] + serial[2*n+i]*serial[2*n+i]);
+        CHECK(r>=catalog.a_au[i]*(1-catalog.e[i])*(1-1e-12));
+        CHECK(r<=catalog.a_au[i]*(1+catalog.e[i])*(1+1e-12));
+    }
+    small_body_catalog_free(&catalog);
+}
+
+TEST_CASE("Close approaches between catalog bodies"){
+    small_body_catalog catalog;
+    small_body_catalog_init(&catalog);
+
+    SUBCASE("Two orbits crossing at their nodes"){
+        // Same circular orbit tilted either way about the x axis, both at
+        // the node at J2000: they meet every half period.
+        REQUIRE(small_body_catalog_add(&catalog, "up", 0., 2.5, 0., 1., 0., 0., 0., 0)==0);
+        REQUIRE(small_body_catalog_add(&catalog, "down", 0., 2.5, 0., 1., 180., 180., 0., 0)==0);
+        double half_period = M_PI/catalog.mean_motion_rad_per_day[0];
+        thread_pool pool(2);
+        std::vector<close_approach> approaches = find_close_approaches(&catalog, -100., 2*half_period+100., 7., 1e-3, pool);
+        REQUIRE(approaches.size()==3);
+        for (int k=0; k<3; k++){
+            CHECK(approaches[k].body1==0);
+            CHECK(approaches[k].body2==1);
+            CHECK(fabs(approaches[k].days_since_j2k-k*half_period)<1e-5);
+            CHECK(approaches[k].distance_au<1e-6);
+        }
+    }
+
+    SUBCASE("Agrees with a brute-force scan of every pair"){
+        const int n = 200;
+        for (int i=0; i<n; i++){
+            double u = i*0.618033988749895 - floor(i*0.618033988749895);
+            double v = i*0.754877666246693 - floor(i*0.754877666246693);
+            REQUIRE(small_body_catalog_add(&catalog, "belt", 0., 2.5+0.1*u, 0.05*v, 2*u*v, 360*v, 360*u, 360*(u+v), 0)==0);
+        }
+        const double start = 0., end = 400., threshold = 0.05;
+        thread_pool pool(3);
+        std::vector<close_approach> approaches = find_close_approaches(&catalog, start, end, 10., threshold, pool);
+        REQUIRE(!approaches.empty());
+        for (const close_approach& approach : approaches){
+            CHECK(approach.body1<approach.body2);
+            CHECK(approach.distance_au<=threshold);
+            CHECK(approach.days_since_j2k>=start);
+            CHECK(approach.days_since_j2k<end);
+        }
+
+        // Distances on a half-day grid: every local minimum clearly inside
+        // the threshold must have been reported.
+        const int n_samples = 801;
+        std::vector<double> positions(3*n*n_samples);
+        for (int k=0; k<n_samples; k++){
+            double* p = &positions[3*n*k];
+            small_body_catalog_xyz_in_j2k_ecliptic_frame(&catalog, 0, n, start+0.5*k, p, p+n, p+2*n);
+        }
+        auto distance = [&](int i, int j, int k){
+            const double* p = &positions[3*n*k];
+            return sqrt((p[i]-p[j])*(p[i]-p[j]) + (p[n+i]-p[n+j])*(p[n+i]-p[n+j]) + (p[2*n+i]-p[2*n+j])*(p[2*n+i]-p[2*n+j]));
+        };
+        int n_minima = 0;
+        for (int i=0; i<n; i++){
+            for (int j=i+1; j<n; j++){
+                for (int k=1; k+1<n_samples; k++){
+                    double d = distance(i, j, k);
+                    if (d<0.9*threshold && d<distance(i, j, k-1) && d<=distance(i, j, k+1)){
+                        n_minima++;
+                        bool reported = false;
+                        for (const close_approach& approach : approaches){
+                            reported = reported || (approach.body1==(size_t)i && approach.body2==(size_t)j && fabs(approach.days_since_j2k-(start+0.5*k))<1.);
+                        }
+                        CHECK(reported);
+                    }
+                }
+            }
+        }
+        CHECK(n_minima>10);
+    }
+    small_body_catalog_free(&catalog);
+}
+
+TEST_CASE("Alternative Kepler solvers agree with the reference solution"){
+    kepler_table table;
+    CHECK(kepler_table_build(1.0, 1e-12, &table)==-1);
+    REQUIRE(kepler_table_build(0.9, 1e-12, &table)==0);
+    CHECK(table.max_error_rad<=1e-12);
+
+    for (double e : {0., 0.0167, 0.1, 0.25, 0.5, 0.7, 0.9}){
+        for (double M=-7.; M<7.; M+=0.0123){
+            double E_ref = kepler_solve_reference(M, e);
+            // The residual test bounds |E - E_ref| by NEWTON_EPSILON/(1-e)
+            CHECK(fabs(kepler_solve_halley(M, e)-E_ref)<NEWTON_EPSILON/(1-e));
+            if (e<=KEPLER_FIXED_MAX_E){
+                CHECK(fabs(kepler_solve_fixed(M, e)-E_ref)<1e-10);
+            }
+            CHECK(fabs(kepler_table_solve(&table, M, e)-E_ref)<1e-11);
+        }
+    }
+    // Past the table, kepler_solve takes over
+    CHECK(kepler_table_solve(&table, 1., 0.95)==kepler_solve(1., 0.95));
+
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    kepler_solver solvers[4] = {kepler_solver_newton, kepler_solver_halley, kepler_solver_fixed, kepler_solver_table(&table)};
+    for (int p=0; p<8; p++){
+        for (double days_since_j2k=-36525.; days_since_j2k<36525.; days_since_j2k+=777.7){
+            double E = eccentric_anomaly_at_date(planets[p], days_since_j2k);
+            CHECK(eccentric_anomaly_at_date_with(&solvers[0], planets[p], days_since_j2k)==E);
+            for (int k=1; k<4; k++){
+                CHECK(fabs(remainder(eccentric_anomaly_at_date_with(&solvers[k], planets[p], days_since_j2k)-E, 2*M_PI))<2*NEWTON_EPSILON);
+            }
+        }
+    }
+    kepler_table_free(&table);
+}
+
+// The templates of planets.hpp against the functions of orbits.h.
+template <const keplerian_elements& planet>
+void check_compile_time_planet(){
+    // Rounding of the large angles is different in radians per day, up to
+    // 1e-12 rad for Mercury after a century
+    for (double days_since_j2k=-36525.; days_since_j2k<36525.; days_since_j2k+=987.6){
+        CHECK(fabs(remainder(mean_anomaly_at_date<planet>(days_since_j2k)-mean_anomaly_at_date(planet, days_since_j2k), 2*M_PI))<1e-11);
+        CHECK(fabs(remainder(eccentric_anomaly_at_date<planet>(days_since_j2k)-eccentric_anomaly_at_date(planet, days_since_j2k), 2*M_PI))<1e-11);
+        CHECK(fabs(remainder(longitude_at_date<planet>(days_since_j2k)-longitude_at_date(planet, days_since_j2k), 2*M_PI))<1e-11);
+        double x, y, z, x_ref, y_ref, z_ref;
+        xyz_in_icrf_frame<planet>(days_since_j2k, &x, &y, &z);
+        xyz_in_icrf_frame(planet, days_since_j2k, &x_ref, &y_ref, &z_ref);
+        CHECK(fabs(x-x_ref)<1e-11*planet.a_au);
+        CHECK(fabs(y-y_ref)<1e-11*planet.a_au);
+        CHECK(fabs(z-z_ref)<1e-11*planet.a_au);
+    }
+}
+
+TEST_CASE("Compile-time planets agree with the run-time functions"){
+    static_assert(!planets_rad[0].has_corrections && planets_rad[4].has_corrections, "corrections only for Jupiter to Neptune");
+    static_assert(ecliptic_to_icrf[1][1]==ecliptic_to_icrf[2][2], "a rotation");
+    CHECK(COS_OBLIQUITY_J2K==cos(OBLIQUITY_J2K_DEG*M_PI/180.));
+    CHECK(SIN_OBLIQUITY_J2K==sin(OBLIQUITY_J2K_DEG*M_PI/180.));
+
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    for (int p=0; p<8; p++){
+        prepared_elements prepared;
+        prepare_elements(&planets[p], &prepared);
+        // Field by field: a memcmp would also compare the tail padding
+        const prepared_elements& expected = planets_rad[p];
+        CHECK(prepared.a_au==expected.a_au);
+        CHECK(prepared.e==expected.e);
+        CHECK(prepared.I_rad==expected.I_rad);
+        CHECK(prepared.L_rad==expected.L_rad);
+        CHECK(prepared.lon_periapsis_rad==expected.lon_periapsis_rad);
+        CHECK(prepared.Omega_rad==expected.Omega_rad);
+        CHECK(prepared.adot==expected.adot);
+        CHECK(prepared.edot==expected.edot);
+        CHECK(prepared.Idot==expected.Idot);
+        CHECK(prepared.Ldot==expected.Ldot);
+        CHECK(prepared.lon_periapsisdot==expected.lon_periapsisdot);
+        CHECK(prepared.Omegadot==expected.Omegadot);
+        CHECK(prepared.b==expected.b);
+        CHECK(prepared.c==expected.c);
+        CHECK(prepared.s==expected.s);
+        CHECK(prepared.f==expected.f);
+        CHECK(prepared.has_corrections==expected.has_corrections);
+    }
+
+    check_compile_time_planet<Mercury>();
+    check_compile_time_planet<Venus>();
+    check_compile_time_planet<Earth_Moon_barycenter>();
+    check_compile_time_planet<Mars>();
+    check_compile_time_planet<Jupiter>();
+    check_compile_time_planet<Saturn>();
+    check_compile_time_planet<Uranus>();
+    check_compile_time_planet<Neptune>();
+    check_compile_time_planet<Jupiter_sr>();
+}
+
+// Largest distance (AU) between xyz_in_icrf_frame_batch in the given
+// precision and in double.
+template <typename precision>
+static double max_precision_error_au(const keplerian_elements* planet, const std::vector<double>& days, const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z){
+    typedef typename precision::real real;
+    size_t n = days.size();
+    std::vector<real> xr(n), yr(n), zr(n);
+    real* xs[1] = {xr.data()};
+    real* ys[1] = {yr.data()};
+    real* zs[1] = {zr.data()};
+    xyz_in_icrf_frame_batch<precision>(planet, 1, days.data(), n, xs, ys, zs);
+    double max_error = 0;
+    for (size_t k=0; k<n; k++){
+        double error = sqrt(pow(xr[k]-x[k], 2) + pow(yr[k]-y[k], 2) + pow(zr[k]-z[k], 2));
+        max_error = error>max_error ? error : max_error;
+    }
+    return max_error;
+}
+
+TEST_CASE("Float and mixed precision stay within their error bounds"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    // 1800-2050
+    std::vector<double> days;
+    for (double t=-73048.5; t<=18262.5; t+=0.37){
+        days.push_back(t);
+    }
+    size_t n = days.size();
+    std::vector<double> x(n), y(n), z(n);
+    double* xs[1] = {x.data()};
+    double* ys[1] = {y.data()};
+    double* zs[1] = {z.data()};
+    for (int p=0; p<8; p++){
+        xyz_in_icrf_frame_batch(&planets[p], 1, days.data(), n, xs, ys, zs);
+        CHECK(max_precision_error_au<precision_double>(&planets[p], days, x, y, z)<=precision_double::max_error_au);
+        CHECK(max_precision_error_au<precision_mixed>(&planets[p], days, x, y, z)<=precision_mixed::max_error_au);
+        CHECK(max_precision_error_au<precision_float>(&planets[p], days, x, y, z)<=precision_float::max_error_au);
+    }
+
+    // The float kernels on their own
+    float M[37], e[37], E[37], sin_E[37], cos_E[37];
+    for (int k=0; k<37; k++){
+        M[k] = (float)(-M_PI + 2*M_PI*k/36);
+        e[k] = 0.9f*k/36;
+    }
+    kepler_solve_sincos_batch_f(M, e, E, sin_E, cos_E, 37);
+    for (int k=0; k<37; k++){
+        CHECK(fabs(E[k] - kepler_solve(M[k], e[k]))<1e-6);
+        CHECK(fabs(sin_E[k] - sin(E[k]))<2e-7);
+        CHECK(fabs(cos_E[k] - cos(E[k]))<2e-7);
+    }
+}
+
+TEST_CASE("Solver statistics count every solve"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    solver_stats stats;
+#ifndef SSD_SOLVER_STATS
+    CHECK(solver_stats_collect(&stats)==-1);
+    CHECK(stats.solves==0);
+#else
+    solver_stats_reset();
+    for (int k=0; k<10; k++){
+        eccentric_anomaly_at_date(Earth_Moon_barycenter, 1000.*k);
+        double x, y, z;
+        xyz_in_icrf_frame(Mars, 1000.*k, &x, &y, &z);
+    }
+    REQUIRE(solver_stats_collect(&stats)==0);
+    CHECK(stats.calls[SOLVER_STATS_ECCENTRIC_ANOMALY_AT_DATE]==10);
+    CHECK(stats.calls[SOLVER_STATS_XYZ_IN_ICRF_FRAME]==10);
+    CHECK(stats.calls[SOLVER_STATS_ORBITAL_STATE_AT_DATE]==10);
+    CHECK(stats.calls[SOLVER_STATS_MEAN_ANOMALY_AT_DATE]==20);
+    CHECK(stats.calls[SOLVER_STATS_KEPLER_SOLVE]==20);
+    CHECK(stats.solves==20);
+    CHECK(stats.non_converged==0);
+    CHECK(stats.max_residual_rad<NEWTON_EPSILON);
+    REQUIRE(stats.n_bodies==3);
+    CHECK(stats.bodies[1].a_au==Earth_Moon_barycenter.a_au);
+    CHECK(stats.bodies[1].solves==10);
+    CHECK(stats.bodies[2].a_au==Mars.a_au);
+    CHECK(stats.bodies[2].solves==10);
+
+    // Solves in the pool's threads and in the SIMD kernel are counted too,
+    // padding lanes excluded
+    const size_t n_steps = 1001;
+    std::vector<double> xyz(3*8*n_steps);
+    double* x[8]; double* y[8]; double* z[8];
+    for (int p=0; p<8; p++){
+        x[p] = &xyz[(3*p)*n_steps];
+        y[p] = &xyz[(3*p+1)*n_steps];
+        z[p] = &xyz[(3*p+2)*n_steps];
+    }
+    solver_stats_reset();
+    {
+        thread_pool pool(3);
+        sweep_icrf(planets, 8, 0., 0.25, n_steps, x, y, z, pool);
+    }
+    REQUIRE(solver_stats_collect(&stats)==0);
+    CHECK(stats.solves==(long)(8*n_steps));
+    CHECK(stats.non_converged==0);
+    CHECK(stats.max_residual_rad<NEWTON_EPSILON);
+    CHECK(stats.bodies[0].solves==0);
+    long histogram_total = 0, histogram_iterations = 0;
+    for (int b=0; b<SOLVER_STATS_ECCENTRICITY_BINS; b++){
+        for (int k=0; k<=SOLVER_STATS_MAX_ITERATIONS; k++){
+            histogram_total += stats.iterations_histogram[b][k];
+            histogram_iterations += k*stats.iterations_histogram[b][k];
+            if (b>=3){
+                CHECK(stats.iterations_histogram[b][k]==0); // Every planet has e < 0.3
+            }
+        }
+    }
+    CHECK(histogram_total==stats.solves);
+    CHECK(histogram_iterations==stats.iterations);
+    long residual_total = 0;
+    for (int k=0; k<SOLVER_STATS_RESIDUAL_DECADES; k++){
+        residual_total += stats.residual_histogram[k];
+    }
+    CHECK(residual_total==stats.solves);
+    for (int slot=1; slot<stats.n_bodies; slot++){
+        CHECK(stats.bodies[slot].solves==(long)n_steps);
+    }
+#endif
+}
+
+TEST_CASE("Streaming I/O parses epochs and formats like printf"){
+    double days;
+    CHECK(parse_epoch(" 12.5\t", 6, EPOCH_DAYS_SINCE_J2K, &days)==0);
+    CHECK(days==12.5);
+    CHECK(parse_epoch("2451545.0", 9, EPOCH_JULIAN_DATE, &days)==0);
+    CHECK(days==0);
+    CHECK(parse_epoch("2000-01-02T12:00:00Z", 20, EPOCH_JULIAN_DATE, &days)==0);
+    CHECK(days==1);
+    CHECK(parse_epoch("12.5x", 5, EPOCH_DAYS_SINCE_J2K, &days)==-1);
+    CHECK(parse_epoch("  ", 2, EPOCH_DAYS_SINCE_J2K, &days)==-1);
+    CHECK(parse_epoch("nan", 3, EPOCH_DAYS_SINCE_J2K, &days)==-1);
+
+    const double values[] = {0, 1, -1, 0.5, 29.123456789012345, -0.000000000000499, -0.0000000000006, 2451545.123456789, 123456789.5, 1e300};
+    for (double value : values){
+        for (int decimals : {0, 3, 8, 12}){
+            char expected[400], formatted[STREAM_FIXED_MAX_LENGTH+1];
+            snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+            if (strlen(expected)>STREAM_FIXED_MAX_LENGTH){
+                continue;
+            }
+            size_t n = format_fixed(value, decimals, formatted);
+            formatted[n] = '\0';
+            // printf keeps the sign of negative values rounding to zero
+            const char* unsigned_expected = expected[0]=='-' && strspn(expected+1, "0.")==strlen(expected+1) ? expected+1 : expected;
+            CHECK(std::string(formatted)==std::string(unsigned_expected));
+        }
+    }
+    int n_different = 0;
+    for (int k=0; k<10000; k++){
+        double value = -40 + k*0.00812345678901;
+        char expected[64], formatted[STREAM_FIXED_MAX_LENGTH+1];
+        snprintf(expected, sizeof(expected), "%.12f", value);
+        formatted[format_fixed(value, 12, formatted)] = '\0';
+        n_different += strcmp(expected, formatted)!=0;
+    }
+    CHECK(n_different==0);
+
+    unsigned char bytes[8];
+    store_le_f64(1.0, bytes);
+    CHECK((bytes[7]==0x3f && bytes[6]==0xf0 && bytes[0]==0));
+
+    // Lines across buffer refills, with and without a final newline
+    FILE* file = tmpfile();
+    REQUIRE(file!=NULL);
+    fputs("first\r\n\nthird line\nlast", file);
+    rewind(file);
+    char buffer[12];
+    line_reader reader;
+    line_reader_init(&reader, file, buffer, sizeof(buffer));
+    const char* line;
+    size_t length;
+    std::vector<std::string> lines;
+    while (line_reader_next(&reader, &line, &length)==1){
+        lines.push_back(std::string(line, length));
+    }
+    CHECK(lines==std::vector<std::string>{"first", "", "third line", "last"});
+
+    // A line longer than the buffer
+    rewind(file);
+    char small[4];
+    line_reader_init(&reader, file, small, sizeof(small));
+    CHECK(line_reader_next(&reader, &line, &length)==-1);
+
+    // The writer only writes whole buffers until flushed
+    rewind(file);
+    char out[8];
+    stream_writer writer;
+    stream_writer_init(&writer, file, out, sizeof(out));
+    for (int i=0; i<5; i++){
+        char* room = stream_writer_reserve(&writer, 3);
+        memcpy(room, "ab\n", 3);
+        writer.used += 3;
+    }
+    CHECK(ftell(file)==12);
+    CHECK(stream_writer_flush(&writer)==0);
+    CHECK(ftell(file)==15);
+    fclose(file);
+}
+
+TEST_CASE("Snapshot cache computes each epoch once"){
+    const double second = 1./86400;
+    snapshot_cache cache(2, second);
+    ephemeris_snapshot snapshot;
+    cache.get(100 + 0.4*second, &snapshot);
+    CHECK(snapshot.days_since_j2k==cache.quantize(100));
+    double x, y, z;
+    xyz_in_icrf_frame(Mars, snapshot.days_since_j2k, &x, &y, &z);
+    CHECK(fabs(snapshot.xyz_icrf_au[3][0]-x)<1e-12);
+    CHECK(fabs(snapshot.xyz_icrf_au[3][1]-y)<1e-12);
+    CHECK(fabs(snapshot.xyz_icrf_au[3][2]-z)<1e-12);
+    CHECK(fabs(snapshot.longitude_rad[2]-longitude_at_date(Earth_Moon_barycenter, snapshot.days_since_j2k))<1e-12);
+
+    cache.get(100 - 0.4*second, &snapshot);
+    cache.get(101, &snapshot);
+    cache.get(102, &snapshot);
+    snapshot_cache_stats stats = cache.statistics();
+    CHECK(stats.hits==1);
+    CHECK(stats.misses==3);
+    CHECK(stats.evictions==1);
+
+    // Many threads after the same epochs
+    snapshot_cache shared(1024, second);
+    std::vector<std::thread> threads;
+    for (int t=0; t<8; t++){
+        threads.emplace_back([&shared, t]{
+            ephemeris_snapshot s;
+            for (int k=0; k<64; k++){
+                shared.get(((k+8*t)%64)*1e-3, &s);
+            }
+        });
+    }
+    for (std::thread& thread : threads){
+        thread.join();
+    }
+    stats = shared.statistics();
+    CHECK(stats.misses==64);
+    CHECK(stats.hits+stats.coalesced+stats.misses==8*64);
+    CHECK(stats.batches<=64);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("Ephemeris server answers over a Unix socket"){
+    const std::string path = "/tmp/ssd_test_" + std::to_string(getpid()) + ".sock";
+    snapshot_cache cache(16, 1./86400);
+    ephemeris_server server(cache);
+    REQUIRE(server.listen_on(path)==0);
+    std::thread serving([&server]{ server.run(); });
+
+    int fd = ephemeris_connect(path.c_str());
+    REQUIRE(fd>=0);
+    ephemeris_request request = {EPHEMERIS_XYZ_ICRF, (1u<<2) | (1u<<3), 42, 9000.25};
+    ephemeris_response response;
+    REQUIRE(ephemeris_query(fd, &request, &response)==0);
+    CHECK(response.status==0);
+    CHECK(response.tag==42);
+    CHECK(response.n_values==6);
+    CHECK(response.days_since_j2k==cache.quantize(9000.25));
+    double x, y, z;
+    xyz_in_icrf_frame(Mars, response.days_since_j2k, &x, &y, &z);
+    CHECK(fabs(response.values[3]-x)<1e-12);
+    CHECK(fabs(response.values[5]-z)<1e-12);
+
+    request.kind = EPHEMERIS_LONGITUDE;
+    request.body_mask = EPHEMERIS_ALL_BODIES;
+    REQUIRE(ephemeris_query(fd, &request, &response)==0);
+    CHECK(response.n_values==8);
+    CHECK(fabs(response.values[3]-longitude_at_date(Mars, response.days_since_j2k))<1e-12);
+
+    request.body_mask = 1u<<8;
+    request.tag = 7;
+    REQUIRE(ephemeris_query(fd, &request, &response)==0);
+    CHECK(response.status==-1);
+    CHECK(response.tag==7);
+    close(fd);
+
+    server.stop();
+    serving.join();
+    CHECK(cache.statistics().misses==1);
+}
+#endif
+
+TEST_CASE("Sky snapshot derives geocentric positions and separations from one solve per planet"){
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    for (int k=0; k<40; k++){
+        double days = -36525 + 1826.25*k + 0.37*k;
+        double x_earth, y_earth, z_earth;
+        xyz_in_icrf_frame(Earth_Moon_barycenter, days, &x_earth, &y_earth, &z_earth);
+
+        sky_snapshot sky;
+        sky_snapshot_at_date(planets, days, 0, &sky);
+        for (int target=0; target<SKY_N_TARGETS; target++){
+            double x = 0, y = 0, z = 0;
+            int p = sky_target_planet(target);
+            if (p>=0){
+                xyz_in_icrf_frame(planets[p], days, &x, &y, &z);
+            }
+            CHECK(fabs(sky.x_geo_au[target] - (x-x_earth))<1e-12);
+            CHECK(fabs(sky.y_geo_au[target] - (y-y_earth))<1e-12);
+            CHECK(fabs(sky.z_geo_au[target] - (z-z_earth))<1e-12);
+            CHECK(sky.light_time_days[target]==0);
+            CHECK(sky.ra_rad[target]>=0);
+            CHECK(sky.ra_rad[target]<2*M_PI);
+            double d = sky.distance_au[target];
+            CHECK(fabs(d*cos(sky.dec_rad[target])*cos(sky.ra_rad[target]) - sky.x_geo_au[target])<1e-12);
+            CHECK(fabs(d*cos(sky.dec_rad[target])*sin(sky.ra_rad[target]) - sky.y_geo_au[target])<1e-12);
+            CHECK(fabs(d*sin(sky.dec_rad[target]) - sky.z_geo_au[target])<1e-12);
+        }
+        for (int i=0; i<SKY_N_TARGETS; i++){
+            CHECK(sky.separation_rad[i][i]==0);
+            for (int j=0; j<SKY_N_TARGETS; j++){
+                CHECK(sky.separation_rad[i][j]==sky.separation_rad[j][i]);
+                double dot = (sky.x_geo_au[i]*sky.x_geo_au[j] + sky.y_geo_au[i]*sky.y_geo_au[j] + sky.z_geo_au[i]*sky.z_geo_au[j])
+                    /(sky.distance_au[i]*sky.distance_au[j]);
+                CHECK(fabs(sky.separation_rad[i][j] - acos(std::max(-1., std::min(1., dot))))<1e-7);
+            }
+        }
+
+        // Light time iterated on the cached states against solving Kepler's
+        // equation again at each retarded epoch
+        sky_snapshot_at_date(planets, days, SKY_LIGHT_TIME, &sky);
+        CHECK(fabs(sky.light_time_days[SKY_SUN] - sky.distance_au[SKY_SUN]/SPEED_OF_LIGHT_AU_PER_DAY)<1e-15);
+        for (int target=SKY_MERCURY; target<SKY_N_TARGETS; target++){
+            int p = sky_target_planet(target);
+            double x, y, z, tau = 0;
+            for (int i=0; i<10; i++){
+                xyz_in_icrf_frame(planets[p], days-tau, &x, &y, &z);
+                x -= x_earth;
+                y -= y_earth;
+                z -= z_earth;
+                tau = sqrt(x*x + y*y + z*z)/SPEED_OF_LIGHT_AU_PER_DAY;
+            }
+            CHECK(fabs(sky.x_geo_au[target] - x)<1e-8);
+            CHECK(fabs(sky.y_geo_au[target] - y)<1e-8);
+            CHECK(fabs(sky.z_geo_au[target] - z)<1e-8);
+            CHECK(fabs(sky.light_time_days[target] - tau)<1e-12);
+        }
+    }
+
+#ifdef SSD_SOLVER_STATS
+    solver_stats stats;
+    solver_stats_reset();
+    sky_snapshot sky;
+    sky_snapshot_at_date(planets, 9000., 0, &sky);
+    sky_snapshot_at_date(planets, 9000., SKY_LIGHT_TIME, &sky);
+    REQUIRE(solver_stats_collect(&stats)==0);
+    CHECK(stats.solves==16);
+#endif
+}
+
+TEST_CASE("Lambert solver and porkchop grid"){
+    // Curtis, Orbital Mechanics for Engineering Students, Example 5.2
+    const double r1[3] = {5000, 10000, 2100}, r2[3] = {-14600, 2500, 7000};
+    double v1[3], v2[3];
+    REQUIRE(lambert_solve(r1, r2, 3600, 398600, LAMBERT_PROGRADE, v1, v2)==0);
+    const double v1_expected[3] = {-5.9925, 1.9254, 3.2456}, v2_expected[3] = {-3.3125, -4.1966, -0.38529};
+    for (int axis=0; axis<3; axis++){
+        CHECK(fabs(v1[axis] - v1_expected[axis])<1e-3);
+        CHECK(fabs(v2[axis] - v2_expected[axis])<1e-3);
+    }
+    CHECK(lambert_solve(r1, r2, 0, 398600, LAMBERT_PROGRADE, v1, v2)==-1);
+    CHECK(lambert_solve(r1, r1, 3600, 398600, LAMBERT_PROGRADE, v1, v2)==-1);
+
+    // A planet's own orbit, frozen at J2000, between two of its positions
+    keplerian_elements frozen = Mars;
+    frozen.adot = frozen.edot = frozen.Idot = frozen.lon_periapsisdot = frozen.Omegadot = 0;
+    double mean_motion_rad_per_day = Mars.Ldot*M_PI/180./36525.;
+    double mu = mean_motion_rad_per_day*mean_motion_rad_per_day*pow(Mars.a_au, 3);
+    const double transfers[] = {30, 200, 400, 600};
+    for (double tof : transfers){
+        orbital_state start, end;
+        orbital_state_at_date(&frozen, 100., STATE_ECLIPTIC | STATE_VELOCITY, &start);
+        orbital_state_at_date(&frozen, 100.+tof, STATE_ECLIPTIC | STATE_VELOCITY, &end);
+        double p1[3] = {start.x_ecl_au, start.y_ecl_au, start.z_ecl_au}, p2[3] = {end.x_ecl_au, end.y_ecl_au, end.z_ecl_au};
+        REQUIRE(lambert_solve(p1, p2, tof, mu, LAMBERT_PROGRADE, v1, v2)==0);
+        CHECK(fabs(v1[0] - start.vx_ecl_au_per_day)<1e-10);
+        CHECK(fabs(v1[1] - start.vy_ecl_au_per_day)<1e-10);
+        CHECK(fabs(v1[2] - start.vz_ecl_au_per_day)<1e-10);
+        CHECK(fabs(v2[0] - end.vx_ecl_au_per_day)<1e-10);
+        CHECK(fabs(v2[1] - end.vy_ecl_au_per_day)<1e-10);
+        CHECK(fabs(v2[2] - end.vz_ecl_au_per_day)<1e-10);
+    }
+
+    // The 2026 Earth-Mars window, on one thread and on several
+    const porkchop_axis departure = {9647.5, 3., 122}, arrival = {9861.5, 4., 130};
+    porkchop_grid serial, parallel;
+    {
+        thread_pool pool(0);
+        porkchop_compute(Earth_Moon_barycenter, Mars, departure, arrival, pool, &serial);
+    }
+    {
+        thread_pool pool(3);
+        porkchop_compute(Earth_Moon_barycenter, Mars, departure, arrival, pool, &parallel);
+    }
+    REQUIRE(serial.c3_km2_per_s2.size()==departure.n*arrival.n);
+    CHECK(memcmp(serial.c3_km2_per_s2.data(), parallel.c3_km2_per_s2.data(), serial.c3_km2_per_s2.size()*sizeof(float))==0);
+    CHECK(memcmp(serial.v_infinity_arrival_km_per_s.data(), parallel.v_infinity_arrival_km_per_s.data(), serial.c3_km2_per_s2.size()*sizeof(float))==0);
+    float lowest_c3 = INFINITY;
+    for (size_t i=0; i<departure.n; i++){
+        for (size_t j=0; j<arrival.n; j++){
+            size_t cell = i*arrival.n + j;
+            CHECK(serial.tof_days[cell]==(float)(arrival.start_days_since_j2k + j*arrival.step_days - (departure.start_days_since_j2k + i*departure.step_days)));
+            CHECK(std::isfinite(serial.c3_km2_per_s2[cell])==(serial.tof_days[cell]>0));
+            if (std::isfinite(serial.c3_km2_per_s2[cell])){
+                lowest_c3 = std::min(lowest_c3, serial.c3_km2_per_s2[cell]);
+            }
+        }
+    }
+    CHECK(lowest_c3>8.f);
+    CHECK(lowest_c3<10.f);
+
+    const char* path = "/tmp/ssd_test.pork";
+    REQUIRE(porkchop_write(path, serial)==0);
+    porkchop_grid read;
+    REQUIRE(porkchop_read(path, &read)==0);
+    CHECK(read.departure.n==departure.n);
+    CHECK(read.arrival.step_days==arrival.step_days);
+    CHECK(memcmp(read.c3_km2_per_s2.data(), serial.c3_km2_per_s2.data(), serial.c3_km2_per_s2.size()*sizeof(float))==0);
+    CHECK(memcmp(read.tof_days.data(), serial.tof_days.data(), serial.tof_days.size()*sizeof(float))==0);
+    remove(path);
+}
+
+TEST_CASE("Ephemeris streams are lazy and compose with ranges"){
+    static_assert(std::ranges::input_range<lazy_generator<ephemeris_sample>>);
+    static_assert(std::ranges::view<lazy_generator<ephemeris_sample>>);
+
+    // Next time after 2025-01-01 that Mars' longitude passes 90 degrees,
+    // against the same epochs evaluated up front
+    const double start = 9131.5, step = 1./24;
+    const double target_rad = M_PI/2;
+    double found = NAN;
+    double previous = NAN;
+#ifdef SSD_SOLVER_STATS
+    solver_stats_reset();
+#endif
+    for (const ephemeris_sample& sample : ephemeris_stream({Mars}, start, step, STATE_LONGITUDE)){
+        REQUIRE(sample.states.size()==1);
+        double longitude = sample.states[0].longitude_rad;
+        if (previous<target_rad && longitude>=target_rad){
+            found = sample.days_since_j2k;
+            break;
+        }
+        previous = longitude;
+    }
+    REQUIRE(!std::isnan(found));
+    size_t n_steps = (size_t)llround((found-start)/step);
+#ifdef SSD_SOLVER_STATS
+    // Only up to the end of the block holding the crossing
+    solver_stats stats;
+    REQUIRE(solver_stats_collect(&stats)==0);
+    CHECK(stats.solves==(long)((n_steps/EPHEMERIS_STREAM_BLOCK+1)*EPHEMERIS_STREAM_BLOCK));
+#endif
+    std::vector<double> longitudes(n_steps+1);
+    for (size_t k=0; k<=n_steps; k++){
+        longitudes[k] = longitude_at_date(Mars, start + (double)k*step);
+    }
+    CHECK(longitudes[n_steps]>=target_rad);
+    CHECK(longitudes[n_steps-1]<target_rad);
+    for (size_t k=0; k+1<n_steps; k++){
+        CHECK(!(longitudes[k]<target_rad && longitudes[k+1]>=target_rad));
+    }
+
+    // A pipeline over several bodies, stopped after a few matches of a
+    // range of a billion epochs
+    auto jupiter_near_saturn = [](const ephemeris_sample& sample){
+        double difference = remainder(sample.states[0].longitude_rad - sample.states[1].longitude_rad, 2*M_PI);
+        return fabs(difference)<M_PI/180;
+    };
+    std::vector<double> matches;
+    for (const ephemeris_sample& sample : ephemeris_stream({Jupiter, Saturn}, 0., 1., STATE_LONGITUDE)
+            | std::views::take_while([](const ephemeris_sample& sample){ return sample.step<1000000000; })
+            | std::views::filter(jupiter_near_saturn)
+            | std::views::take(3)){
+        matches.push_back(sample.days_since_j2k);
+    }
+    REQUIRE(matches.size()==3);
+    for (double days : matches){
+        double difference = remainder(longitude_at_date(Jupiter, days) - longitude_at_date(Saturn, days), 2*M_PI);
+        CHECK(fabs(difference)<M_PI/180);
+    }
+    // The first days of the heliocentric conjunction of mid-2000
+    CHECK(matches[0]>100);
+    CHECK(matches[0]<200);
+    CHECK(matches[2]==matches[0]+2);
+
+    // Fused states match the direct evaluation, backwards in time too
+    int n = 0;
+    for (const ephemeris_sample& sample : ephemeris_stream({Venus, Neptune}, 100., -7.5) | std::views::take(200)){
+        double x, y, z;
+        xyz_in_icrf_frame(Neptune, 100. - 7.5*n, &x, &y, &z);
+        CHECK(sample.days_since_j2k==100. - 7.5*n);
+        CHECK(sample.states[1].x_eq_au==x);
+        CHECK(sample.states[1].y_eq_au==y);
+        CHECK(sample.states[1].z_eq_au==z);
+        n++;
+    }
+    CHECK(n==200);
+}
+
+// Error of value in units in the last place of reference
+static double ulp_error(const double value, const double reference){
+    if (value==reference){
+        return 0;
+    }
+    return fabs(value-reference)/(nextafter(fabs(reference), INFINITY)-fabs(reference));
+}
+
+typedef struct fast_math_errors {
+    double sincos_ulp;
+    double atan2_ulp;
+    double reduce_pi_ulp;       // In ulp of pi, against the exact reduction
+} fast_math_errors;
+
+static void fast_math_check_sincos(const double x, fast_math_errors* errors){
+    double s, c;
+    fast_sincos(x, &s, &c);
+    errors->sincos_ulp = fmax(errors->sincos_ulp, fmax(ulp_error(s, sin(x)), ulp_error(c, cos(x))));
+}
+
+static void fast_math_check_reduce_pi(const double x, fast_math_errors* errors){
+    const long double two_pi = 6.283185307179586476925286766559L;
+    long double exact = (long double)x - two_pi*nearbyintl((long double)x/two_pi);
+    errors->reduce_pi_ulp = fmax(errors->reduce_pi_ulp, (double)fabsl((long double)fast_reduce_pi(x)-exact)/(nextafter(M_PI, 4)-M_PI));
+}
+
+// Every angle orbital_state_at_date takes a sine, cosine, atan2 or
+// reduction of, for planet at days_since_j2k
+static void fast_math_check_planet(const keplerian_elements& planet, const double days_since_j2k, fast_math_errors* errors){
+    double T = days_since_j2k/36525;
+    double e = planet.e + planet.edot*T;
+    double lon_periapsis_deg = planet.lon_periapsis_deg + planet.lon_periapsisdot*T;
+    double Omega_deg = planet.Omega_deg + planet.Omegadot*T;
+    double M = mean_anomaly_at_date(planet, days_since_j2k);
+    double E = kepler_solve(M, e);
+    double sin_E = sin(E), cos_E = cos(E);
+    double y = sqrt(1-e*e)*sin_E, x = cos_E-e;
+
+    fast_math_check_sincos(M, errors);
+    fast_math_check_sincos(M + e*sin(M), errors);
+    fast_math_check_sincos(E, errors);
+    fast_math_check_sincos(planet.f*M_PI/180.*T, errors);
+    fast_math_check_sincos((lon_periapsis_deg-Omega_deg)*M_PI/180., errors);
+    fast_math_check_sincos(Omega_deg*M_PI/180., errors);
+    fast_math_check_sincos((planet.I_deg + planet.Idot*T)*M_PI/180., errors);
+    errors->atan2_ulp = fmax(errors->atan2_ulp, ulp_error(fast_atan2(y, x), atan2(y, x)));
+    fast_math_check_reduce_pi(E, errors);
+    fast_math_check_reduce_pi(lon_periapsis_deg*M_PI/180. + atan2(y, x), errors);
+}
+
+TEST_CASE("Fast math kernels stay within their ulp bounds of libm"){
+    keplerian_elements planets_lr[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+    keplerian_elements planets_sr[8]={Mercury_sr, Venus_sr, Earth_Moon_barycenter_sr, Mars_sr, Jupiter_sr, Saturn_sr, Uranus_sr, Neptune_sr};
+
+    // Every 2.5 days over 1800-2050, every 90 days over 3000 BC-3000 AD
+    fast_math_errors short_range = {0, 0, 0};
+    for (int p=0; p<8; p++){
+        for (double days_since_j2k=-73048.5; days_since_j2k<18262.5; days_since_j2k+=2.5){
+            fast_math_check_planet(planets_sr[p], days_since_j2k, &short_range);
+        }
+    }
+    fast_math_errors long_range = {0, 0, 0};
+    for (int p=0; p<8; p++){
+        for (double days_since_j2k=-1826212.5; days_since_j2k<365242.5; days_since_j2k+=90.){
+            fast_math_check_planet(planets_lr[p], days_since_j2k, &long_range);
+        }
+    }
+
+    // Random arguments, sincos up to FAST_MATH_MAX_SINCOS_ARGUMENT
+    fast_math_errors random = {0, 0, 0};
+    srand(23);
+    for (int i=0; i<200000; i++){
+        double scale = pow(10., 5.*rand()/RAND_MAX - 3.);
+        double x = (2.*rand()/RAND_MAX - 1)*scale;
+        fast_math_check_sincos(x, &random);
+        fast_math_check_reduce_pi(x, &random);
+        double y = (2.*rand()/RAND_MAX - 1)*pow(10., 6.*rand()/RAND_MAX - 3.);
+        random.atan2_ulp = fmax(random.atan2_ulp, ulp_error(fast_atan2(y, x), atan2(y, x)));
+    }
+    for (const fast_math_errors& errors : {short_range, long_range, random}){
+        CHECK(errors.sincos_ulp<=2);
+        CHECK(errors.atan2_ulp<=2);
+        CHECK(errors.reduce_pi_ulp<=1);
+    }
+    // Past the reduction's range the scalar sincos is libm's
+    double s, c;
+    fast_sincos(1e6+0.5, &s, &c);
+    CHECK(s==sin(1e6+0.5));
+    CHECK(c==cos(1e6+0.5));
+    CHECK(fast_reduce_180_deg(-200.)==160.);
+    CHECK(fast_reduce_180_deg(541.)==-179.);
+    CHECK(libm_reduce_pi(-4.)==fast_reduce_pi(-4.));
+
+#ifdef FAST_MATH_SIMD
+    // The 8-lane forms are the scalar ones lane by lane
+    for (int i=0; i<2000; i++){
+        fast_v8d x, y, s8, c8, a8, r8;
+        for (int lane=0; lane<8; lane++){
+            x[lane] = (2.*rand()/RAND_MAX - 1)*1e3;
+            y[lane] = (2.*rand()/RAND_MAX - 1)*pow(10., 6.*rand()/RAND_MAX - 3.);
+        }
+        fast_v8_sincos(&x, &s8, &c8);
+        fast_v8_atan2(&y, &x, &a8);
+        fast_v8_reduce_pi(&x, &r8);
+        for (int lane=0; lane<8; lane++){
+            fast_sincos(x[lane], &s, &c);
+            CHECK(s8[lane]==s);
+            CHECK(c8[lane]==c);
+            CHECK(a8[lane]==fast_atan2(y[lane], x[lane]));
+            CHECK(r8[lane]==fast_reduce_pi(x[lane]));
+        }
+    }
+#endif
+}
+
+TEST_CASE("libplanets C ABI writes the batch results into strided buffers"){
+    CHECK(planets_abi_version()==PLANETS_ABI_VERSION);
+    CHECK(planets_body_set_create_builtin(7)==NULL);
+    CHECK(planets_body_set_create(NULL, 3)==NULL);
+    planets_body_set* set = planets_body_set_create_builtin(PLANETS_ELEMENTS_3000BC_3000AD);
+    REQUIRE(set!=NULL);
+    REQUIRE(planets_body_set_size(set)==8);
+    keplerian_elements planets[8]={Mercury, Venus, Earth_Moon_barycenter, Mars, Jupiter, Saturn, Uranus, Neptune};
+
+    // Every other element of an array of epochs, past a block boundary
+    const size_t n_epochs = 300;
+    std::vector<double> interleaved(2*n_epochs), days(n_epochs);
+    for (size_t k=0; k<n_epochs; k++){
+        days[k] = -40000. + 271.3*k;
+        interleaved[2*k] = days[k];
+        interleaved[2*k+1] = NAN;
+    }
+    std::vector<double> x_ref(8*n_epochs), y_ref(8*n_epochs), z_ref(8*n_epochs), lon_ref(8*n_epochs);
+    double* x_rows[8]; double* y_rows[8]; double* z_rows[8]; double* lon_rows[8];
+    for (int p=0; p<8; p++){
+        x_rows[p] = &x_ref[p*n_epochs];
+        y_rows[p] = &y_ref[p*n_epochs];
+        z_rows[p] = &z_ref[p*n_epochs];
+        lon_rows[p] = &lon_ref[p*n_epochs];
+    }
+    xyz_in_icrf_frame_batch(planets, 8, days.data(), n_epochs, x_rows, y_rows, z_rows);
+    longitude_at_date_batch(planets, 8, days.data(), n_epochs, lon_rows);
+
+    // Reentrant, on the first calls into the library of the test binary:
+    // threads released together race through the lazy ISA detection of
+    // kepler_simd.h, then fill disjoint epochs of one shared buffer. Run
+    // under -fsanitize=thread to catch data races.
+    const ptrdiff_t d = sizeof(double);
+    std::vector<double> shared_xyz(8*n_epochs*3, 0.), shared_lon(8*n_epochs, 0.);
+    {
+        std::atomic<int> ready(0);
+        std::vector<std::thread> threads;
+        for (size_t t=0; t<4; t++){
+            threads.emplace_back([&, t]{
+                ready.fetch_add(1);
+                while (ready.load()<4){
+                    std::this_thread::yield();
+                }
+                size_t first = t*n_epochs/4, last = (t+1)*n_epochs/4;
+                planets_positions(set, PLANETS_FRAME_ICRF, &days[first], last-first, d, &shared_xyz[3*first], n_epochs*3*d, 3*d, d);
+                planets_longitudes(set, &days[first], last-first, d, &shared_lon[first], n_epochs*d, d);
+            });
+        }
+        for (std::thread& thread : threads){
+            thread.join();
+        }
+    }
+    CHECK(shared_lon==lon_ref);
+
+    // (body, epoch, xyz), as numpy's C order
+    std::vector<double> xyz(8*n_epochs*3);
+    REQUIRE(planets_positions(set, PLANETS_FRAME_ICRF, interleaved.data(), n_epochs, 2*d, xyz.data(), n_epochs*3*d, 3*d, d)==0);
+    // (xyz, body, epoch), with the epochs reversed through a negative stride
+    std::vector<double> planes(3*8*n_epochs);
+    REQUIRE(planets_positions(set, PLANETS_FRAME_ICRF, days.data(), n_epochs, d, planes.data() + n_epochs-1, n_epochs*d, -d, 8*n_epochs*d)==0);
+    for (int p=0; p<8; p++){
+        for (size_t k=0; k<n_epochs; k++){
+            size_t i = p*n_epochs + k;
+            CHECK(xyz[3*i]==x_ref[i]);
+            CHECK(xyz[3*i+1]==y_ref[i]);
+            CHECK(xyz[3*i+2]==z_ref[i]);
+            size_t reversed = p*n_epochs + (n_epochs-1-k);
+            CHECK(planes[reversed]==x_ref[i]);
+            CHECK(planes[8*n_epochs + reversed]==y_ref[i]);
+            CHECK(planes[16*n_epochs + reversed]==z_ref[i]);
+        }
+    }
+
+    std::vector<double> longitudes(8*n_epochs);
+    REQUIRE(planets_longitudes(set, days.data(), n_epochs, d, longitudes.data(), n_epochs*d, d)==0);
+    CHECK(longitudes==lon_ref);
+    CHECK(shared_xyz==xyz);
+
+    // States as orbital_state_at_date, (epoch, body, component)
+    std::vector<double> states(n_epochs*8*6);
+    REQUIRE(planets_states(set, PLANETS_FRAME_ECLIPTIC_J2000, days.data(), n_epochs, d, states.data(), 6*d, 8*6*d, d)==0);
+    for (size_t k=0; k<n_epochs; k+=17){
+        for (int p=0; p<8; p++){
+            orbital_state state;
+            orbital_state_at_date(&planets[p], days[k], STATE_ECLIPTIC | STATE_VELOCITY, &state);
+            const double* s = &states[(k*8 + p)*6];
+            CHECK(s[0]==state.x_ecl_au);
+            CHECK(s[1]==state.y_ecl_au);
+            CHECK(s[2]==state.z_ecl_au);
+            CHECK(s[3]==state.vx_ecl_au_per_day);
+            CHECK(s[4]==state.vy_ecl_au_per_day);
+            CHECK(s[5]==state.vz_ecl_au_per_day);
+        }
+    }
+
+    // A caller's own elements give the same positions as the built-in ones
+    planets_elements mars = {Mars.a_au, Mars.e, Mars.I_deg, Mars.L_deg, Mars.lon_periapsis_deg, Mars.Omega_deg,
+        Mars.adot, Mars.edot, Mars.Idot, Mars.Ldot, Mars.lon_periapsisdot, Mars.Omegadot, Mars.b, Mars.c, Mars.s, Mars.f};
+    planets_body_set* mars_only = planets_body_set_create(&mars, 1);
+    REQUIRE(mars_only!=NULL);
+    std::vector<double> mars_xyz(n_epochs*3);
+    REQUIRE(planets_positions(mars_only, PLANETS_FRAME_ICRF, days.data(), n_epochs, d, mars_xyz.data(), 0, 3*d, d)==0);
+    CHECK(memcmp(mars_xyz.data(), &xyz[3*n_epochs*3], n_epochs*3*sizeof(double))==0);
+    planets_body_set_destroy(mars_only);
+
+    // Invalid arguments write nothing
+    CHECK(planets_positions(set, 2, days.data(), n_epochs, d, xyz.data(), n_epochs*3*d, 3*d, d)==-1);
+    CHECK(planets_positions(NULL, PLANETS_FRAME_ICRF, days.data(), n_epochs, d, xyz.data(), n_epochs*3*d, 3*d, d)==-1);
+    CHECK(planets_longitudes(set, NULL, n_epochs, d, longitudes.data(), n_epochs*d, d)==-1);
+    CHECK(planets_positions(set, PLANETS_FRAME_ICRF, NULL, 0, d, NULL, 0, 0, 0)==0);
+    planets_body_set_destroy(set);
+    planets_body_set_destroy(NULL);
+}
@@ -0,0 +1,45 @@
+// A second translation unit including every header, so that the tests fail
+// to link if one of them defines something with external linkage.
+
+#include "doctest/doctest.h"
+#include "../planets.h"
+#include "../planets_1800-2050.h"
+#include "../planets.hpp"
+#include "../fast_math.h"
+#include "../orbits.h"
+#include "../orbits_batch.h"
+#include "../julian_date.h"
+#include "../orbit_stepper.h"
+#include "../kepler_solvers.h"
+#include "../chebyshev_ephemeris.h"
+#include "../ephemeris_file.h"
+#include "../alignments.hpp"
+#include "../sweep.hpp"
+#include "../small_bodies.hpp"
+#include "../close_approaches.hpp"
+#include "../geocentric.h"
+#include "../libplanets.h"
+#include "../porkchop.hpp"
+#include "../ephemeris_stream.hpp"
+
+extern "C" void linkage_c_xyz_in_icrf_frame(double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au);
+
+TEST_CASE("Headers can be included from several C and C++ translation units"){
+    double x, y, z, x_c, y_c, z_c;
+    xyz_in_icrf_frame(Jupiter, 1234.5, &x, &y, &z);
+    linkage_c_xyz_in_icrf_frame(1234.5, &x_c, &y_c, &z_c);
+    CHECK(x==x_c);
+    CHECK(y==y_c);
+    CHECK(z==z_c);
+
+#ifdef SSD_SOLVER_STATS
+    // Solves in every translation unit end up in the same statistics
+    solver_stats stats;
+    solver_stats_reset();
+    xyz_in_icrf_frame(Jupiter, 1234.5, &x, &y, &z);
+    linkage_c_xyz_in_icrf_frame(1234.5, &x_c, &y_c, &z_c);
+    REQUIRE(solver_stats_collect(&stats)==0);
+    CHECK(stats.solves==2);
+    CHECK(stats.calls[SOLVER_STATS_XYZ_IN_ICRF_FRAME]==2);
+#endif
+}
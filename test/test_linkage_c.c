@@ -0,0 +1,20 @@
+// The C side of test_linkage.cpp.
+
+#include "../planets.h"
+#include "../planets_1800-2050.h"
+#include "../fast_math.h"
+#include "../orbits.h"
+#include "../orbits_batch.h"
+#include "../julian_date.h"
+#include "../orbit_stepper.h"
+#include "../kepler_solvers.h"
+#include "../chebyshev_ephemeris.h"
+#include "../ephemeris_file.h"
+#include "../small_bodies.h"
+#include "../geocentric.h"
+#include "../libplanets.h"
+#include "../lambert.h"
+
+void linkage_c_xyz_in_icrf_frame(double days_since_j2k, double* x_eq_au, double* y_eq_au, double* z_eq_au){
+    xyz_in_icrf_frame(Jupiter, days_since_j2k, x_eq_au, y_eq_au, z_eq_au);
+}
@@ -0,0 +1,175 @@
+/*
+Fixed-size work-stealing pool of worker threads for the parallel searches
+and sweeps.
+
+run(n_tasks, task) calls task(i) for every i in [0, n_tasks) on the pool
+and returns once all of them have finished. The indices are dealt out in
+contiguous runs, one run per thread, into per-thread deques. Each thread
+works through its own deque from the front and, when it runs dry, steals
+from the back of another thread's deque, so uneven tasks even out without
+a single shared queue to contend on. The calling thread has a deque of its
+own and works too, so a pool of zero workers runs everything inline.
+
+Tasks must not call run on the same pool.
+*/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+    // n_threads of 0 uses one worker per hardware thread, less the caller.
+    explicit thread_pool(size_t n_threads = 0){
+        if (n_threads==0){
+            size_t hardware = std::thread::hardware_concurrency();
+            n_threads = hardware>1 ? hardware-1 : 0;
+        }
+        // One deque per worker plus one for callers of run
+        for (size_t i=0; i<n_threads+1; i++){
+            queues.emplace_back(new task_queue);
+        }
+        for (size_t i=0; i<n_threads; i++){
+            workers.emplace_back([this, i]{ worker_loop(i); });
+        }
+    }
+
+    ~thread_pool(){
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers){
+            worker.join();
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Threads that run tasks, counting the caller of run.
+    size_t concurrency() const {
+        return queues.size();
+    }
+
+    void run(size_t n_tasks, const std::function<void(size_t)>& task){
+        if (n_tasks==0){
+            return;
+        }
+        batch current;
+        current.task = &task;
+        current.remaining = n_tasks;
+
+        // Counted before they are queued, so that the count never drops
+        // below zero when a worker takes a task straight away.
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            queued += n_tasks;
+        }
+        const size_t n_queues = queues.size();
+        for (size_t q=0; q<n_queues; q++){
+            size_t first = q*n_tasks/n_queues;
+            size_t end = (q+1)*n_tasks/n_queues;
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            for (size_t i=first; i<end; i++){
+                queues[q]->tasks.push_back({&current, i});
+            }
+        }
+        wake.notify_all();
+
+        // Work alongside the pool until nothing is left to take, then wait
+        // for the tasks still running elsewhere.
+        queued_task next;
+        while (take(n_queues-1, next)){
+            execute(next);
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        done.wait(lock, [&current]{ return current.remaining.load()==0; });
+    }
+
+private:
+    struct batch {
+        const std::function<void(size_t)>* task;
+        std::atomic<size_t> remaining;
+    };
+
+    struct queued_task {
+        batch* owner;
+        size_t index;
+    };
+
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<queued_task> tasks;
+    };
+
+    // Pop from the front of our own deque, else steal from the back of the
+    // others, starting with our neighbour.
+    bool take(size_t own, queued_task& next){
+        const size_t n_queues = queues.size();
+        for (size_t k=0; k<n_queues; k++){
+            size_t q = (own+k)%n_queues;
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            std::deque<queued_task>& tasks = queues[q]->tasks;
+            if (tasks.empty()){
+                continue;
+            }
+            if (k==0){
+                next = tasks.front();
+                tasks.pop_front();
+            } else {
+                next = tasks.back();
+                tasks.pop_back();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void execute(const queued_task& next){
+        (*next.owner->task)(next.index);
+        if (next.owner->remaining.fetch_sub(1)==1){
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            done.notify_all();
+        }
+    }
+
+    void worker_loop(size_t own){
+        while (true){
+            queued_task next;
+            if (take(own, next)){
+                execute(next);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [this]{ return stopping || queued>0; });
+            if (stopping && queued==0){
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Tasks sitting in any deque; workers sleep while it is zero. Only
+    // increased under sleep_mutex so that no wake-up is lost.
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+};
+
+#endif